@@ -0,0 +1,170 @@
+#include "call_tree.h"
+#include "state_model.h"
+
+#include <QPair>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+/** Call tree of states of one component. */
+struct CallTree::ComputeComponent
+{
+    typedef CallTree result_type;
+
+    quint64 begin;
+    quint64 end;
+
+    CallTree operator()(QVector<StateModel*> states) const
+    {
+        CallTree result;
+        result.begin_ = begin;
+        result.end_ = end;
+        std::sort(states.begin(), states.end(), startsBefore);
+
+        // Enclosing states with their nodes.
+        QVector<QPair<const StateModel*, int>> stack;
+
+        // States not closed yet last till the end of the range.
+        quint64 rangeEnd = end;
+        auto stateEnd = [rangeEnd](const StateModel* state)
+        {
+            return state->end == Time(0) ? rangeEnd : state->end.toULL();
+        };
+
+        foreach (const StateModel* state, states)
+        {
+            quint64 start = state->start.toULL();
+            while (!stack.isEmpty() && stateEnd(stack.last().first) <= start)
+            {
+                stack.removeLast();
+            }
+
+            // Broken nesting is clipped by the enclosing state.
+            quint64 finish = qMin(stateEnd(state), end);
+            if (!stack.isEmpty())
+            {
+                finish = qMin(finish, stateEnd(stack.last().first));
+            }
+            start = qMax(start, begin);
+
+            int node = result.child(stack.isEmpty() ? root() : stack.last().second, state->type);
+            ++result.nodes_[node].calls;
+            result.nodes_[node].inclusive += finish > start ? finish - start : 0;
+
+            stack.append(qMakePair(state, node));
+        }
+
+        return result;
+    }
+};
+
+CallTree::CallTree() :
+    begin_(0),
+    end_(0)
+{
+    Node root = { -1, -1, 0, 0, 0, 0, QVector<int>() };
+    nodes_ << root;
+}
+
+CallTree CallTree::compute(const QList<QVector<StateModel*>>& parts, quint64 begin, quint64 end)
+{
+    ComputeComponent computeComponent = { begin, end };
+    CallTree result = QtConcurrent::blockingMappedReduced<CallTree>(
+        parts, computeComponent, &CallTree::merge);
+
+    result.begin_ = begin;
+    result.end_ = end;
+    result.finish();
+    return result;
+}
+
+bool CallTree::isEmpty() const
+{
+    return nodes_.size() == 1;
+}
+
+int CallTree::size() const
+{
+    return nodes_.size();
+}
+
+const CallTree::Node& CallTree::node(int index) const
+{
+    return nodes_[index];
+}
+
+int CallTree::depth() const
+{
+    int result = 0;
+    foreach (const Node& node, nodes_)
+    {
+        result = qMax(result, node.depth);
+    }
+    return result;
+}
+
+void CallTree::merge(const CallTree& other)
+{
+    // Parents go before children, so every parent is mapped already.
+    QVector<int> mapped(other.nodes_.size());
+    mapped[root()] = root();
+    for (int i = 0; i < other.nodes_.size(); ++i)
+    {
+        const Node& source = other.nodes_[i];
+        if (i != root())
+        {
+            mapped[i] = child(mapped[source.parent], source.type);
+        }
+
+        Node& target = nodes_[mapped[i]];
+        target.calls += source.calls;
+        target.inclusive += source.inclusive;
+    }
+}
+
+int CallTree::child(int parent, int type)
+{
+    quint64 key = (quint64(parent) << 32) | quint32(type);
+    QHash<quint64, int>::const_iterator i = children_.constFind(key);
+    if (i != children_.constEnd())
+    {
+        return i.value();
+    }
+
+    Node node = { type, parent, nodes_[parent].depth + 1, 0, 0, 0, QVector<int>() };
+    nodes_ << node;
+    nodes_[parent].children << nodes_.size() - 1;
+    children_.insert(key, nodes_.size() - 1);
+    return nodes_.size() - 1;
+}
+
+void CallTree::finish()
+{
+    // The root spans all its children, like a state enclosing them.
+    Node& top = nodes_[root()];
+    top.inclusive = 0;
+    foreach (int c, top.children)
+    {
+        top.inclusive += nodes_[c].inclusive;
+    }
+
+    for (int i = 0; i < nodes_.size(); ++i)
+    {
+        Node& node = nodes_[i];
+        quint64 nested = 0;
+        foreach (int c, node.children)
+        {
+            nested += nodes_[c].inclusive;
+        }
+        node.exclusive = node.inclusive - qMin(nested, node.inclusive);
+
+        const QVector<Node>& nodes = nodes_;
+        std::sort(node.children.begin(), node.children.end(), [&nodes](int a, int b) {
+            return nodes[a].inclusive > nodes[b].inclusive;
+        });
+    }
+}
+
+}
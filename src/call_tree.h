@@ -0,0 +1,79 @@
+#ifndef CALL_TREE_H
+#define CALL_TREE_H
+
+#include <QVector>
+#include <QHash>
+
+namespace vis4 {
+
+class StateModel;
+
+/**
+ * Merged call tree of states within a time range. Every node is a
+ * path of nested state types from the outermost state, calls on the
+ * same path are merged over time and over components. Times are in
+ * nanoseconds and are clipped by the range, so a state crossing the
+ * bound of the range counts only its visible part.
+ */
+class CallTree
+{
+public:
+    struct Node
+    {
+        /** State type, -1 for the root. */
+        int type;
+        int parent;
+        int depth;
+        int calls;
+        quint64 inclusive;
+        /** Time not spent in nested states. */
+        quint64 exclusive;
+        /** Ordered by inclusive time, the longest first. */
+        QVector<int> children;
+    };
+
+    CallTree();
+
+    /**
+     * Computes the tree of states in [begin, end]. Every part holds the
+     * states of one component that cross the range, the ones enclosing
+     * it included, as TraceModel::rangeStates returns. Trees of parts
+     * are built in parallel and merged by paths in the reduction step.
+     */
+    static CallTree compute(const QList<QVector<StateModel*>>& parts, quint64 begin, quint64 end);
+
+    bool isEmpty() const;
+
+    /** Number of nodes, the root included. */
+    int size() const;
+    const Node& node(int index) const;
+    static int root() { return 0; }
+
+    /** Deepest level of nodes, zero for the tree with the root only. */
+    int depth() const;
+
+    quint64 begin() const { return begin_; }
+    quint64 end() const { return end_; }
+
+    /** Adds calls of the other tree to the ones with the same paths. */
+    void merge(const CallTree& other);
+
+private:
+    struct ComputeComponent;
+
+    /** Returns the child of type 'type', adding it if there is none. */
+    int child(int parent, int type);
+
+    /** Computes exclusive time and orders children of every node. */
+    void finish();
+
+    QVector<Node> nodes_;
+    /** Child by (parent << 32 | type). */
+    QHash<quint64, int> children_;
+    quint64 begin_;
+    quint64 end_;
+};
+
+}
+
+#endif // CALL_TREE_H
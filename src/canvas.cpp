@@ -27,6 +27,33 @@ using namespace std;
 
 const int arrowhead_length = 16;
 
+/** Layers in order of composition. */
+const TracePainter::Layer image_layers[] =
+{
+    TracePainter::EventsLayer,
+    TracePainter::StatesLayer,
+    TracePainter::ArrowsLayer
+};
+
+/** Returns layers, that depend on the changed model properties. */
+static int invalidatedLayers(int delta)
+{
+    if (delta & (Trace_model_delta::component_position |
+                 Trace_model_delta::components |
+                 Trace_model_delta::time_range))
+    {
+        return TracePainter::AllLayers;
+    }
+
+    int layers = 0;
+    if (delta & Trace_model_delta::event_types) layers |= TracePainter::EventsLayer;
+    if (delta & Trace_model_delta::state_types) layers |= TracePainter::StatesLayer;
+
+    // Arrows are drawn always and only hidden at composition,
+    // so Trace_model_delta::groups needs no redrawing.
+    return layers;
+}
+
 Canvas::Canvas(QWidget* parent) :
     QScrollArea(parent),
     timeline_(nullptr),
@@ -47,6 +74,7 @@ Canvas::Canvas(QWidget* parent) :
     setViewportMargins(0, 0, 0, timeline_->sizeHint().height());
     connect(timeline_, SIGNAL(timeSettingsChanged()), this,
                        SLOT(timeSettingsChanged()));
+    connect(contents_, SIGNAL(drawingFinished()), this, SIGNAL(idle()));
 }
 
 /**
@@ -74,6 +102,11 @@ TraceModelPtr& Canvas::getModel() const
     return contents_->model_;
 }
 
+bool Canvas::isIdle() const
+{
+    return !contents_->drawing;
+}
+
 void Canvas::timeSettingsChanged()
 {
     timeline_->update();
@@ -216,13 +249,52 @@ void Canvas::setPortableDrawing(bool state)
     contents_->portable_drawing = state;
 }
 
+void Canvas::setRasterDrawing(bool state)
+{
+    contents_->raster_drawing = state;
+}
+
+void Canvas::setDensityDrawing(bool state)
+{
+    if (contents_->density_drawing == state) return;
+    contents_->density_drawing = state;
+
+    if (getModel().get())
+    {
+        contents_->setModel(getModel(), true);
+        emit modelChanged(getModel());
+    }
+}
+
+void Canvas::setFlameDrawing(bool state)
+{
+    if (contents_->flame_drawing == state) return;
+    contents_->flame_drawing = state;
+
+    if (getModel().get())
+    {
+        contents_->setModel(getModel(), true);
+        emit modelChanged(getModel());
+    }
+}
+
 Contents_widget::Contents_widget(Canvas* parent) : 
     QWidget(parent), 
     parent_(parent), 
     paintBuffer(nullptr),
     portable_drawing(false), 
-    visir_position((unsigned)-1)//? what?
+    raster_drawing(false),
+    density_drawing(false),
+    flame_drawing(false),
+    dirty_layers(TracePainter::AllLayers),
+    visir_position((unsigned)-1),//? what?
+    drawing(false)
 {
+    for (int i = 0; i < layers_count; ++i)
+    {
+        layer_images[i] = nullptr;
+    }
+
     setAttribute(Qt::WA_OpaquePaintEvent, true);
     setAttribute(Qt::WA_NoSystemBackground, true);
 
@@ -252,6 +324,7 @@ void Contents_widget::setModel(TraceModelPtr model, bool force)
 
     bool need_redraw = true;
     bool start_in_background = false;
+    int layers = TracePainter::AllLayers;
     /**
      * At the moment, 'delta' returns 0 is the time
      * unit changed, which is just for our purposed here.
@@ -261,15 +334,24 @@ void Contents_widget::setModel(TraceModelPtr model, bool force)
         int delta = vis4::delta(*model_, *model);
         need_redraw = (delta != 0);
         start_in_background = !(delta & Trace_model_delta::time_range);
+        layers = invalidatedLayers(delta);
     }
 
     model_ = model;
     trace_painter->setModel(model_);
+    dirty_layers |= layers;
     if (!need_redraw || trace_painter->getState() == TracePainter::Canceled)
     {
         return;
     }
 
+    // Only composition of layers has changed
+    if (dirty_layers == 0)
+    {
+        update();
+        return;
+    }
+
     // Stop current drawing
     if (trace_painter->getState() == TracePainter::Active ||
         trace_painter->getState() == TracePainter::Background)
@@ -287,6 +369,7 @@ void Contents_widget::setModel(TraceModelPtr model, bool force)
 
     // Draw trace
     QApplication::setOverrideCursor(Qt::BusyCursor);
+    drawing = true;
     for (;;)
     {
         pendingRedraw = false;
@@ -296,7 +379,10 @@ void Contents_widget::setModel(TraceModelPtr model, bool force)
             break;
         }
     }
+    drawing = false;
     QApplication::restoreOverrideCursor();
+
+    emit drawingFinished();
 }
 
 TraceModelPtr Contents_widget::model() const
@@ -385,14 +471,25 @@ void Contents_widget::paintEvent(QPaintEvent* event)
     QPainter painter(this);
 
     // Draw paint buffer at the canvas
-    if (portable_drawing)
+    if (QImage* image = dynamic_cast<QImage*>(paintBuffer))
     {
-        painter.drawImage(0, 0, *static_cast<QImage*>(paintBuffer));   
+        painter.drawImage(0, 0, *image);
     }
     else
     {
         painter.drawPixmap(0, 0, *static_cast<QPixmap*>(paintBuffer));
     }
+
+    // Compose layers over the buffer
+    for (int i = 0; i < layers_count; ++i)
+    {
+        if (!layer_images[i]) continue;
+        if (image_layers[i] == TracePainter::ArrowsLayer && !model_->groupsEnabled()) continue;
+
+        QRect r = event->rect() & layer_images[i]->rect();
+        painter.drawImage(r, *layer_images[i], r);
+    }
+
     // Draw outside of pixmap
     int image_height = paintBuffer->height();
     int image_width = paintBuffer->width();
@@ -493,9 +590,7 @@ QSize Contents_widget::minimumSizeHint() const
     else
     {
         int components_count = model_->getVisibleComponents().size();
-        return QSize(300,
-                     trace_painter->lifeline_stepping
-                     *(components_count + 1));
+        return QSize(300, trace_painter->contentsHeight(components_count));
     }
 }
 
@@ -635,12 +730,20 @@ void Contents_widget::doDrawing(bool start_in_background)
 {
     // Create painter buffer
     int components_count = model_->getVisibleComponents().size();
-    int height = trace_painter->lifeline_stepping
-                            * (components_count + 1);
+    trace_painter->setDensityDrawing(density_drawing, parent_->viewport()->height());
+    trace_painter->setFlameDrawing(flame_drawing, flame_drawing ? model_->maxDepth() : 0);
+    int height = trace_painter->contentsHeight(components_count);
 
-    if (!paintBuffer || paintBuffer->width() != width() || paintBuffer->height() != height)
+    trace_painter->setRasterDrawing(raster_drawing);
+
+    bool image_buffer = portable_drawing || raster_drawing;
+    bool buffer_changed = paintBuffer &&
+        (dynamic_cast<QImage*>(paintBuffer) != nullptr) != image_buffer;
+
+    if (!paintBuffer || buffer_changed ||
+        paintBuffer->width() != width() || paintBuffer->height() != height)
     {
-        if (portable_drawing)
+        if (image_buffer)
         {
             QImage* image = new QImage(width(), height, QImage::Format_RGB32);
             trace_painter->setPaintDevice(image);
@@ -652,14 +755,25 @@ void Contents_widget::doDrawing(bool start_in_background)
             trace_painter->setPaintDevice(pixmap);
             delete paintBuffer; paintBuffer = pixmap;
         }
+
+        for (int i = 0; i < layers_count; ++i)
+        {
+            QImage* image = new QImage(width(), height, QImage::Format_ARGB32_Premultiplied);
+            trace_painter->setLayerDevice(image_layers[i], image);
+            delete layer_images[i]; layer_images[i] = image;
+        }
+
+        dirty_layers = TracePainter::AllLayers;
     }
 
     // Draw the trace!
     painter_timer->start(1000);
-    trace_painter->drawTrace(model_->getMaxTime() - model_->getMinTime(), start_in_background);
+    trace_painter->drawTrace(model_->getMaxTime() - model_->getMinTime(), start_in_background,
+                             dirty_layers);
     painter_timer->stop();
 
     if (trace_painter->getState() == TracePainter::Canceled) return;
+    dirty_layers = 0;
     trace_geometry = trace_painter->traceGeometry();
 
     updateGeometry();
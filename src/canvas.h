@@ -4,6 +4,7 @@
 #include <QtWidgets/QScrollArea>
 #include <QPair>
 #include <QTime>
+#include <QImage>
 
 #include "trace_model.h"
 #include "trace_painter.h"
@@ -33,6 +34,14 @@ public:
 
     TraceModelPtr& getModel() const;
 
+    /**
+     * Returns false while the trace is drawn. Drawing processes events,
+     * so handlers of events may run in the middle of it, while the
+     * model is read. Such handlers should wait for the idle signal
+     * before changing the trace data.
+     */
+    bool isIdle() const;
+
     int getNearestLifeline(int y);
 
 
@@ -67,10 +76,27 @@ public slots:
     /** If true, uses maximally portable drawing mechanims, that
         don't rely on OS being decent, and not broken.  */
     void setPortableDrawing(bool);
+
+    /** If true, state boxes and event lines are rasterized directly
+        into the image buffer, without QPainter. Implies drawing
+        to QImage, like portable drawing does. */
+    void setRasterDrawing(bool);
+
+    /** If true, all lifelines are squeezed to fit the view, and
+        states are drawn as a heatmap of pixel-aggregated activity.
+        The trace is redrawn at once. */
+    void setDensityDrawing(bool);
+
+    /** If true, lifelines are expanded into rows by nesting depth
+        of states, like a flame chart. */
+    void setFlameDrawing(bool);
 signals:
     /** Сигнал, генерируемый при изменении модели методом setModel. */
     void modelChanged(TraceModelPtr & new_model);
 
+    /** Emitted when drawing of the trace is finished or canceled. */
+    void idle();
+
     /**
      * Сигнал, генерируемый при нажатии на какую-либо кнопку мышки.
      * Этот сигнал не должен использоваться инструментами. Вместо
@@ -146,6 +172,9 @@ public:
     QRect boundingRect(int component,
                        const Time& min_time, const Time& max_time);
 
+signals:
+    void drawingFinished();
+
 private: /** methods */
 
     QRect drawBaloon(QPainter* painter);
@@ -183,6 +212,17 @@ private: /** members */
 
     QPaintDevice* paintBuffer;
     bool portable_drawing;
+    bool raster_drawing;
+    bool density_drawing;
+    bool flame_drawing;
+
+    /** Images of events, states and arrows layers. They are
+        composed over paintBuffer in paintEvent. */
+    static const int layers_count = 3;
+    QImage* layer_images[layers_count];
+
+    /** Layers, that must be redrawn (TracePainter::Layer flags). */
+    int dirty_layers;
 
     int visir_position;
     QRect ballon;
@@ -201,6 +241,9 @@ private:
 
     bool pendingRedraw;
 
+    /** The trace is being drawn, redrawing included. */
+    bool drawing;
+
     /** Painter timer. Involves repaint for showing intermediate results of drawing. */
     QTimer* painter_timer;
 
@@ -0,0 +1,222 @@
+#include "clustering.h"
+#include "range_statistics.h"
+
+#include <QPair>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+
+namespace vis4 {
+
+namespace {
+
+/** Parts of the trace and state types in a signature. */
+const int signature_buckets = 16;
+const int signature_types = 12;
+
+const int max_clusters = 64;
+const int max_iterations = 10;
+
+/** Mean square difference of time shares, below which
+    components are considered similar. */
+const double similarity_threshold = 0.01;
+
+typedef QVector<float> Signature;
+
+double distance(const Signature& a, const Signature& b)
+{
+    double result = 0;
+    for (int i = 0; i < a.size(); ++i)
+    {
+        double d = a[i] - b[i];
+        result += d * d;
+    }
+    return a.isEmpty() ? 0 : result / a.size();
+}
+
+/** Returns index of the center nearest to the signature, and the distance. */
+QPair<int, double> nearest(const Signature& signature, const QVector<Signature>& centers)
+{
+    QPair<int, double> result(-1, std::numeric_limits<double>::max());
+    for (int i = 0; i < centers.size(); ++i)
+    {
+        double d = distance(signature, centers[i]);
+        if (d < result.second)
+        {
+            result = qMakePair(i, d);
+        }
+    }
+    return result;
+}
+
+}
+
+/** Computes signature of one component. */
+struct Clustering::ComputeSignature
+{
+    typedef Signature result_type;
+
+    const StatisticsIndex* statistics;
+    QVector<int> types;
+    quint64 begin;
+    quint64 end;
+
+    Signature operator()(int component) const
+    {
+        Signature signature(signature_buckets * types.size(), 0);
+        double width = double(end - begin) / signature_buckets;
+
+        QVector<quint64> bins(signature_buckets);
+        for (int t = 0; t < types.size(); ++t)
+        {
+            bins.fill(0);
+            statistics->binInnermostTime(types[t], component, begin, end, bins);
+            for (int b = 0; b < signature_buckets; ++b)
+            {
+                signature[b * types.size() + t] = width > 0 ? float(bins[b] / width) : 0;
+            }
+        }
+        return signature;
+    }
+};
+
+/** Finds the nearest center for a signature. */
+struct Clustering::NearestCenter
+{
+    typedef int result_type;
+
+    const QVector<Signature>* centers;
+
+    int operator()(const Signature& signature) const
+    {
+        return nearest(signature, *centers).first;
+    }
+};
+
+Clustering Clustering::compute(const StatisticsIndex& statistics, const QVector<int>& components,
+                               int types, quint64 begin, quint64 end)
+{
+    Clustering result;
+    if (components.isEmpty())
+    {
+        return result;
+    }
+
+    // Only the types taking most of the time go to signatures.
+    QVector<QPair<quint64, int>> usage;
+    for (int type = 0; type < types; ++type)
+    {
+        quint64 time = statistics.innermostTime(type);
+        if (time) usage << qMakePair(time, type);
+    }
+    std::sort(usage.begin(), usage.end());
+    std::reverse(usage.begin(), usage.end());
+
+    ComputeSignature computeSignature;
+    computeSignature.statistics = &statistics;
+    for (int i = 0; i < usage.size() && i < signature_types; ++i)
+    {
+        computeSignature.types << usage[i].second;
+    }
+    computeSignature.begin = begin;
+    computeSignature.end = end;
+
+    QVector<Signature> signatures =
+        QtConcurrent::blockingMapped<QVector<Signature>>(components, computeSignature);
+
+    // Leader pass gives the number of clusters and initial centers.
+    QVector<Signature> centers;
+    foreach (const Signature& signature, signatures)
+    {
+        if (centers.size() == max_clusters) break;
+        if (centers.isEmpty() || nearest(signature, centers).second > similarity_threshold)
+        {
+            centers << signature;
+        }
+    }
+
+    NearestCenter nearestCenter = { &centers };
+    QVector<int> assignment;
+    for (int iteration = 0; iteration < max_iterations; ++iteration)
+    {
+        QVector<int> next = QtConcurrent::blockingMapped<QVector<int>>(signatures, nearestCenter);
+        if (next == assignment) break;
+        assignment = next;
+
+        // Centers move to means of their clusters, empty clusters are dropped.
+        QVector<Signature> sums(centers.size(), Signature(centers[0].size(), 0));
+        QVector<int> counts(centers.size(), 0);
+        for (int i = 0; i < signatures.size(); ++i)
+        {
+            Signature& sum = sums[assignment[i]];
+            for (int d = 0; d < sum.size(); ++d)
+            {
+                sum[d] += signatures[i][d];
+            }
+            ++counts[assignment[i]];
+        }
+
+        centers.clear();
+        for (int c = 0; c < sums.size(); ++c)
+        {
+            if (!counts[c]) continue;
+            for (int d = 0; d < sums[c].size(); ++d)
+            {
+                sums[c][d] /= counts[c];
+            }
+            centers << sums[c];
+        }
+        if (centers.size() != sums.size())
+        {
+            assignment.clear();
+        }
+    }
+    assignment = QtConcurrent::blockingMapped<QVector<int>>(signatures, nearestCenter);
+
+    // Members of a cluster are ordered by distance to its center.
+    QVector<QVector<QPair<double, int>>> ordered(centers.size());
+    for (int i = 0; i < components.size(); ++i)
+    {
+        int cluster = assignment[i];
+        ordered[cluster] << qMakePair(distance(signatures[i], centers[cluster]), components[i]);
+    }
+
+    result.clusters_.fill(-1, *std::max_element(components.begin(), components.end()) + 1);
+    for (int i = 0; i < components.size(); ++i)
+    {
+        result.clusters_[components[i]] = assignment[i];
+    }
+    result.members_.resize(centers.size());
+    for (int cluster = 0; cluster < centers.size(); ++cluster)
+    {
+        std::sort(ordered[cluster].begin(), ordered[cluster].end());
+        foreach (const auto& member, ordered[cluster])
+        {
+            result.members_[cluster] << member.second;
+        }
+    }
+    return result;
+}
+
+bool Clustering::isEmpty() const
+{
+    return members_.isEmpty();
+}
+
+int Clustering::clusterCount() const
+{
+    return members_.size();
+}
+
+int Clustering::cluster(int component) const
+{
+    return (component >= 0 && component < clusters_.size()) ? clusters_[component] : -1;
+}
+
+const QList<int>& Clustering::members(int cluster) const
+{
+    return members_[cluster];
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef CLUSTERING_H
+#define CLUSTERING_H
+
+#include <QVector>
+#include <QList>
+
+namespace vis4 {
+
+class StatisticsIndex;
+
+/**
+ * Groups of components with similar behaviour.
+ *
+ * Behaviour of a component is described by its signature: the share
+ * of time spent in each of the most used state types, for every of
+ * a few equal parts of the trace. Signatures are grouped by a leader
+ * pass, which opens a new cluster for a signature far from all
+ * existing ones, and the groups are refined by k-means iterations,
+ * with distances computed in parallel.
+ */
+class Clustering
+{
+public:
+    /** Clusters the components by their behaviour in the trace [begin, end]. */
+    static Clustering compute(const StatisticsIndex& statistics, const QVector<int>& components,
+                              int types, quint64 begin, quint64 end);
+
+    bool isEmpty() const;
+    int clusterCount() const;
+
+    /** Cluster of the component, or -1 if the component was not clustered. */
+    int cluster(int component) const;
+
+    /** Members of the cluster, the closest to the center of the cluster first. */
+    const QList<int>& members(int cluster) const;
+
+private:
+    struct ComputeSignature;
+    struct NearestCenter;
+
+    QVector<int> clusters_;
+    QVector<QList<int>> members_;
+};
+
+}
+
+#endif // CLUSTERING_H
@@ -0,0 +1,54 @@
+#ifndef COLLECTIVE_MODEL_H
+#define COLLECTIVE_MODEL_H
+
+#include <QtGlobal>
+
+namespace vis4 {
+
+/** Part of one component in a collective operation. */
+struct CollectiveParticipant
+{
+    int component;
+    quint64 begin;
+    quint64 end;
+    quint64 sent;
+    quint64 received;
+};
+
+/**
+ * One instance of a collective operation on a communicator. Like
+ * messages, collectives are kept by value in CollectiveStore, and
+ * their participants are a range of a flat array of the store.
+ * Times are in nanoseconds.
+ */
+struct CollectiveModel
+{
+    /** Direction of data, as shown on the diagram. */
+    enum Flow
+    {
+        /** From the root to all (broadcast, scatter). */
+        FanOut,
+        /** From all to the root (gather, reduce). */
+        FanIn,
+        /** From all to all, or synchronization only. */
+        AllToAll
+    };
+
+    /** Earliest beginning and latest end among participants. */
+    quint64 begin;
+    quint64 end;
+
+    quint32 communicator;
+    Flow flow;
+
+    /** Position of the root among participants, or -1. */
+    int root;
+
+    /** Participants are 'count' records from 'first' in the store. */
+    int first;
+    int count;
+};
+
+}
+
+#endif // COLLECTIVE_MODEL_H
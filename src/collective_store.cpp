@@ -0,0 +1,104 @@
+#include "collective_store.h"
+
+#include <algorithm>
+
+namespace vis4 {
+
+int CollectiveStore::size() const
+{
+    return collectives_.size();
+}
+
+const CollectiveModel& CollectiveStore::collective(int index) const
+{
+    return collectives_[index];
+}
+
+const CollectiveParticipant& CollectiveStore::participant(int index) const
+{
+    return participants_[index];
+}
+
+QVector<int> CollectiveStore::crossing(quint64 begin, quint64 end) const
+{
+    return index_.crossing(begin, end);
+}
+
+void CollectiveMatcher::add(quint64 participant, quint32 communicator, CollectiveModel::Flow flow,
+                            quint64 root, int component, quint64 begin, quint64 end,
+                            quint64 sent, quint64 received)
+{
+    int number = counts_[qMakePair(participant, communicator)]++;
+
+    auto key = qMakePair(communicator, number);
+    auto it = byNumber_.find(key);
+    if (it == byNumber_.end())
+    {
+        Instance instance;
+        instance.communicator = communicator;
+        instance.flow = flow;
+        instance.root = root;
+        it = byNumber_.insert(key, instances_.size());
+        instances_ << instance;
+    }
+
+    CollectiveParticipant record = { component, begin, end, sent, received };
+    instances_[*it].participants << qMakePair(participant, record);
+}
+
+CollectiveStore CollectiveMatcher::store() const
+{
+    QVector<CollectiveModel> collectives;
+    QVector<CollectiveParticipant> participants;
+
+    foreach (const Instance& instance, instances_)
+    {
+        CollectiveModel collective;
+        collective.begin = instance.participants[0].second.begin;
+        collective.end = instance.participants[0].second.end;
+        collective.communicator = instance.communicator;
+        collective.flow = instance.flow;
+        collective.root = -1;
+        collective.first = participants.size();
+        collective.count = instance.participants.size();
+
+        for (int i = 0; i < instance.participants.size(); ++i)
+        {
+            const CollectiveParticipant& p = instance.participants[i].second;
+            collective.begin = qMin(collective.begin, p.begin);
+            collective.end = qMax(collective.end, p.end);
+            if (instance.root != NO_ROOT && instance.participants[i].first == instance.root)
+            {
+                collective.root = i;
+            }
+            participants << p;
+        }
+
+        // Rooted operations, whose root is unknown, are drawn as all to all.
+        if (collective.root == -1)
+        {
+            collective.flow = CollectiveModel::AllToAll;
+        }
+        collectives << collective;
+    }
+
+    // Participants stay where they are, only operations are sorted.
+    std::stable_sort(collectives.begin(), collectives.end(),
+                     [](const CollectiveModel& a, const CollectiveModel& b)
+                     { return a.begin < b.begin; });
+
+    CollectiveStore result;
+    result.collectives_ = collectives;
+    result.participants_ = participants;
+
+    QVector<quint64> begins(collectives.size()), ends(collectives.size());
+    for (int i = 0; i < collectives.size(); ++i)
+    {
+        begins[i] = collectives[i].begin;
+        ends[i] = collectives[i].end;
+    }
+    result.index_.build(begins, ends);
+    return result;
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef COLLECTIVE_STORE_H
+#define COLLECTIVE_STORE_H
+
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+#include "collective_model.h"
+#include "interval_index.h"
+
+namespace vis4 {
+
+/**
+ * Collective operations of a trace, ordered by beginning and indexed
+ * as intervals like messages are. Participants of all operations are
+ * kept in one array, so an operation costs no allocations of its own.
+ */
+class CollectiveStore
+{
+public:
+    int size() const;
+    const CollectiveModel& collective(int index) const;
+    const CollectiveParticipant& participant(int index) const;
+
+    /** Indices of collectives with any participant within [begin, end]. */
+    QVector<int> crossing(quint64 begin, quint64 end) const;
+
+private:
+    friend class CollectiveMatcher;
+
+    QVector<CollectiveModel> collectives_;
+    QVector<CollectiveParticipant> participants_;
+    IntervalIndex index_;
+};
+
+/**
+ * Groups records of collective operations, reported by a reader for
+ * every participant, into instances of operations. The n-th operation
+ * of a participant on a communicator belongs to the n-th instance on
+ * the communicator, as the MPI standard requires the same order of
+ * collective calls on all members of a communicator.
+ */
+class CollectiveMatcher
+{
+public:
+    static const quint64 NO_ROOT = ~quint64(0);
+
+    /**
+     * Adds participation of the component in the next operation on the
+     * communicator. Participants and the root are identified as the
+     * trace does it (process ids, ranks).
+     */
+    void add(quint64 participant, quint32 communicator, CollectiveModel::Flow flow,
+             quint64 root, int component, quint64 begin, quint64 end,
+             quint64 sent, quint64 received);
+
+    /** Builds the store of all operations added. */
+    CollectiveStore store() const;
+
+private:
+    struct Instance
+    {
+        quint32 communicator;
+        CollectiveModel::Flow flow;
+        quint64 root;
+        QVector<QPair<quint64, CollectiveParticipant>> participants;
+    };
+
+    QVector<Instance> instances_;
+    /** Instance by communicator and sequence number. */
+    QHash<QPair<quint32, int>, int> byNumber_;
+    /** Number of operations of every participant on every communicator. */
+    QHash<QPair<quint64, quint32>, int> counts_;
+};
+
+}
+
+#endif // COLLECTIVE_STORE_H
@@ -0,0 +1,153 @@
+#include "communication_matrix.h"
+#include "message_store.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace vis4 {
+
+/** Counts messages of senders from one part of rows. */
+struct CommunicationMatrix::CountPart
+{
+    typedef QVector<QHash<int, Cell>> result_type;
+
+    const MessageStore* messages;
+    const QVector<int>* rows;
+    const QVector<QVector<int>>* byPart;
+    const QVector<int>* firstRows;
+
+    QVector<QHash<int, Cell>> operator()(int part) const
+    {
+        int first = (*firstRows)[part];
+
+        QVector<QHash<int, Cell>> result((*firstRows)[part + 1] - first);
+        foreach (int i, (*byPart)[part])
+        {
+            const MessageModel& m = messages->message(i);
+            Cell& cell = result[(*rows)[m.sender] - first][(*rows)[m.receiver]];
+            ++cell.count;
+            cell.bytes += m.size;
+        }
+        return result;
+    }
+};
+
+CommunicationMatrix::CommunicationMatrix() :
+    size_(0),
+    maxCount_(0),
+    maxBytes_(0),
+    totalCount_(0),
+    totalBytes_(0)
+{}
+
+CommunicationMatrix CommunicationMatrix::compute(const MessageStore& messages, const QVector<int>& rows,
+                                                 int size, quint64 begin, quint64 end)
+{
+    CommunicationMatrix result;
+    result.size_ = size;
+    result.rows_.resize(size);
+    if (!size)
+    {
+        return result;
+    }
+
+    // Rows are split in equal parts, one or a few per thread.
+    int parts = qMin(size, QThread::idealThreadCount() * 2);
+    QVector<int> firstRows(parts + 1);
+    QVector<int> partOfRow(size);
+    for (int part = 0; part <= parts; ++part)
+    {
+        firstRows[part] = int(qint64(part) * size / parts);
+    }
+    for (int part = 0; part < parts; ++part)
+    {
+        for (int row = firstRows[part]; row < firstRows[part + 1]; ++row)
+        {
+            partOfRow[row] = part;
+        }
+    }
+
+    QVector<QVector<int>> byPart(parts);
+    foreach (int i, messages.crossing(begin, end))
+    {
+        const MessageModel& m = messages.message(i);
+        if (m.sendTime < begin || m.sendTime > end) continue;
+
+        int sender = rows.value(m.sender, -1);
+        int receiver = rows.value(m.receiver, -1);
+        if (sender == -1 || receiver == -1) continue;
+
+        byPart[partOfRow[sender]] << i;
+    }
+
+    QVector<int> partList(parts);
+    for (int part = 0; part < parts; ++part)
+    {
+        partList[part] = part;
+    }
+
+    CountPart countPart = { &messages, &rows, &byPart, &firstRows };
+    QVector<QVector<QHash<int, Cell>>> counted =
+        QtConcurrent::blockingMapped<QVector<QVector<QHash<int, Cell>>>>(partList, countPart);
+
+    for (int part = 0; part < parts; ++part)
+    {
+        for (int i = 0; i < counted[part].size(); ++i)
+        {
+            const QHash<int, Cell>& row = counted[part][i];
+            foreach (const Cell& cell, row)
+            {
+                result.maxCount_ = qMax(result.maxCount_, cell.count);
+                result.maxBytes_ = qMax(result.maxBytes_, cell.bytes);
+                result.totalCount_ += cell.count;
+                result.totalBytes_ += cell.bytes;
+            }
+            result.rows_[firstRows[part] + i] = row;
+        }
+    }
+    return result;
+}
+
+int CommunicationMatrix::size() const
+{
+    return size_;
+}
+
+quint64 CommunicationMatrix::count(int sender, int receiver) const
+{
+    QHash<int, Cell>::const_iterator cell = rows_[sender].constFind(receiver);
+    return (cell != rows_[sender].constEnd()) ? cell->count : 0;
+}
+
+quint64 CommunicationMatrix::bytes(int sender, int receiver) const
+{
+    QHash<int, Cell>::const_iterator cell = rows_[sender].constFind(receiver);
+    return (cell != rows_[sender].constEnd()) ? cell->bytes : 0;
+}
+
+const QHash<int, CommunicationMatrix::Cell>& CommunicationMatrix::row(int sender) const
+{
+    return rows_[sender];
+}
+
+quint64 CommunicationMatrix::maxCount() const
+{
+    return maxCount_;
+}
+
+quint64 CommunicationMatrix::maxBytes() const
+{
+    return maxBytes_;
+}
+
+quint64 CommunicationMatrix::totalCount() const
+{
+    return totalCount_;
+}
+
+quint64 CommunicationMatrix::totalBytes() const
+{
+    return totalBytes_;
+}
+
+}
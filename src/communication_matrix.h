@@ -0,0 +1,68 @@
+#ifndef COMMUNICATION_MATRIX_H
+#define COMMUNICATION_MATRIX_H
+
+#include <QHash>
+#include <QVector>
+
+namespace vis4 {
+
+class MessageStore;
+
+/**
+ * Number and total size of messages between every pair of rows
+ * (usually lifelines), sent within a time range.
+ *
+ * Only messages crossing the range are taken from the message store.
+ * They are split by the part of rows their sender belongs to, and
+ * parts are counted in parallel, each into its own rows, so no
+ * locking and no merging of partial matrices is needed. Only cells
+ * with messages are stored, so the matrix of many rows stays small.
+ */
+class CommunicationMatrix
+{
+public:
+    struct Cell
+    {
+        quint64 count;
+        quint64 bytes;
+    };
+
+    CommunicationMatrix();
+
+    /** Counts messages sent within [begin, end]. 'rows' has the row
+        of every component, or -1 for components not counted. */
+    static CommunicationMatrix compute(const MessageStore& messages, const QVector<int>& rows,
+                                       int size, quint64 begin, quint64 end);
+
+    /** Number of rows, which is also the number of columns. */
+    int size() const;
+
+    quint64 count(int sender, int receiver) const;
+    quint64 bytes(int sender, int receiver) const;
+
+    /** Cells of the sender with messages, by receiver. */
+    const QHash<int, Cell>& row(int sender) const;
+
+    /** Largest values of single cells. */
+    quint64 maxCount() const;
+    quint64 maxBytes() const;
+
+    /** Totals over the whole matrix. */
+    quint64 totalCount() const;
+    quint64 totalBytes() const;
+
+private:
+    struct CountPart;
+
+    int size_;
+    /** Cells with messages, by sender and receiver. */
+    QVector<QHash<int, Cell>> rows_;
+    quint64 maxCount_;
+    quint64 maxBytes_;
+    quint64 totalCount_;
+    quint64 totalBytes_;
+};
+
+}
+
+#endif // COMMUNICATION_MATRIX_H
@@ -0,0 +1,233 @@
+#include "duration_sketch.h"
+
+#include <QPair>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+namespace vis4 {
+
+namespace {
+
+/** Capacity of the top level. */
+const int sketch_k = 200;
+const int min_level_capacity = 8;
+
+QVector<int> levelCapacities()
+{
+    QVector<int> capacities;
+    for (int depth = 0; depth < 64; ++depth)
+    {
+        capacities << qMax(min_level_capacity, int(sketch_k * std::pow(2.0 / 3.0, depth)));
+    }
+    return capacities;
+}
+
+/** Capacity of the level 'depth' levels below the top. */
+int levelCapacity(int depth)
+{
+    static const QVector<int> capacities = levelCapacities();
+    return capacities[qMin(depth, 63)];
+}
+
+}
+
+DurationSketch::DurationSketch() :
+    count_(0),
+    min_(0),
+    max_(0),
+    size_(0),
+    maxSize_(0),
+    coin_(0)
+{}
+
+void DurationSketch::add(quint64 value)
+{
+    if (levels_.isEmpty())
+    {
+        grow();
+    }
+
+    min_ = count_ ? qMin(min_, value) : value;
+    max_ = count_ ? qMax(max_, value) : value;
+    ++count_;
+
+    levels_[0] << value;
+    if (++size_ >= maxSize_)
+    {
+        compress();
+    }
+}
+
+void DurationSketch::merge(const DurationSketch& other)
+{
+    if (other.isEmpty()) return;
+
+    min_ = count_ ? qMin(min_, other.min_) : other.min_;
+    max_ = count_ ? qMax(max_, other.max_) : other.max_;
+    count_ += other.count_;
+
+    while (levels_.size() < other.levels_.size())
+    {
+        grow();
+    }
+    for (int h = 0; h < other.levels_.size(); ++h)
+    {
+        levels_[h] += other.levels_[h];
+    }
+    size_ += other.size_;
+    compress();
+}
+
+quint64 DurationSketch::rank(quint64 value) const
+{
+    if (isEmpty() || value < min_) return 0;
+    if (value >= max_) return count_;
+
+    quint64 result = 0;
+    for (int h = 0; h < levels_.size(); ++h)
+    {
+        quint64 below = 0;
+        foreach (quint64 v, levels_[h])
+        {
+            if (v <= value) ++below;
+        }
+        result += below << h;
+    }
+    return qMin(result, count_);
+}
+
+quint64 DurationSketch::quantile(double q) const
+{
+    if (isEmpty()) return 0;
+    if (q <= 0) return min_;
+    if (q >= 1) return max_;
+
+    QVector<QPair<quint64, quint64>> weighted;
+    quint64 total = 0;
+    for (int h = 0; h < levels_.size(); ++h)
+    {
+        foreach (quint64 v, levels_[h])
+        {
+            weighted << qMakePair(v, quint64(1) << h);
+            total += quint64(1) << h;
+        }
+    }
+    std::sort(weighted.begin(), weighted.end());
+
+    quint64 target = quint64(std::ceil(q * total));
+    quint64 seen = 0;
+    foreach (const auto& w, weighted)
+    {
+        seen += w.second;
+        if (seen >= target)
+        {
+            return qBound(min_, w.first, max_);
+        }
+    }
+    return max_;
+}
+
+int DurationSketch::capacity(int level) const
+{
+    return levelCapacity(levels_.size() - 1 - level);
+}
+
+void DurationSketch::grow()
+{
+    levels_.resize(levels_.size() + 1);
+
+    maxSize_ = 0;
+    for (int h = 0; h < levels_.size(); ++h)
+    {
+        maxSize_ += capacity(h);
+    }
+}
+
+void DurationSketch::compress()
+{
+    // Only the lowest full level is compacted at a time, so upper
+    // levels are kept as full as possible.
+    while (size_ >= maxSize_)
+    {
+        int h = 0;
+        while (levels_[h].size() < capacity(h))
+        {
+            ++h;
+        }
+
+        if (h + 1 == levels_.size())
+        {
+            grow();
+        }
+
+        QVector<quint64>& level = levels_[h];
+        std::sort(level.begin(), level.end());
+
+        // With odd number of values one of them stays on the level.
+        bool odd = level.size() % 2;
+        quint64 kept = odd ? level.last() : 0;
+        if (odd) level.removeLast();
+
+        QVector<quint64>& next = levels_[h + 1];
+        for (int i = (coin_++ & 1); i < level.size(); i += 2)
+        {
+            next << level[i];
+        }
+
+        size_ -= level.size() / 2;
+        level.clear();
+        if (odd) level << kept;
+    }
+}
+
+/** Merges sketches of one state type from all components. */
+struct DurationSketches::MergeType
+{
+    typedef DurationSketch result_type;
+
+    const DurationSketches* sketches;
+
+    DurationSketch operator()(int type) const
+    {
+        DurationSketch result;
+        foreach (const QVector<DurationSketch>& component, sketches->components_)
+        {
+            if (type < component.size())
+            {
+                result.merge(component[type]);
+            }
+        }
+        return result;
+    }
+};
+
+void DurationSketches::add(int component, int type, quint64 duration)
+{
+    QVector<DurationSketch>& sketches = components_[component];
+    if (type >= sketches.size())
+    {
+        sketches.resize(type + 1);
+    }
+    sketches[type].add(duration);
+}
+
+QVector<DurationSketch> DurationSketches::merge(int types) const
+{
+    foreach (const QVector<DurationSketch>& component, components_)
+    {
+        types = qMax(types, component.size());
+    }
+
+    QVector<int> typeList(types);
+    for (int type = 0; type < types; ++type)
+    {
+        typeList[type] = type;
+    }
+
+    MergeType mergeType = { this };
+    return QtConcurrent::blockingMapped<QVector<DurationSketch>>(typeList, mergeType);
+}
+
+}
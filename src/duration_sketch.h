@@ -0,0 +1,85 @@
+#ifndef DURATION_SKETCH_H
+#define DURATION_SKETCH_H
+
+#include <QVector>
+#include <QHash>
+
+namespace vis4 {
+
+/**
+ * Mergeable quantile sketch of durations (KLL).
+ *
+ * Values are kept in levels, a value on level h stands for 2^h
+ * original values. When a level is full, it is sorted and every
+ * other value goes one level up. Lower levels have smaller
+ * capacity, so the sketch takes O(k) memory for any number of
+ * values, and ranks are estimated with error about n/k.
+ * Sketches of parts of the data are merged into the sketch of the
+ * whole with the same error.
+ */
+class DurationSketch
+{
+public:
+    DurationSketch();
+
+    void add(quint64 value);
+    void merge(const DurationSketch& other);
+
+    bool isEmpty() const { return count_ == 0; }
+
+    /** Exact number of values, minimal and maximal value. */
+    quint64 count() const { return count_; }
+    quint64 min() const { return min_; }
+    quint64 max() const { return max_; }
+
+    /** Estimated number of values not greater than 'value'. */
+    quint64 rank(quint64 value) const;
+
+    /** Estimated value with given fraction of values below it, 0 <= q <= 1. */
+    quint64 quantile(double q) const;
+
+private:
+    int capacity(int level) const;
+
+    /** Adds a level on top, all capacities get larger. */
+    void grow();
+
+    /** Compacts levels while the sketch is over its capacity. */
+    void compress();
+
+private:
+    QVector<QVector<quint64>> levels_;
+    quint64 count_;
+    quint64 min_;
+    quint64 max_;
+
+    /** Number of values in all levels and the sum of capacities. */
+    int size_;
+    int maxSize_;
+
+    /** Alternates the half of values that goes up on compaction. */
+    quint32 coin_;
+};
+
+/**
+ * Duration sketches by component and state type, filled by
+ * readers when states are closed.
+ */
+class DurationSketches
+{
+public:
+    void add(int component, int type, quint64 duration);
+
+    /** Returns sketches of all components by state type, merged
+        in parallel. */
+    QVector<DurationSketch> merge(int types) const;
+
+private:
+    struct MergeType;
+
+    QHash<int, QVector<DurationSketch>> components_;
+};
+
+}
+
+#endif // DURATION_SKETCH_H
@@ -8,95 +8,173 @@
 
 namespace vis4 {
 
+namespace {
+
+/** Cached events are dropped when their number exceeds the limit. */
+const int max_cached_events = 4096;
+
+}
+
+EventListModel::EventListModel(QObject* parent, TraceModelPtr& model) :
+    QAbstractTableModel(parent),
+    model_(model)
+{
+    // Time range is inclusive at both ends.
+    first_ = model_->eventOccurrencesBefore(model_->getMinTime());
+    count_ = model_->eventOccurrencesBefore(Time(model_->getMaxTime().toULL() + 1)) - first_;
+}
+
+EventModel* EventListModel::event(int row) const
+{
+    Q_ASSERT(row >= 0 && row < count_);
+
+    QHash<int, EventModel*>::const_iterator it = cache_.constFind(row);
+    if (it != cache_.constEnd())
+    {
+        return *it;
+    }
+
+    if (cache_.size() >= max_cached_events)
+    {
+        cache_.clear();
+    }
+
+    EventModel* eventPtr = model_->eventOccurrence(first_ + row);
+    cache_.insert(row, eventPtr);
+    return eventPtr;
+}
+
+int EventListModel::nearestRow(const Time& time) const
+{
+    if (count_ == 0)
+    {
+        return -1;
+    }
+
+    // The first event at time or later, and the one before it.
+    int row = qBound(0, model_->eventOccurrencesBefore(time) - first_, count_ - 1);
+    if (row > 0 && distance(time, event(row - 1)->time) <= distance(time, event(row)->time))
+    {
+        --row;
+    }
+    return row;
+}
+
+int EventListModel::findRow(EventModel* eventPtr) const
+{
+    for (int row = qMax(0, model_->eventOccurrencesBefore(eventPtr->time) - first_);
+         row < count_ && !(eventPtr->time < event(row)->time); ++row)
+    {
+        if (*event(row) == *eventPtr)
+        {
+            return row;
+        }
+    }
+    return -1;
+}
+
+void EventListModel::updateTime()
+{
+    if (count_ != 0)
+    {
+        emit dataChanged(index(0, 0), index(count_ - 1, 0));
+    }
+}
+
+int EventListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : count_;
+}
+
+int EventListModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant EventListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+    {
+        return QVariant();
+    }
+
+    if (index.column() == 0 && role == Qt::DisplayRole)
+    {
+        return event(index.row())->time.toString();
+    }
+    if (index.column() == 1 && (role == Qt::DisplayRole || role == Qt::ToolTipRole))
+    {
+        return event(index.row())->shortDescription();
+    }
+    return QVariant();
+}
+
 EventList::EventList(QWidget* parent) :
-    QTreeView(parent)
+    QTreeView(parent),
+    events(nullptr)
 {
     /** some Qt decorations */
     setRootIsDecorated(false);
     setEditTriggers(NoEditTriggers);
     setHeaderHidden(true);
+    setUniformRowHeights(true);
 }
 
 /** time is used to select first event with this time */
 void EventList::showEvents(TraceModelPtr& traceModel, const Time& time)
 {
     //? maybe better to clear model, not to delete it
-    delete model();
-    events.clear();
+    delete events;
 
-    QStandardItemModel* modelPtr = new QStandardItemModel(this);
-    modelPtr->insertColumns(0, 2);
-    QTreeView::setModel(modelPtr);
+    events = new EventListModel(this, traceModel);
+    QTreeView::setModel(events);
     connect(this->selectionModel(), SIGNAL(currentChanged(const QModelIndex &, const QModelIndex &)),this,
                                     SLOT(eventListRowChanged()));
 
-    int nearestEvent = -1;
-    Time minDistance;//? min time range not initialized
-    int row = 0;
-
-    for(auto eventPtr = traceModel->getNextEvent(); eventPtr ;eventPtr = traceModel->getNextEvent(), ++row)
-    {
-        model()->insertRow(row);
-
-        if (nearestEvent == -1 || distance(time, eventPtr->time) < minDistance)
-        {
-            nearestEvent = row;
-            minDistance = distance(time, eventPtr->time);
-        }
-
-        QModelIndex index = model()->index(row, 0, QModelIndex());
-        model()->setData(index, eventPtr->time.toString());
-        index = model()->index(row, 1, QModelIndex());
-        model()->setData(index, eventPtr->shortDescription());
-        model()->setData(index, eventPtr->shortDescription(), Qt::ToolTipRole);
-        events.push_back(eventPtr);
-    }
-
     setAlternatingRowColors(true);
 
     resizeColumnToContents(0);
     resizeColumnToContents(1);
 
+    int nearestEvent = events->nearestRow(time);
     if (nearestEvent != -1)
     {
-        selectionModel()->setCurrentIndex(this->model()->index(nearestEvent, 0), QItemSelectionModel::Select);
-        selectionModel()->select(this->model()->index(nearestEvent, 0), QItemSelectionModel::Select);
-        selectionModel()->select(this->model()->index(nearestEvent, 1), QItemSelectionModel::Select);
+        selectionModel()->setCurrentIndex(events->index(nearestEvent, 0), QItemSelectionModel::Select);
+        selectionModel()->select(events->index(nearestEvent, 0), QItemSelectionModel::Select);
+        selectionModel()->select(events->index(nearestEvent, 1), QItemSelectionModel::Select);
+        scrollTo(events->index(nearestEvent, 0));
     }
 }
 
 void EventList::updateTime()
 {
-    for(int i = 0; i < events.size(); ++i)
+    if (!events)
     {
-        QModelIndex index = model()->index(i, 0, QModelIndex());
-        model()->setData(index, events[i]->time.toString());
+        return;
     }
+    events->updateTime();
     resizeColumnToContents(0);
 }
 
 EventModel* EventList::currentEvent()
 {
     int row = currentIndex().row();
-    if (row != -1)
+    if (events && row != -1)
     {
-        Q_ASSERT(row < events.size());
-        return events[row];
+        return events->event(row);
     }
     return nullptr;
 }
 
 void EventList::setCurrentEvent(EventModel* eventPtr)
 {
-    for(int i = 0; i < events.size(); ++i)
+    int row = events->findRow(eventPtr);
+    if (row != -1)
     {
-        if ((*events[i]) == *eventPtr)
-        {
-            QModelIndex index = model()->index(i, 0, QModelIndex());
-            setCurrentIndex(index);
-            scrollTo(index);
-            return;
-        }
+        QModelIndex index = events->index(row, 0);
+        setCurrentIndex(index);
+        scrollTo(index);
+        return;
     }
     qFatal("Can't find given event in the list");
 }
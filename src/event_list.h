@@ -2,8 +2,8 @@
 #define EVENT_LIST_H
 
 #include <QtWidgets/QTreeView>
-#include <QStandardItemModel>
-#include <QVector>
+#include <QAbstractTableModel>
+#include <QHash>
 
 #include "trace_model.h"
 
@@ -11,6 +11,44 @@ namespace vis4 {
 
 class EventModel;
 
+/**
+ * Events of a trace model in its time range, as a table of time
+ * and description. Rows are looked up in the trace's occurrence
+ * index when they are shown, nothing is collected in advance.
+ */
+class EventListModel : public QAbstractTableModel
+{
+public:
+    EventListModel(QObject* parent, TraceModelPtr& model);
+
+    /** Returns the event of the row. */
+    EventModel* event(int row) const;
+
+    /** Returns the row of the event nearest to time, or -1 if there are no events. */
+    int nearestRow(const Time& time) const;
+
+    /** Returns the row of the event, or -1. */
+    int findRow(EventModel* event) const;
+
+    /** Tells views that times should be formatted again. */
+    void updateTime();
+
+public: /* overloaded item model methods */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+
+private:
+    TraceModelPtr model_;
+
+    /** Occurrence number of the first row. */
+    int first_;
+    int count_;
+
+    /** Recently shown events by row. */
+    mutable QHash<int, EventModel*> cache_;
+};
+
 class EventList : public QTreeView
 {
     Q_OBJECT
@@ -32,7 +70,7 @@ signals:
 private slots:
     void eventListRowChanged();
 private:
-    QVector<EventModel*> events;
+    EventListModel* events;
 };
 
 }
@@ -20,6 +20,9 @@ public:
     /** Event type */
     QString kind;
 
+    /** Event type id. Link to event type in TraceModel::getEvents(). */
+    int type;
+
     /**
      * Буква, используемая для показа события. Визуализатором всегда
      * показывается как заглавная.
@@ -57,12 +60,13 @@ public:
         return kind;
     }
 
-    EventModel() {}
+    EventModel() : type(0) {}
 
-    EventModel(Time time, int component, QString kind, char letter) :
+    EventModel(Time time, int component, QString kind, char letter, int type = 0) :
         time(time),
         component(component),
         kind(kind),
+        type(type),
         letter(letter),
         subletter(' ')
     {}
@@ -0,0 +1,144 @@
+#include "glyph_cache.h"
+
+#include <QPainter>
+#include <QtWidgets/QApplication>
+
+namespace {
+
+/** Label widths are rounded down to this number of pixels. */
+const int label_bucket = 8;
+
+/** Cached labels are dropped when their number exceeds the limit. */
+const int max_labels = 4096;
+
+}
+
+namespace vis4 {
+
+GlyphCache::GlyphCache() :
+    metrics_(QApplication::font()),
+    labelHeight_(0)
+{
+    setFont(QApplication::font());
+}
+
+void GlyphCache::setFont(const QFont& font)
+{
+    if (font == font_ && !letterWidths_.isEmpty())
+    {
+        return;
+    }
+
+    font_ = font;
+    metrics_ = QFontMetrics(font);
+    clear();
+
+    letterWidths_.resize(256);
+    for (int i = 0; i < 256; ++i)
+    {
+        letterWidths_[i] = metrics_.width(QChar((char)i));
+    }
+}
+
+const QFont& GlyphCache::font() const
+{
+    return font_;
+}
+
+int GlyphCache::letterWidth(char letter) const
+{
+    return letterWidths_[(unsigned char)letter];
+}
+
+void GlyphCache::drawLetter(QPainter* painter, const QPoint& position, char letter)
+{
+    int key = (unsigned char)letter;
+
+    QHash<int, Glyph>::const_iterator it = glyphs_.constFind(key);
+    if (it == glyphs_.constEnd())
+    {
+        // Bounding rect is relative to the baseline origin,
+        // so it also gives the offset of the image.
+        QRect bound = metrics_.boundingRect(QChar(letter));
+
+        Glyph glyph;
+        glyph.offset = bound.topLeft();
+        glyph.image = QImage(qMax(bound.width(), 1), qMax(bound.height(), 1),
+                             QImage::Format_ARGB32_Premultiplied);
+        glyph.image.fill(Qt::transparent);
+
+        QPainter p(&glyph.image);
+        p.setRenderHint(QPainter::TextAntialiasing);
+        p.setFont(font_);
+        p.setPen(Qt::black);
+        p.drawText(-bound.left(), -bound.top(), QString(QChar(letter)));
+        p.end();
+
+        it = glyphs_.insert(key, glyph);
+    }
+
+    painter->drawImage(position + it->offset, it->image);
+}
+
+void GlyphCache::drawLabel(QPainter* painter, const QRect& rect, int type, const QString& text)
+{
+    if (rect.height() != labelHeight_)
+    {
+        labels_.clear();
+        labelHeight_ = rect.height();
+    }
+
+    // Type names are the same for all models of a trace, a new
+    // text means another trace is drawn.
+    QHash<int, QPair<QString, int>>::const_iterator info = labelTexts_.constFind(type);
+    if (info == labelTexts_.constEnd() || info->first != text)
+    {
+        if (info != labelTexts_.constEnd())
+        {
+            labels_.clear();
+        }
+        info = labelTexts_.insert(type, qMakePair(text, metrics_.width(text)));
+    }
+
+    // Labels wider than the text are all the same image.
+    int buckets = qMin(rect.width() / label_bucket,
+                       (info->second + label_bucket - 1) / label_bucket);
+    if (buckets <= 0)
+    {
+        return;
+    }
+
+    QPair<int, int> key(type, buckets);
+    QHash<QPair<int, int>, QImage>::const_iterator it = labels_.constFind(key);
+    if (it == labels_.constEnd())
+    {
+        if (labels_.size() >= max_labels)
+        {
+            labels_.clear();
+        }
+
+        QImage image(buckets * label_bucket, labelHeight_,
+                     QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        QPainter p(&image);
+        p.setRenderHint(QPainter::TextAntialiasing);
+        p.setFont(font_);
+        p.setPen(Qt::black);
+        p.drawText(image.rect(), Qt::AlignLeft|Qt::AlignVCenter, text);
+        p.end();
+
+        it = labels_.insert(key, image);
+    }
+
+    painter->drawImage(rect.topLeft(), *it);
+}
+
+void GlyphCache::clear()
+{
+    glyphs_.clear();
+    labels_.clear();
+    labelTexts_.clear();
+}
+
+}
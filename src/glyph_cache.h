@@ -0,0 +1,71 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QImage>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QString>
+
+class QPainter;
+
+namespace vis4 {
+
+/**
+ * Cache of pre-rendered text for one font.
+ *
+ * Event letters are rendered once per character and state labels
+ * once per (state type, width bucket), then blitted as images.
+ * Label width is rounded down to the bucket, so a label is elided
+ * at most by one bucket compared to drawing it directly.
+ *
+ * Text is rendered in black on transparent background.
+ */
+class GlyphCache
+{
+public:
+    GlyphCache();
+
+    /** Sets the font, dropping cached images if it changes. */
+    void setFont(const QFont& font);
+    const QFont& font() const;
+
+    /** Width of the letter, like QFontMetrics::width. */
+    int letterWidth(char letter) const;
+
+    /** Draws the letter with baseline origin at 'position',
+        like QPainter::drawText(QPoint, QChar) does. */
+    void drawLetter(QPainter* painter, const QPoint& position, char letter);
+
+    /** Draws the label of state type left aligned and vertically
+        centered in 'rect', clipped to the rect. */
+    void drawLabel(QPainter* painter, const QRect& rect, int type, const QString& text);
+
+    void clear();
+
+private:
+    struct Glyph
+    {
+        QImage image;
+        QPoint offset;
+    };
+
+    QFont font_;
+    QFontMetrics metrics_;
+
+    QVector<int> letterWidths_;
+    QHash<int, Glyph> glyphs_;
+
+    /** Label images by (state type, width in buckets). */
+    QHash<QPair<int, int>, QImage> labels_;
+
+    /** Text and its full width for every state type. */
+    QHash<int, QPair<QString, int>> labelTexts_;
+    int labelHeight_;
+};
+
+}
+
+#endif // GLYPH_CACHE_H
@@ -0,0 +1,82 @@
+#include "interval_index.h"
+
+#include <algorithm>
+
+namespace vis4 {
+
+void IntervalIndex::build(const QVector<quint64>& begins, const QVector<quint64>& ends)
+{
+    begins_ = begins;
+
+    // Leaves are padded to a power of two, empty ones never match.
+    int leaves = 1;
+    while (leaves < ends.size())
+    {
+        leaves *= 2;
+    }
+    latest_.fill(0, 2 * leaves);
+    for (int i = 0; i < ends.size(); ++i)
+    {
+        latest_[leaves + i] = ends[i];
+    }
+    for (int node = leaves - 1; node > 0; --node)
+    {
+        latest_[node] = qMax(latest_[2 * node], latest_[2 * node + 1]);
+    }
+}
+
+void IntervalIndex::append(quint64 begin, quint64 end)
+{
+    int leaves = latest_.size() / 2;
+    if (begins_.size() == leaves)
+    {
+        // The tree is full, it is rebuilt with twice as many leaves.
+        QVector<quint64> begins = begins_, ends = latest_.mid(leaves);
+        begins << begin;
+        ends << end;
+        build(begins, ends);
+        return;
+    }
+
+    int node = leaves + begins_.size();
+    begins_ << begin;
+    latest_[node] = end;
+    for (node /= 2; node > 0; node /= 2)
+    {
+        latest_[node] = qMax(latest_[2 * node], latest_[2 * node + 1]);
+    }
+}
+
+QVector<int> IntervalIndex::crossing(quint64 begin, quint64 end, int maximum) const
+{
+    QVector<int> result;
+    if (begins_.isEmpty() || begin > end || maximum == 0)
+    {
+        return result;
+    }
+
+    int limit = std::upper_bound(begins_.begin(), begins_.end(), end) - begins_.begin();
+    collect(1, 0, latest_.size() / 2, limit, begin, maximum, result);
+    return result;
+}
+
+void IntervalIndex::collect(int node, int nodeBegin, int nodeEnd, int limit, quint64 begin,
+                            int maximum, QVector<int>& result) const
+{
+    if (nodeBegin >= limit || latest_[node] < begin || result.size() == maximum)
+    {
+        return;
+    }
+
+    if (nodeEnd - nodeBegin == 1)
+    {
+        result << nodeBegin;
+        return;
+    }
+
+    int middle = (nodeBegin + nodeEnd) / 2;
+    collect(2 * node, nodeBegin, middle, limit, begin, maximum, result);
+    collect(2 * node + 1, middle, nodeEnd, limit, begin, maximum, result);
+}
+
+}
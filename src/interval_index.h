@@ -0,0 +1,43 @@
+#ifndef INTERVAL_INDEX_H
+#define INTERVAL_INDEX_H
+
+#include <QVector>
+
+namespace vis4 {
+
+/**
+ * Index for search of time intervals crossing a range.
+ *
+ * Intervals are ordered by their beginnings, and a segment tree over
+ * this order keeps the latest end of intervals in every node. Intervals
+ * crossing a range are a part of the prefix beginning before the end of
+ * the range, and subtrees ending before the beginning of the range are
+ * skipped, so the search takes O((k + 1) log n) time for k intervals.
+ */
+class IntervalIndex
+{
+public:
+    /** Builds the index, 'begins' must be sorted. */
+    void build(const QVector<quint64>& begins, const QVector<quint64>& ends);
+
+    /** Adds interval after the indexed ones, 'begin' must not be less
+        than the last beginning. Takes amortized O(log n) time. */
+    void append(quint64 begin, quint64 end);
+
+    /** Positions of intervals having a common point with [begin, end], in
+        order. Only the first 'maximum' ones, if it is not negative. */
+    QVector<int> crossing(quint64 begin, quint64 end, int maximum = -1) const;
+
+private:
+    void collect(int node, int nodeBegin, int nodeEnd, int limit, quint64 begin,
+                 int maximum, QVector<int>& result) const;
+
+private:
+    QVector<quint64> begins_;
+    /** Segment tree of the latest ends, node 1 is the root. */
+    QVector<quint64> latest_;
+};
+
+}
+
+#endif // INTERVAL_INDEX_H
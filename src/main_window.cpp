@@ -10,12 +10,18 @@
 #include <QtPrintSupport/QPrintDialog>
 #include <QtWidgets/QDesktopWidget>
 #include <QtWidgets/QMenu>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QMessageBox>
 #include <QDebug>
+#include <QTimer>
+#include <QThreadPool>
+#include <QFileInfo>
 
 #include "main_window.h"
 #include "trace_model.h"
 #include "trace_painter.h"
 #include "canvas.h"
+#include "otf2writer.h"
 #include "tools/tool.h"
 
 namespace vis4 {
@@ -23,7 +29,8 @@ namespace vis4 {
 MainWindow::MainWindow() : 
     QMainWindow(),
     currentTool(nullptr),
-    modeActions(new QActionGroup(this))
+    modeActions(new QActionGroup(this)),
+    followPending(false)
 {}
 
 void MainWindow::initialize(TraceModelPtr& model)
@@ -94,6 +101,77 @@ void MainWindow::initialize(TraceModelPtr& model)
     toolbar->addAction(actPrint);
     connect(actPrint, SIGNAL(triggered()), this, SLOT(actionPrint()));
 
+    actExport = new QAction(tr("Export"), this);
+    actExport->setShortcut(Qt::Key_E);
+    actExport->setToolTip(tr("Export"));
+    actExport->setWhatsThis(
+        tr("<b>Export</b>"
+           "<p>Writes the shown part of the trace to a new OTF2 archive: "
+           "the time range, the components with own lifelines and the "
+           "enabled state types. Messages are written if both their ends "
+           "are exported."));
+    toolbar->addAction(actExport);
+    connect(actExport, SIGNAL(triggered()), this, SLOT(actionExport()));
+
+    actDensity = new QAction(tr("Density"), this);
+    actDensity->setCheckable(true);
+    actDensity->setShortcut(Qt::Key_D);
+    actDensity->setToolTip(tr("Density"));
+    actDensity->setWhatsThis(
+        tr("<b>Density</b>"
+           "<p>Fits all lifelines into the window and shows states as a heatmap. "
+           "The color of a pixel is the state taking most of its time, "
+           "the paler the color, the less busy the lifelines are. "
+           "Events and messages are not shown in this mode."));
+    actDensity->setChecked(settings.value("density_drawing", false).toBool());
+    canvas->setDensityDrawing(actDensity->isChecked());
+    toolbar->addAction(actDensity);
+    connect(actDensity, SIGNAL(toggled(bool)), this, SLOT(actionDensity(bool)));
+
+    actFlame = new QAction(tr("Flame chart"), this);
+    actFlame->setCheckable(true);
+    actFlame->setShortcut(Qt::Key_H);
+    actFlame->setToolTip(tr("Flame chart"));
+    actFlame->setWhatsThis(
+        tr("<b>Flame chart</b>"
+           "<p>Shows nested states of every lifeline on separate rows, "
+           "the outermost state on the top. States too short to be seen "
+           "are merged into gray spans."));
+    actFlame->setChecked(settings.value("flame_drawing", false).toBool());
+    canvas->setFlameDrawing(actFlame->isChecked());
+    toolbar->addAction(actFlame);
+    connect(actFlame, SIGNAL(toggled(bool)), this, SLOT(actionFlame(bool)));
+
+    actClusters = new QAction(tr("Clusters"), this);
+    actClusters->setCheckable(true);
+    actClusters->setShortcut(Qt::Key_C);
+    actClusters->setToolTip(tr("Clusters"));
+    actClusters->setWhatsThis(
+        tr("<b>Clusters</b>"
+           "<p>Groups components with similar behaviour and shows one "
+           "representative lifeline for every group, with the number of "
+           "components in it. Click the label of a group to show all of its components."));
+    toolbar->addAction(actClusters);
+    connect(actClusters, SIGNAL(toggled(bool)), this, SLOT(actionClusters(bool)));
+
+    actFollow = new QAction(tr("Follow"), this);
+    actFollow->setCheckable(true);
+    actFollow->setShortcut(Qt::Key_W);
+    actFollow->setToolTip(tr("Follow"));
+    actFollow->setWhatsThis(
+        tr("<b>Follow</b>"
+           "<p>Reads records appended to the trace file while it is written, "
+           "every second. If the end of the trace is shown, the diagram "
+           "extends to show the new records. Only XML traces can be followed."));
+    toolbar->addAction(actFollow);
+    connect(actFollow, SIGNAL(toggled(bool)), this, SLOT(actionFollow(bool)));
+
+    followTimer = new QTimer(this);
+    followTimer->setInterval(1000);
+    connect(followTimer, SIGNAL(timeout()), this, SLOT(followTrace()));
+    // Queued, so records are appended after the drawing has returned.
+    connect(canvas, SIGNAL(idle()), this, SLOT(canvasIdle()), Qt::QueuedConnection);
+
     toolbar->addAction(QWhatsThis::createAction(this));
 
 
@@ -175,6 +253,11 @@ void MainWindow::initCanvas(TraceModelPtr & model)
         }
     }//? is this working?
 
+    if (qgetenv("VIS3_RASTER_DRAWING") == "1")
+    {
+        canvas->setRasterDrawing(true);
+    }
+
     // Prevent trace drawing until window geometry restore.
     canvas->setVisible(false);
 
@@ -356,6 +439,10 @@ void MainWindow::modelChanged(TraceModelPtr& model)
     saveModel(model);
     // Disable/enable printing button
     actPrint->setEnabled(model->getVisibleComponents().size() != 0);
+
+    actClusters->blockSignals(true);
+    actClusters->setChecked(model->clustered());
+    actClusters->blockSignals(false);
 }
 
 void MainWindow::showEvent(EventModel* event)
@@ -376,6 +463,93 @@ void MainWindow::browse()
     activateTool(browser);
 }
 
+void MainWindow::actionDensity(bool enabled)
+{
+    QSettings settings;
+    settings.setValue("density_drawing", enabled);
+
+    canvas->setDensityDrawing(enabled);
+}
+
+void MainWindow::actionFlame(bool enabled)
+{
+    QSettings settings;
+    settings.setValue("flame_drawing", enabled);
+
+    canvas->setFlameDrawing(enabled);
+}
+
+void MainWindow::actionClusters(bool enabled)
+{
+    // Clustering may still be computed in background.
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    TraceModelPtr clustered = model()->setClustered(enabled);
+    QApplication::restoreOverrideCursor();
+
+    canvas->setModel(clustered);
+}
+
+void MainWindow::actionFollow(bool enabled)
+{
+    if (enabled)
+    {
+        followTimer->start();
+        followTrace();
+    }
+    else
+    {
+        followTimer->stop();
+        followPending = false;
+    }
+}
+
+void MainWindow::followTrace()
+{
+    // Drawing processes events, so the timer may fire while cursors
+    // walk the stores. Records are appended when the drawing is over.
+    if (!canvas->isIdle())
+    {
+        followPending = true;
+        return;
+    }
+    followPending = false;
+
+    // Background computations read the trace data without locks,
+    // so records are appended only when none of them is running.
+    if (QThreadPool::globalInstance()->activeThreadCount())
+    {
+        return;
+    }
+    canvas->setModel(model()->readAppended());
+}
+
+void MainWindow::canvasIdle()
+{
+    if (followPending && followTimer->isActive())
+    {
+        followTrace();
+    }
+}
+
+void MainWindow::actionExport()
+{
+    QString filename = QFileDialog::getSaveFileName(
+        this, tr("Export to OTF2"), QString(), tr("OTF2 archives (*.otf2)"));
+    if (filename.isEmpty()) return;
+
+    // The archive is a file with a directory of the same name next to it.
+    QFileInfo archive(filename);
+    QString error;
+    QApplication::setOverrideCursor(Qt::BusyCursor);
+    bool written = OTF2Writer::write(model(), archive.absolutePath(), archive.completeBaseName(), &error);
+    QApplication::restoreOverrideCursor();
+
+    if (!written)
+    {
+        QMessageBox::warning(this, tr("Export"), error);
+    }
+}
+
 void MainWindow::actionPrint()
 {
     QPrinter printer;
@@ -627,10 +801,14 @@ void MainWindow::xinitialize(QWidget* toolContainer, Canvas* canvas)
 
     installTool(createFilter(toolContainer, canvas));//частично работает
 
-    //Tool* find = createFind(toolContainer, canvas);//не работает
-    //installTool(find);
-    //connect(find, SIGNAL(extraHelp(const QString&)), browser,
-    //              SLOT(extraHelp(const QString&)));
+    Tool* find = createFind(toolContainer, canvas);
+    installTool(find);
+    connect(find, SIGNAL(extraHelp(const QString&)), browser,
+                  SLOT(extraHelp(const QString&)));
+
+    installTool(createCommunication(toolContainer, canvas));
+    installTool(createCallTree(toolContainer, canvas));
+    installTool(createCompare(toolContainer, canvas));
 }
 
 }
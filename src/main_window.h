@@ -16,6 +16,7 @@ class QActionGroup;
 class QToolBar;
 class QDocWidget;
 class QStackedWidget;
+class QTimer;
 
 namespace vis4 {
 
@@ -121,6 +122,24 @@ private slots:
     /** Print trace on printer. */
     void actionPrint();
 
+    /** Writes the shown part of the trace to an OTF2 archive. */
+    void actionExport();
+
+    /** Switches density drawing of the trace and remembers it. */
+    void actionDensity(bool enabled);
+
+    /** Switches flame chart drawing of the trace and remembers it. */
+    void actionFlame(bool enabled);
+
+    /** Collapses lifelines of similar components, or shows all of them. */
+    void actionClusters(bool enabled);
+
+    /** Starts or stops reading records appended to the trace. */
+    void actionFollow(bool enabled);
+    void followTrace();
+    /** Appends records that came while the trace was drawn. */
+    void canvasIdle();
+
     void mouseEvent(QEvent* event,
                     Canvas::clickTarget target,
                     int component,
@@ -155,6 +174,14 @@ private:
     QStackedWidget* sidebarContents;
 
     QAction* actPrint;
+    QAction* actExport;
+    QAction* actDensity;
+    QAction* actFlame;
+    QAction* actClusters;
+    QAction* actFollow;
+    QTimer* followTimer;
+    /** Records were polled for while the canvas was not idle. */
+    bool followPending;
 
     QList<QAction*> freestandingTools;
     QVector<Tool*> tools_list;
@@ -1,3 +0,0 @@
-#include "message_model.h"
-
-
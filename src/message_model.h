@@ -1,21 +1,23 @@
 #ifndef MESSAGE_MODEL_H
 #define MESSAGE_MODEL_H
 
-#include "time_vis.h"
+#include <QtGlobal>
 
 namespace vis4 {
 
-class MessageModel
+/**
+ * Message from one component to another. Messages are kept by value
+ * in MessageStore, so the model has no pointers and no containers,
+ * times are in nanoseconds.
+ */
+struct MessageModel
 {
-public:
-    struct Point
-    {
-        int location;
-        Time time;
-    };
-
-    Point from;
-    QVector<Point> to;
+    quint64 sendTime;
+    quint64 receiveTime;
+    int sender;
+    int receiver;
+    quint32 tag;
+    quint64 size;
 };
 
 }
@@ -0,0 +1,119 @@
+#include "message_store.h"
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+quint64 earliest(const MessageModel& m)
+{
+    return qMin(m.sendTime, m.receiveTime);
+}
+
+quint64 latest(const MessageModel& m)
+{
+    return qMax(m.sendTime, m.receiveTime);
+}
+
+}
+
+void MessageStore::build(const QVector<MessageModel>& messages)
+{
+    messages_ = messages;
+    std::stable_sort(messages_.begin(), messages_.end(),
+                     [](const MessageModel& a, const MessageModel& b)
+                     { return earliest(a) < earliest(b); });
+
+    QVector<quint64> begins(messages_.size()), ends(messages_.size());
+    for (int i = 0; i < messages_.size(); ++i)
+    {
+        begins[i] = earliest(messages_[i]);
+        ends[i] = latest(messages_[i]);
+    }
+    index_.build(begins, ends);
+}
+
+void MessageStore::append(const QVector<MessageModel>& messages)
+{
+    QVector<MessageModel> sorted = messages;
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](const MessageModel& a, const MessageModel& b)
+                     { return earliest(a) < earliest(b); });
+
+    if (!sorted.isEmpty() && !messages_.isEmpty() &&
+        earliest(sorted.first()) < earliest(messages_.last()))
+    {
+        build(messages_ + sorted);
+        return;
+    }
+
+    foreach (const MessageModel& m, sorted)
+    {
+        messages_ << m;
+        index_.append(earliest(m), latest(m));
+    }
+}
+
+int MessageStore::size() const
+{
+    return messages_.size();
+}
+
+const MessageModel& MessageStore::message(int index) const
+{
+    return messages_[index];
+}
+
+QVector<int> MessageStore::crossing(quint64 begin, quint64 end) const
+{
+    return index_.crossing(begin, end);
+}
+
+void MessageMatcher::send(quint64 sender, quint64 receiver, quint32 tag, quint32 communicator,
+                          int component, quint64 size, quint64 time)
+{
+    Channel channel(qMakePair(sender, receiver), qMakePair(tag, communicator));
+
+    auto receives = receives_.find(channel);
+    if (receives != receives_.end() && !receives->isEmpty())
+    {
+        MessageModel message = receives->dequeue();
+        message.sendTime = time;
+        message.sender = component;
+        message.size = size;
+        messages_ << message;
+    }
+    else
+    {
+        MessageModel message = { time, 0, component, -1, tag, size };
+        sends_[channel].enqueue(message);
+    }
+}
+
+void MessageMatcher::receive(quint64 sender, quint64 receiver, quint32 tag, quint32 communicator,
+                             int component, quint64 time)
+{
+    Channel channel(qMakePair(sender, receiver), qMakePair(tag, communicator));
+
+    auto sends = sends_.find(channel);
+    if (sends != sends_.end() && !sends->isEmpty())
+    {
+        MessageModel message = sends->dequeue();
+        message.receiveTime = time;
+        message.receiver = component;
+        messages_ << message;
+    }
+    else
+    {
+        MessageModel message = { 0, time, -1, component, tag, 0 };
+        receives_[channel].enqueue(message);
+    }
+}
+
+const QVector<MessageModel>& MessageMatcher::messages() const
+{
+    return messages_;
+}
+
+}
@@ -0,0 +1,73 @@
+#ifndef MESSAGE_STORE_H
+#define MESSAGE_STORE_H
+
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QQueue>
+
+#include "message_model.h"
+#include "interval_index.h"
+
+namespace vis4 {
+
+/**
+ * Messages of a trace with an index by time of both endpoints.
+ *
+ * Messages are kept by value, ordered by the earlier of their two
+ * times, and are indexed as intervals between the two times, so
+ * arrows crossing the visible range are found without walking the
+ * whole store.
+ */
+class MessageStore
+{
+public:
+    void build(const QVector<MessageModel>& messages);
+
+    /** Adds messages read after the build. Messages earlier than the
+        last stored one make the store rebuilt, others are indexed
+        one by one. */
+    void append(const QVector<MessageModel>& messages);
+
+    int size() const;
+    const MessageModel& message(int index) const;
+
+    /** Indices of messages sent or received within [begin, end], or
+        passing over it, in order of their earlier time. */
+    QVector<int> crossing(quint64 begin, quint64 end) const;
+
+private:
+    QVector<MessageModel> messages_;
+    IntervalIndex index_;
+};
+
+/**
+ * Pairs sends and receives, reported by a reader, into messages.
+ *
+ * Endpoints are identified as the trace does it (process ids, ranks),
+ * and the component of the reporting side is saved in the message.
+ * Sends and receives with the same endpoints, tag and communicator
+ * are matched in order, as MPI does. Either of them may come first,
+ * since clocks of components are not exactly synchronized.
+ */
+class MessageMatcher
+{
+public:
+    void send(quint64 sender, quint64 receiver, quint32 tag, quint32 communicator,
+              int component, quint64 size, quint64 time);
+    void receive(quint64 sender, quint64 receiver, quint32 tag, quint32 communicator,
+                 int component, quint64 time);
+
+    /** Matched messages. Sends and receives left without a pair are dropped. */
+    const QVector<MessageModel>& messages() const;
+
+private:
+    typedef QPair<QPair<quint64, quint64>, QPair<quint32, quint32>> Channel;
+
+    QVector<MessageModel> messages_;
+    QHash<Channel, QQueue<MessageModel>> sends_;
+    QHash<Channel, QQueue<MessageModel>> receives_;
+};
+}
+
+#endif // MESSAGE_STORE_H
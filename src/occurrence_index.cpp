@@ -0,0 +1,312 @@
+#include "occurrence_index.h"
+#include "state_model.h"
+#include "event_model.h"
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+template <class Model>
+OccurrenceIndex<Model>::OccurrenceIndex() :
+    store_(nullptr),
+    time_(nullptr),
+    generation_(0)
+{}
+
+template <class Model>
+void OccurrenceIndex<Model>::build(const QVector<Model*>* store, Time Model::* time,
+                                   const QVector<QVector<int>>& byType)
+{
+    store_ = store;
+    time_ = time;
+    ++generation_;
+
+    // Stores are filled in order of time, so usually the lists
+    // are already sorted and are shared with the caller.
+    auto less = [this](int a, int b) { return this->less(a, b); };
+
+    byType_ = byType;
+    for (int type = 0; type < byType_.size(); ++type)
+    {
+        const QVector<int>& list = byType_.at(type);
+        if (!std::is_sorted(list.begin(), list.end(), less))
+        {
+            std::sort(byType_[type].begin(), byType_[type].end(), less);
+        }
+    }
+
+    byComponent_.clear();
+    byComponent_.resize(byType_.size());
+    for (int type = 0; type < byType_.size(); ++type)
+    {
+        foreach (int position, byType_[type])
+        {
+            byComponent_[type][int((*store_)[position]->component)].push_back(position);
+        }
+    }
+}
+
+template <class Model>
+void OccurrenceIndex<Model>::append(int from)
+{
+    ++generation_;
+
+    // New objects are usually the latest ones, and go to the ends of lists.
+    auto insert = [this](QVector<int>& list, int position)
+    {
+        if (list.isEmpty() || !this->less(position, list.last()))
+        {
+            list.push_back(position);
+        }
+        else
+        {
+            list.insert(std::upper_bound(list.begin(), list.end(), position,
+                                         [this](int a, int b) { return this->less(a, b); }) - list.begin(),
+                        position);
+        }
+    };
+
+    for (int position = from; position < store_->size(); ++position)
+    {
+        const Model* model = (*store_)[position];
+        if (model->type >= byType_.size())
+        {
+            byType_.resize(model->type + 1);
+            byComponent_.resize(model->type + 1);
+        }
+        insert(byType_[model->type], position);
+        insert(byComponent_[model->type][int(model->component)], position);
+    }
+}
+
+template <class Model>
+typename OccurrenceIndex<Model>::Query OccurrenceIndex<Model>::query(
+    const Selection& types, const QVector<int>& components, bool byComponent) const
+{
+    Query result;
+
+    for (int type = 0; type < byType_.size(); ++type)
+    {
+        if (type >= types.size() || !types.isEnabled(type) || byType_[type].isEmpty())
+        {
+            continue;
+        }
+
+        bool all = true;
+        QList<const QVector<int>*> lists;
+        for (auto it = byComponent_[type].constBegin(); it != byComponent_[type].constEnd(); ++it)
+        {
+            int component = it.key();
+            if (component < components.size() && components[component] != -1)
+            {
+                lists << &it.value();
+            }
+            else
+            {
+                all = false;
+            }
+        }
+
+        // Search across all components uses one list per type.
+        if (all && !byComponent)
+        {
+            result << &byType_[type];
+        }
+        else
+        {
+            foreach (const QVector<int>* list, lists)
+            {
+                result << list;
+            }
+        }
+    }
+
+    return result;
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::count(const Query& query) const
+{
+    int result = 0;
+    foreach (const QVector<int>* list, query)
+    {
+        result += list->size();
+    }
+    return result;
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::countBefore(const Query& query, const Time& time) const
+{
+    return rank(query, time.toULL(), 0);
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::count(int type, int component, const Time& begin, const Time& end) const
+{
+    if (type < 0 || type >= byComponent_.size())
+    {
+        return 0;
+    }
+
+    typename QHash<int, QVector<int>>::const_iterator it = byComponent_[type].constFind(component);
+    if (it == byComponent_[type].constEnd())
+    {
+        return 0;
+    }
+
+    return lowerBound(*it, end.toULL() + 1, 0) - lowerBound(*it, begin.toULL(), 0);
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::occurrence(const Query& query, int n) const
+{
+    if (n < 0 || n >= count(query))
+    {
+        return -1;
+    }
+
+    if (query.size() == 1)
+    {
+        return (*query[0])[n];
+    }
+
+    quint64 low = ~quint64(0);
+    quint64 high = 0;
+    foreach (const QVector<int>* list, query)
+    {
+        if (list->isEmpty()) continue;
+        low = qMin(low, timeAt(list->first()));
+        high = qMax(high, timeAt(list->last()));
+    }
+
+    // Find the time of the occurrence: the latest time,
+    // before which there are no more than n occurrences.
+    while (low < high)
+    {
+        quint64 middle = low + (high - low + 1) / 2;
+        if (rank(query, middle, 0) <= n)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    // Then the position among occurrences with that time.
+    int first = 0;
+    int last = store_->size() - 1;
+    while (first < last)
+    {
+        int middle = first + (last - first + 1) / 2;
+        if (rank(query, low, middle) <= n)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle - 1;
+        }
+    }
+
+    return first;
+}
+
+template <class Model>
+QFuture<QVector<Model*>> OccurrenceIndex<Model>::findAll(const Query& query) const
+{
+    int count = qMin(query.size(), QThread::idealThreadCount() * 4);
+
+    // Largest lists first, each to the smallest part.
+    Query lists = query;
+    std::sort(lists.begin(), lists.end(),
+              [](const QVector<int>* a, const QVector<int>* b) { return a->size() > b->size(); });
+
+    QVector<Query> parts(count);
+    QVector<int> sizes(count, 0);
+    foreach (const QVector<int>* list, lists)
+    {
+        int smallest = std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+        parts[smallest] << list;
+        sizes[smallest] += list->size();
+    }
+
+    Collect collect;
+    collect.index = this;
+    return QtConcurrent::mapped(parts, collect);
+}
+
+template <class Model>
+QVector<Model*> OccurrenceIndex<Model>::Collect::operator()(const Query& part) const
+{
+    return index->collect(part);
+}
+
+template <class Model>
+QVector<Model*> OccurrenceIndex<Model>::collect(const Query& query) const
+{
+    QVector<int> positions;
+    foreach (const QVector<int>* list, query)
+    {
+        positions += *list;
+    }
+    if (query.size() > 1)
+    {
+        std::sort(positions.begin(), positions.end(),
+                  [this](int a, int b) { return less(a, b); });
+    }
+
+    QVector<Model*> result;
+    result.reserve(positions.size());
+    foreach (int position, positions)
+    {
+        result << (*store_)[position];
+    }
+    return result;
+}
+
+template <class Model>
+bool OccurrenceIndex<Model>::less(int a, int b) const
+{
+    quint64 ta = timeAt(a), tb = timeAt(b);
+    return ta < tb || (ta == tb && a < b);
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::rank(const Query& query, quint64 time, int position) const
+{
+    int result = 0;
+    foreach (const QVector<int>* list, query)
+    {
+        result += lowerBound(*list, time, position);
+    }
+    return result;
+}
+
+template <class Model>
+int OccurrenceIndex<Model>::lowerBound(const QVector<int>& list, quint64 time, int position) const
+{
+    auto it = std::lower_bound(list.begin(), list.end(), position,
+        [this, time](int element, int pos)
+        {
+            quint64 t = timeAt(element);
+            return t < time || (t == time && element < pos);
+        });
+    return it - list.begin();
+}
+
+template <class Model>
+quint64 OccurrenceIndex<Model>::timeAt(int position) const
+{
+    return ((*store_)[position]->*time_).toULL();
+}
+
+template class OccurrenceIndex<StateModel>;
+template class OccurrenceIndex<EventModel>;
+
+}
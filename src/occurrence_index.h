@@ -0,0 +1,169 @@
+#ifndef OCCURRENCE_INDEX_H
+#define OCCURRENCE_INDEX_H
+
+#include <QVector>
+#include <QHash>
+#include <QFuture>
+#include <QMutex>
+
+#include "time_vis.h"
+#include "selection.h"
+
+namespace vis4 {
+
+/**
+ * Index of occurrences of states or events, used for search.
+ *
+ * Occurrences are ordered by time (start time for states), ties are
+ * broken by position in the store. For every type the index keeps
+ * positions in that order, both for the whole trace and for every
+ * component. The number of an occurrence, and the occurrence with
+ * given number, are found by binary searches in these lists, so
+ * stepping to the next, previous or n-th match needs no scanning.
+ *
+ * For a query of L lists with n occurrences, counting occurrences
+ * before a time takes O(L log n), and finding the occurrence with
+ * given number O(L log n (log T + log N)), where T is the time span
+ * of the query and N the size of the store. A query across all
+ * components has one list per type, a query of some components has
+ * a list for every one of them.
+ */
+template <class Model>
+class OccurrenceIndex
+{
+public:
+    /** Lists of positions, that form the searched set of occurrences. */
+    typedef QVector<const QVector<int>*> Query;
+
+    OccurrenceIndex();
+
+    /**
+     * Builds the index for the store. 'byType' holds positions of
+     * objects of every type, in store order. 'time' points to the
+     * member of the model, which orders occurrences.
+     */
+    void build(const QVector<Model*>* store, Time Model::* time,
+               const QVector<QVector<int>>& byType);
+
+    /** Adds objects of the store from position 'from' to its end,
+        stored after the index was built. */
+    void append(int from);
+
+    /** Returns a number changed by every build or append, after which
+        earlier queries are not valid. */
+    int generation() const { return generation_; }
+
+    /**
+     * Returns lists for enabled types on enabled components.
+     * Component is enabled if it's in range of 'components'
+     * and the value for it is not -1. If 'byComponent' is set,
+     * every list holds occurrences of one component only.
+     */
+    Query query(const Selection& types, const QVector<int>& components,
+                bool byComponent = false) const;
+
+    /** Returns the number of occurrences. */
+    int count(const Query& query) const;
+
+    /** Returns the number of occurrences before given time. */
+    int countBefore(const Query& query, const Time& time) const;
+
+    /** Returns the number of occurrences of the type
+        on the component within [begin, end]. */
+    int count(int type, int component, const Time& begin, const Time& end) const;
+
+    /** Returns store position of the occurrence with given number,
+        counting from zero, or -1 if there is no such occurrence. */
+    int occurrence(const Query& query, int n) const;
+
+    /**
+     * Collects all occurrences in parallel. Lists of the query are
+     * grouped into parts of similar size, the future has one result
+     * per part, with occurrences of the part ordered by time.
+     */
+    QFuture<QVector<Model*>> findAll(const Query& query) const;
+
+    /** Returns all occurrences, ordered by time. */
+    QVector<Model*> collect(const Query& query) const;
+
+private:
+    /** Collects occurrences of one part for findAll. */
+    struct Collect
+    {
+        typedef QVector<Model*> result_type;
+
+        const OccurrenceIndex* index;
+
+        QVector<Model*> operator()(const Query& part) const;
+    };
+
+    /** Order of occurrences: by time, then by position. */
+    bool less(int a, int b) const;
+
+    /** Number of occurrences ordered before (time, position). */
+    int rank(const Query& query, quint64 time, int position) const;
+    int lowerBound(const QVector<int>& list, quint64 time, int position) const;
+    quint64 timeAt(int position) const;
+
+private:
+    const QVector<Model*>* store_;
+    Time Model::* time_;
+
+    /** Positions ordered by time, for every type. */
+    QVector<QVector<int>> byType_;
+
+    /** Positions ordered by time, for every type and component. */
+    QVector<QHash<int, QVector<int>>> byComponent_;
+
+    int generation_;
+};
+
+/**
+ * Query of an index, kept while the filters it was built for and
+ * the index do not change. Building a query walks the lists of all
+ * components, so models keep their queries instead of building them
+ * for every step of a search. Copies start empty.
+ */
+template <class Model>
+class CachedQuery
+{
+public:
+    typedef typename OccurrenceIndex<Model>::Query Query;
+
+    CachedQuery() : generation_(-1) {}
+    CachedQuery(const CachedQuery&) : generation_(-1) {}
+
+    CachedQuery& operator=(const CachedQuery&)
+    {
+        QMutexLocker lock(&mutex_);
+        generation_ = -1;
+        return *this;
+    }
+
+    /** Returns the query of the index for the filters. */
+    Query get(const OccurrenceIndex<Model>& index, const Selection& types,
+              const QVector<int>& components) const
+    {
+        QMutexLocker lock(&mutex_);
+        if (generation_ != index.generation() || types_.size() != types.size() ||
+            types_ != types || components_ != components)
+        {
+            query_ = index.query(types, components);
+            types_ = types;
+            components_ = components;
+            generation_ = index.generation();
+        }
+        return query_;
+    }
+
+private:
+    mutable QMutex mutex_;
+    mutable int generation_;
+    mutable Selection types_;
+    mutable QVector<int> components_;
+    mutable Query query_;
+};
+
+}
+
+#endif // OCCURRENCE_INDEX_H
@@ -2,6 +2,9 @@
 
 namespace vis4 {
 
+/** Links of event types registered by the reader. */
+enum { ENTER_EVENT = 0, LEAVE_EVENT };
+
 struct OTF2Location
 {
     OTF2_LocationRef      location;
@@ -17,13 +20,53 @@ struct OTF2Region
     OTF2_StringRef name;
 };
 
+struct OTF2SystemTreeNode
+{
+    OTF2_SystemTreeNodeRef self;
+    OTF2_StringRef         name;
+    OTF2_SystemTreeNodeRef parent;
+};
+
+struct OTF2LocationGroup
+{
+    OTF2_LocationGroupRef  self;
+    OTF2_StringRef         name;
+    OTF2_SystemTreeNodeRef parent;
+};
+
+struct OTF2Group
+{
+    OTF2_GroupType   type;
+    OTF2_Paradigm    paradigm;
+    QVector<quint64> members;
+};
+
 struct TestData
 {
     QVector<OTF2Location> locations;
     QVector<OTF2Region> regions;
+    QVector<OTF2SystemTreeNode> nodes;
+    QVector<OTF2LocationGroup> locationGroups;
+    QHash<OTF2_GroupRef, OTF2Group> groups;
+    /** Groups of communicators. */
+    QHash<OTF2_CommRef, OTF2_GroupRef> comms;
     QMap<int, QString> strings;
 };
 
+/** Keys of system tree nodes and location groups in the component tree,
+    locations are keyed by their references. */
+static quint64 nodeKey(OTF2_SystemTreeNodeRef node)
+{
+    return node == OTF2_UNDEFINED_SYSTEM_TREE_NODE ? ComponentTree::NO_PARENT
+                                                   : (quint64(2) << 62) | node;
+}
+
+static quint64 groupKey(OTF2_LocationGroupRef group)
+{
+    return group == OTF2_UNDEFINED_LOCATION_GROUP ? ComponentTree::NO_PARENT
+                                                  : (quint64(1) << 62) | group;
+}
+
 static OTF2_CallbackCode
 Enter_print( OTF2_LocationRef    location,
              OTF2_TimeStamp      time,
@@ -32,11 +75,13 @@ Enter_print( OTF2_LocationRef    location,
              OTF2_RegionRef      region )
 {
     auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
+    int component = arg->links->value(location, -1);
 
-    StateModel* sm = new StateModel(location, region, Time(time), Time(0), Qt::yellow);
+    StateModel* sm = new StateModel(component, region, Time(time), Time(0), Qt::yellow);
+    (*arg->openStates)[component] << arg->states->size();
     arg->states->push_back(sm);
 
-    EventModel* em = new EventModel(Time(time), location, "ENTER", 'E');
+    EventModel* em = new EventModel(Time(time), component, "ENTER", 'E', ENTER_EVENT);
     arg->events->push_back(em);
 
     //std::cout << "Entering region " << region << " at location " << location << " at time " << time << std::endl;
@@ -50,22 +95,31 @@ Leave_print( OTF2_LocationRef    location,
              OTF2_RegionRef      region )
 {
     auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
+    int component = arg->links->value(location, -1);
 
-    for (int i = arg->states->size() - 1; i > 0; --i)
+    // Closes the innermost open state of the component.
+    QVector<int>& open = (*arg->openStates)[component];
+    if (!open.isEmpty())
     {
-        if (location == (*arg->states)[i]->component)
-        {
-            (*arg->states)[i]->end = Time(time);
-            break;
-        }
+        StateModel* state = (*arg->states)[open.takeLast()];
+        state->end = Time(time);
+        arg->durations->add(component, state->type, time - state->start.toULL());
     }
 
-    EventModel* em = new EventModel(Time(time), location, "LEAVE", 'L');
+    EventModel* em = new EventModel(Time(time), component, "LEAVE", 'L', LEAVE_EVENT);
     arg->events->push_back(em);
 
     return OTF2_CALLBACK_SUCCESS;
 }
 
+/** Maps a rank within the communicator to the world rank. */
+static quint64 worldRank(const OTF2_NewHandlerArgument* arg, OTF2_CommRef communicator,
+                         uint32_t rank)
+{
+    const QVector<quint64> members = arg->commRanks->value(communicator);
+    return int(rank) < members.size() ? members[rank] : rank;
+}
+
 static OTF2_CallbackCode
 handleSendMsg(OTF2_LocationRef location,
               OTF2_TimeStamp time,
@@ -77,18 +131,9 @@ handleSendMsg(OTF2_LocationRef location,
               uint64_t length)
 {
     auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
-
-    GroupModel* gm = new GroupModel();
-    gm->id = length;
-    QVector<GroupModel::Point> gmvec;
-    GroupModel::Point sendPoint;
-    sendPoint.component = location;
-    sendPoint.time = Time(time);
-    gmvec.push_back(sendPoint);
-    gm->points = gmvec;
-    gm->type = GroupModel::arrow;
-
-    arg->groups->push_back(gm);
+    arg->messages->send(arg->ranks->value(location), worldRank(arg, communicator, receiver),
+                        tag, communicator,
+                        arg->links->value(location, -1), length, time);
 
     return OTF2_CALLBACK_SUCCESS;
 }
@@ -104,19 +149,69 @@ handleRecvMsg(OTF2_LocationRef location,
               uint64_t length)
 {
     auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
+    arg->messages->receive(worldRank(arg, communicator, sender), arg->ranks->value(location),
+                           tag, communicator,
+                           arg->links->value(location, -1), time);
+
+    return OTF2_CALLBACK_SUCCESS;
+}
+
+static OTF2_CallbackCode
+handleCollectiveBegin(OTF2_LocationRef location,
+                      OTF2_TimeStamp time,
+                      void *userData,
+                      OTF2_AttributeList *attributeList)
+{
+    auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
+    (*arg->collectiveBegins)[location] = time;
+
+    return OTF2_CALLBACK_SUCCESS;
+}
 
-    for (int i = arg->groups->size() - 1; i > 0; --i)
+static OTF2_CallbackCode
+handleCollectiveEnd(OTF2_LocationRef location,
+                    OTF2_TimeStamp time,
+                    void *userData,
+                    OTF2_AttributeList *attributeList,
+                    OTF2_CollectiveOp collectiveOp,
+                    OTF2_CommRef communicator,
+                    uint32_t root,
+                    uint64_t sizeSent,
+                    uint64_t sizeReceived)
+{
+    auto arg = static_cast<OTF2_NewHandlerArgument*>(userData);
+
+    CollectiveModel::Flow flow = CollectiveModel::AllToAll;
+    switch (collectiveOp)
     {
-        if ((*arg->groups)[i]->id == length)
-        {
-            GroupModel::Point recvPoint;
-            recvPoint.component = location;
-            recvPoint.time = Time(time);
-            (*arg->groups)[i]->points.push_back(recvPoint);
+        case OTF2_COLLECTIVE_OP_BCAST:
+        case OTF2_COLLECTIVE_OP_SCATTER:
+        case OTF2_COLLECTIVE_OP_SCATTERV:
+            flow = CollectiveModel::FanOut;
+            break;
+
+        case OTF2_COLLECTIVE_OP_GATHER:
+        case OTF2_COLLECTIVE_OP_GATHERV:
+        case OTF2_COLLECTIVE_OP_REDUCE:
+            flow = CollectiveModel::FanIn;
+            break;
+
+        default:
             break;
-        }
     }
 
+    // The root is a rank within the communicator.
+    quint64 rootRank = CollectiveMatcher::NO_ROOT;
+    if (root != OTF2_UNDEFINED_UINT32)
+    {
+        rootRank = worldRank(arg, communicator, root);
+    }
+
+    quint64 begin = arg->collectiveBegins->take(location);
+    arg->collectives->add(arg->ranks->value(location), communicator, flow, rootRank,
+                          arg->links->value(location, -1), begin ? begin : time, time,
+                          sizeSent, sizeReceived);
+
     return OTF2_CALLBACK_SUCCESS;
 }
 
@@ -133,6 +228,60 @@ GlobDefLocation_Register( void*                 userData,
     return OTF2_CALLBACK_SUCCESS;
 }
 
+static OTF2_CallbackCode
+GlobDefSystemTreeNode_Register( void*                  userData,
+                                OTF2_SystemTreeNodeRef self,
+                                OTF2_StringRef         name,
+                                OTF2_StringRef         className,
+                                OTF2_SystemTreeNodeRef parent )
+{
+    OTF2SystemTreeNode node = {self, name, parent};
+    static_cast<TestData*>(userData)->nodes.push_back(node);
+    return OTF2_CALLBACK_SUCCESS;
+}
+
+static OTF2_CallbackCode
+GlobDefLocationGroup_Register( void*                  userData,
+                               OTF2_LocationGroupRef  self,
+                               OTF2_StringRef         name,
+                               OTF2_LocationGroupType locationGroupType,
+                               OTF2_SystemTreeNodeRef systemTreeParent )
+{
+    OTF2LocationGroup group = {self, name, systemTreeParent};
+    static_cast<TestData*>(userData)->locationGroups.push_back(group);
+    return OTF2_CALLBACK_SUCCESS;
+}
+
+static OTF2_CallbackCode
+GlobDefGroup_Register( void*          userData,
+                       OTF2_GroupRef  self,
+                       OTF2_StringRef name,
+                       OTF2_GroupType groupType,
+                       OTF2_Paradigm  paradigm,
+                       OTF2_GroupFlag groupFlags,
+                       uint32_t       numberOfMembers,
+                       const uint64_t* members )
+{
+    OTF2Group group = {groupType, paradigm, QVector<quint64>()};
+    for (uint32_t i = 0; i < numberOfMembers; ++i)
+    {
+        group.members << members[i];
+    }
+    static_cast<TestData*>(userData)->groups[self] = group;
+    return OTF2_CALLBACK_SUCCESS;
+}
+
+static OTF2_CallbackCode
+GlobDefComm_Register( void*          userData,
+                      OTF2_CommRef   self,
+                      OTF2_StringRef name,
+                      OTF2_GroupRef  group,
+                      OTF2_CommRef   parent )
+{
+    static_cast<TestData*>(userData)->comms[self] = group;
+    return OTF2_CALLBACK_SUCCESS;
+}
+
 static OTF2_CallbackCode
 StringReader(void *userData, OTF2_StringRef self, const char *string)
 {
@@ -156,9 +305,19 @@ TraceData* OTF2Reader::read(QString tracePath)
 
     QVector<EventModel*>* eventsPtr = new QVector<EventModel*>();
     QVector<StateModel*>* statesPtr = new QVector<StateModel*>();
-    QVector<GroupModel*>* groupsPtr = new QVector<GroupModel*>();
 
-    OTF2_NewHandlerArgument ha = {componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, groupsPtr};
+    MessageMatcher messages;
+    CollectiveMatcher collectives;
+    QHash<quint64, quint64> collectiveBegins;
+    DurationSketches durations;
+    QHash<quint64, int> links;
+    QHash<quint64, quint64> ranks;
+    QHash<quint64, QVector<quint64>> commRanks;
+    QHash<int, QVector<int>> openStates;
+    OTF2_NewHandlerArgument ha = {componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, &messages, &collectives, &collectiveBegins, &durations, &links, &ranks, &commRanks, &openStates};
+
+    eventTypesPtr->addItem("ENTER");
+    eventTypesPtr->addItem("LEAVE");
 
     auto reader = OTF2_Reader_Open(tracePath.toUtf8().constData());//should not use QString here
     OTF2_Reader_SetSerialCollectiveCallbacks(reader);
@@ -167,6 +326,10 @@ TraceData* OTF2Reader::read(QString tracePath)
     auto globalDefCallbacks = OTF2_GlobalDefReaderCallbacks_New();
     OTF2_GlobalDefReaderCallbacks_SetRegionCallback(globalDefCallbacks, &regionReader);
     OTF2_GlobalDefReaderCallbacks_SetLocationCallback(globalDefCallbacks, &GlobDefLocation_Register);
+    OTF2_GlobalDefReaderCallbacks_SetSystemTreeNodeCallback(globalDefCallbacks, &GlobDefSystemTreeNode_Register);
+    OTF2_GlobalDefReaderCallbacks_SetLocationGroupCallback(globalDefCallbacks, &GlobDefLocationGroup_Register);
+    OTF2_GlobalDefReaderCallbacks_SetGroupCallback(globalDefCallbacks, &GlobDefGroup_Register);
+    OTF2_GlobalDefReaderCallbacks_SetCommCallback(globalDefCallbacks, &GlobDefComm_Register);
     OTF2_GlobalDefReaderCallbacks_SetStringCallback(globalDefCallbacks, &StringReader);
     OTF2_Reader_RegisterGlobalDefCallbacks(reader,
                                            globalDefReader,
@@ -186,10 +349,54 @@ TraceData* OTF2Reader::read(QString tracePath)
 
     OTF2_Reader_OpenEvtFiles(reader);
 
-    for (unsigned int i = 0; i < testData.locations.size(); ++i)
+    // Locations are placed under their groups and system tree nodes.
+    ComponentTree tree;
+    foreach (const OTF2SystemTreeNode& node, testData.nodes)
+    {
+        tree.add(nodeKey(node.self), testData.strings[node.name], nodeKey(node.parent), false);
+    }
+    foreach (const OTF2LocationGroup& group, testData.locationGroups)
+    {
+        tree.add(groupKey(group.self), testData.strings[group.name], nodeKey(group.parent), false);
+    }
+    foreach (const OTF2Location& location, testData.locations)
+    {
+        tree.add(location.location, testData.strings[location.name],
+                 groupKey(location.locationGroup), true);
+    }
+    links = tree.build(*ha.components);
+
+    // Location groups of MPI processes are numbered by rank.
+    foreach (const OTF2Location& location, testData.locations)
+    {
+        ranks[location.location] = location.locationGroup;
+    }
+
+    // Members of a communicator are locations, or ranks within the
+    // group of all MPI locations.
+    QVector<quint64> allLocations;
+    foreach (const OTF2Group& group, testData.groups)
     {
-        ha.components->addItem(testData.strings[testData.locations[i].name], -1);
+        if (group.type == OTF2_GROUP_TYPE_COMM_LOCATIONS && group.paradigm == OTF2_PARADIGM_MPI)
+        {
+            allLocations = group.members;
+        }
     }
+    for (auto it = testData.comms.constBegin(); it != testData.comms.constEnd(); ++it)
+    {
+        const OTF2Group group = testData.groups.value(it.value());
+        QVector<quint64>& commRank = commRanks[it.key()];
+        foreach (quint64 member, group.members)
+        {
+            if (group.type == OTF2_GROUP_TYPE_COMM_GROUP)
+            {
+                member = (member < quint64(allLocations.size())) ? allLocations[member]
+                                                                 : OTF2_UNDEFINED_LOCATION;
+            }
+            commRank << ranks.value(member, CollectiveMatcher::NO_ROOT);
+        }
+    }
+
     for (unsigned int i = 0; i < testData.regions.size(); ++i)
     {
         ha.stateTypes->addItem(testData.strings[testData.regions[i].name], -1);
@@ -226,6 +433,10 @@ TraceData* OTF2Reader::read(QString tracePath)
                                                     &handleSendMsg);
     OTF2_GlobalEvtReaderCallbacks_SetMpiRecvCallback(event_callbacks,
                                                     &handleRecvMsg);
+    OTF2_GlobalEvtReaderCallbacks_SetMpiCollectiveBeginCallback(event_callbacks,
+                                                                &handleCollectiveBegin);
+    OTF2_GlobalEvtReaderCallbacks_SetMpiCollectiveEndCallback(event_callbacks,
+                                                              &handleCollectiveEnd);
     OTF2_Reader_RegisterGlobalEvtCallbacks(reader,
                                            global_evt_reader,
                                            event_callbacks,
@@ -238,7 +449,7 @@ TraceData* OTF2Reader::read(QString tracePath)
     OTF2_Reader_CloseGlobalEvtReader(reader, global_evt_reader);
     OTF2_Reader_CloseEvtFiles(reader);
     OTF2_Reader_Close(reader);
-    return new TraceData(componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, groupsPtr);
+    return new TraceData(componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, messages.messages(), collectives.store(), durations);
 }
 
 }
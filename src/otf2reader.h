@@ -13,7 +13,20 @@ typedef struct {
     Selection* eventTypes;
     QVector<StateModel*>* states;
     QVector<EventModel*>* events;
-    QVector<GroupModel*>* groups;
+    MessageMatcher* messages;
+    CollectiveMatcher* collectives;
+    /** Beginnings of collective operations in progress, by location. */
+    QHash<quint64, quint64>* collectiveBegins;
+    DurationSketches* durations;
+    /** Links of components by location reference. */
+    const QHash<quint64, int>* links;
+    /** Ranks of locations, which identify senders and receivers. */
+    const QHash<quint64, quint64>* ranks;
+    /** Ranks of locations by communicator and their rank in it. */
+    const QHash<quint64, QVector<quint64>>* commRanks;
+    /** Positions of states not closed yet, by component, the
+        innermost last. */
+    QHash<int, QVector<int>>* openStates;
 } OTF2_NewHandlerArgument;
 
 class OTF2Reader : public TraceReader
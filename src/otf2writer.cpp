@@ -0,0 +1,340 @@
+#include "otf2writer.h"
+#include "state_model.h"
+#include "message_model.h"
+
+#include <QHash>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <otf2/otf2.h>
+#include <otf2/OTF2_Pthread_Locks.h>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+const uint64_t event_chunk_size = 1024 * 1024;
+const uint64_t definition_chunk_size = 4 * 1024 * 1024;
+
+/** Times of the model are in nanoseconds. */
+const uint64_t timer_resolution = 1000000000;
+
+OTF2_FlushType preFlush(void*, OTF2_FileType, OTF2_LocationRef, void*, bool)
+{
+    return OTF2_FLUSH;
+}
+
+OTF2_TimeStamp postFlush(void*, OTF2_FileType, OTF2_LocationRef)
+{
+    return 0;
+}
+
+OTF2_FlushCallbacks flushCallbacks = { &preFlush, &postFlush };
+
+typedef QVector<const MessageModel*> Messages;
+
+/** Result of writing one location. */
+struct LocationOutput
+{
+    quint64 events;
+    /** Regions entered on the location. */
+    QSet<int> regions;
+    bool ok;
+};
+
+/** Sends and receives of a location, merged by time. */
+class MessageCursor
+{
+public:
+    MessageCursor(const Messages& sends, const Messages& receives, const QHash<int, int>& ranks) :
+        sends_(sends), receives_(receives), ranks_(ranks), send_(0), receive_(0)
+    {}
+
+    /** Writes messages before 'time', or at it too if 'inclusive'.
+        Returns false if writing failed. */
+    bool writeUntil(OTF2_EvtWriter* writer, quint64 time, bool inclusive)
+    {
+        forever
+        {
+            quint64 sendTime = (send_ < sends_.size()) ? sends_[send_]->sendTime : ~quint64(0);
+            quint64 receiveTime = (receive_ < receives_.size()) ? receives_[receive_]->receiveTime
+                                                                 : ~quint64(0);
+            quint64 next = qMin(sendTime, receiveTime);
+            if (next == ~quint64(0) || next > time || (next == time && !inclusive))
+            {
+                return true;
+            }
+
+            OTF2_ErrorCode code;
+            if (sendTime <= receiveTime)
+            {
+                const MessageModel* m = sends_[send_++];
+                code = OTF2_EvtWriter_MpiSend(writer, nullptr, m->sendTime, ranks_.value(m->receiver),
+                                              0, m->tag, m->size);
+            }
+            else
+            {
+                const MessageModel* m = receives_[receive_++];
+                code = OTF2_EvtWriter_MpiRecv(writer, nullptr, m->receiveTime, ranks_.value(m->sender),
+                                              0, m->tag, m->size);
+            }
+            if (code != OTF2_SUCCESS)
+            {
+                return false;
+            }
+        }
+    }
+
+private:
+    const Messages& sends_;
+    const Messages& receives_;
+    const QHash<int, int>& ranks_;
+    int send_;
+    int receive_;
+};
+
+}
+
+/** Writes events of one location, identified by its rank. */
+struct OTF2Writer::WriteLocation
+{
+    typedef LocationOutput result_type;
+
+    const TraceModel* model;
+    OTF2_Archive* archive;
+    quint64 begin;
+    quint64 end;
+    const QVector<int>* components;
+    const QHash<int, int>* ranks;
+    /** Messages by rank, ordered by time of sending or receiving. */
+    const QVector<Messages>* sends;
+    const QVector<Messages>* receives;
+
+    LocationOutput operator()(int rank) const
+    {
+        LocationOutput result = { 0, QSet<int>(), false };
+        OTF2_EvtWriter* writer = OTF2_Archive_GetEvtWriter(archive, rank);
+        if (!writer)
+        {
+            return result;
+        }
+
+        // Only states crossing the range are taken, the enclosing ones included.
+        QVector<StateModel*> states = model->rangeStates((*components)[rank]);
+        std::sort(states.begin(), states.end(), startsBefore);
+
+        MessageCursor messages((*sends)[rank], (*receives)[rank], *ranks);
+
+        // Writing stops at the first failed record.
+        bool written = true;
+
+        // Enclosing states as (end, type), clipped by the range and by their parents.
+        QVector<QPair<quint64, int>> stack;
+        auto leave = [&]()
+        {
+            written = messages.writeUntil(writer, stack.last().first, true) &&
+                      OTF2_EvtWriter_Leave(writer, nullptr, stack.last().first,
+                                           stack.last().second) == OTF2_SUCCESS;
+            stack.removeLast();
+        };
+
+        foreach (const StateModel* state, states)
+        {
+            quint64 start = state->start.toULL();
+            quint64 finish = (state->end == Time(0)) ? end : state->end.toULL();
+            if (start > end) break;
+            if (finish < begin) continue;
+
+            start = qMax(start, begin);
+            finish = qMin(finish, end);
+            while (written && !stack.isEmpty() && stack.last().first <= start)
+            {
+                leave();
+            }
+            if (!written) break;
+            if (!stack.isEmpty())
+            {
+                finish = qMin(finish, stack.last().first);
+            }
+
+            written = messages.writeUntil(writer, start, false) &&
+                      OTF2_EvtWriter_Enter(writer, nullptr, start, state->type) == OTF2_SUCCESS;
+            if (!written) break;
+            result.regions << state->type;
+            stack.append(qMakePair(finish, state->type));
+        }
+        while (written && !stack.isEmpty())
+        {
+            leave();
+        }
+        written = written && messages.writeUntil(writer, end, true);
+
+        uint64_t events = 0;
+        written = written && OTF2_EvtWriter_GetNumberOfEvents(writer, &events) == OTF2_SUCCESS;
+        result.events = events;
+        result.ok = (OTF2_Archive_CloseEvtWriter(archive, writer) == OTF2_SUCCESS) && written;
+        return result;
+    }
+};
+
+bool OTF2Writer::write(const TraceModelPtr& model, const QString& archivePath,
+                       const QString& archiveName, QString* error)
+{
+    auto fail = [error](const QString& message)
+    {
+        if (error) *error = message;
+        return false;
+    };
+
+    // Exported locations, ranks are their positions in this list.
+    QVector<int> components;
+    QHash<int, int> ranks;
+    for (int component = 0; component < model->getComponents().size(); ++component)
+    {
+        if (model->lifeline(component) != -1 && !model->hasChildren(component))
+        {
+            ranks[component] = components.size();
+            components << component;
+        }
+    }
+    if (components.isEmpty())
+    {
+        return fail("No components to export.");
+    }
+
+    quint64 begin = model->getMinTime().toULL();
+    quint64 end = model->getMaxTime().toULL();
+
+    QVector<Messages> sends(components.size()), receives(components.size());
+    int messageCount = 0;
+    if (model->groupsEnabled())
+    {
+        foreach (const MessageModel* m, model->getMessages())
+        {
+            if (!ranks.contains(m->sender) || !ranks.contains(m->receiver) ||
+                m->sendTime < begin || m->sendTime > end ||
+                m->receiveTime < begin || m->receiveTime > end)
+            {
+                continue;
+            }
+            sends[ranks[m->sender]] << m;
+            receives[ranks[m->receiver]] << m;
+            ++messageCount;
+        }
+    }
+    for (int rank = 0; rank < components.size(); ++rank)
+    {
+        std::stable_sort(sends[rank].begin(), sends[rank].end(),
+                         [](const MessageModel* a, const MessageModel* b) { return a->sendTime < b->sendTime; });
+        std::stable_sort(receives[rank].begin(), receives[rank].end(),
+                         [](const MessageModel* a, const MessageModel* b) { return a->receiveTime < b->receiveTime; });
+    }
+
+    OTF2_Archive* archive = OTF2_Archive_Open(archivePath.toUtf8().constData(),
+                                              archiveName.toUtf8().constData(),
+                                              OTF2_FILEMODE_WRITE, event_chunk_size,
+                                              definition_chunk_size, OTF2_SUBSTRATE_POSIX,
+                                              OTF2_COMPRESSION_NONE);
+    if (!archive)
+    {
+        return fail(QString("Can't create archive %1 in %2.").arg(archiveName).arg(archivePath));
+    }
+    OTF2_Archive_SetFlushCallbacks(archive, &flushCallbacks, nullptr);
+    OTF2_Archive_SetSerialCollectiveCallbacks(archive);
+    // Event writers of locations are taken from several threads.
+    OTF2_Pthread_Archive_SetLockingCallbacks(archive, nullptr);
+
+    OTF2_Archive_OpenEvtFiles(archive);
+
+    QVector<int> rankList(components.size());
+    for (int rank = 0; rank < rankList.size(); ++rank)
+    {
+        rankList[rank] = rank;
+    }
+    WriteLocation writeLocation = { model.get(), archive, begin, end, &components, &ranks,
+                                    &sends, &receives };
+    QVector<LocationOutput> outputs =
+        QtConcurrent::blockingMapped<QVector<LocationOutput>>(rankList, writeLocation);
+
+    OTF2_Archive_CloseEvtFiles(archive);
+
+    bool ok = true;
+    QSet<int> regions;
+    foreach (const LocationOutput& output, outputs)
+    {
+        ok = ok && output.ok;
+        regions += output.regions;
+    }
+
+    // Locations have no local definitions, but readers expect their files.
+    OTF2_Archive_OpenDefFiles(archive);
+    for (int rank = 0; rank < components.size(); ++rank)
+    {
+        OTF2_DefWriter* defWriter = OTF2_Archive_GetDefWriter(archive, rank);
+        OTF2_Archive_CloseDefWriter(archive, defWriter);
+    }
+    OTF2_Archive_CloseDefFiles(archive);
+
+    OTF2_GlobalDefWriter* defs = OTF2_Archive_GetGlobalDefWriter(archive);
+    OTF2_GlobalDefWriter_WriteClockProperties(defs, timer_resolution, begin, end - begin);
+
+    // Strings are written before the definitions using them.
+    OTF2_StringRef nextString = 0;
+    auto writeString = [&](const QString& string)
+    {
+        OTF2_GlobalDefWriter_WriteString(defs, nextString, string.toUtf8().constData());
+        return nextString++;
+    };
+    OTF2_StringRef empty = writeString(QString());
+
+    // Regions keep numbers of state types, only the entered ones are defined.
+    QList<int> regionList = regions.toList();
+    std::sort(regionList.begin(), regionList.end());
+    foreach (int region, regionList)
+    {
+        OTF2_StringRef name = writeString(model->getStates().item(region));
+        OTF2_GlobalDefWriter_WriteRegion(defs, region, name, name, empty,
+                                         OTF2_REGION_ROLE_FUNCTION, OTF2_PARADIGM_UNKNOWN,
+                                         OTF2_REGION_FLAG_NONE, empty, 0, 0);
+    }
+
+    OTF2_GlobalDefWriter_WriteSystemTreeNode(defs, 0, writeString("vis4 export"),
+                                             writeString("machine"),
+                                             OTF2_UNDEFINED_SYSTEM_TREE_NODE);
+
+    // Every rank has one location with the same number.
+    QVector<uint64_t> members(components.size());
+    for (int rank = 0; rank < components.size(); ++rank)
+    {
+        OTF2_StringRef name = writeString(model->getComponentName(components[rank], true));
+        OTF2_GlobalDefWriter_WriteLocationGroup(defs, rank, name,
+                                                OTF2_LOCATION_GROUP_TYPE_PROCESS, 0);
+        OTF2_GlobalDefWriter_WriteLocation(defs, rank, name, OTF2_LOCATION_TYPE_CPU_THREAD,
+                                           outputs[rank].events, rank);
+        members[rank] = rank;
+    }
+
+    // Messages are sent within one communicator of all ranks. Its
+    // group lists ranks, which are mapped to locations by the group
+    // of all MPI locations.
+    if (messageCount)
+    {
+        OTF2_GlobalDefWriter_WriteGroup(defs, 0, empty, OTF2_GROUP_TYPE_COMM_LOCATIONS,
+                                        OTF2_PARADIGM_MPI, OTF2_GROUP_FLAG_NONE,
+                                        members.size(), members.data());
+        OTF2_GlobalDefWriter_WriteGroup(defs, 1, empty, OTF2_GROUP_TYPE_COMM_GROUP,
+                                        OTF2_PARADIGM_MPI, OTF2_GROUP_FLAG_NONE,
+                                        members.size(), members.data());
+        OTF2_GlobalDefWriter_WriteComm(defs, 0, writeString("MPI_COMM_WORLD"), 1,
+                                       OTF2_UNDEFINED_COMM);
+    }
+
+    OTF2_Archive_CloseGlobalDefWriter(archive, defs);
+    ok = (OTF2_Archive_Close(archive) == OTF2_SUCCESS) && ok;
+
+    return ok ? true : fail(QString("Writing archive %1 in %2 failed.").arg(archiveName).arg(archivePath));
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef OTF2WRITER_H
+#define OTF2WRITER_H
+
+#include <QString>
+
+#include "trace_model.h"
+
+namespace vis4 {
+
+/**
+ * Writes the part of a trace shown by a model to a new OTF2 archive.
+ *
+ * Locations are the components without children drawn on lifelines
+ * of the model. States of enabled types are written as enter and leave
+ * events, clipped by the time range, and messages are written if both
+ * their ends are exported locations within the range. Every location
+ * becomes a process of its own, which is its MPI rank.
+ *
+ * Locations are written in parallel. Every location takes from the
+ * index of the loaded trace only the states crossing the range, so
+ * the rest of the trace is never read. Only regions with exported
+ * states get definitions.
+ */
+class OTF2Writer
+{
+public:
+    /**
+     * Writes the archive 'archiveName'.otf2 with its directory into
+     * 'archivePath', which must not contain an archive of that name.
+     * Returns false with description in 'error' if writing failed.
+     */
+    static bool write(const TraceModelPtr& model, const QString& archivePath,
+                      const QString& archiveName, QString* error = nullptr);
+
+private:
+    struct WriteLocation;
+};
+
+}
+
+#endif // OTF2WRITER_H
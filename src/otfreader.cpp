@@ -2,10 +2,14 @@
 
 namespace vis4 {
 
+/** Links of event types registered by the reader. */
+enum { ENTER_EVENT = 0, LEAVE_EVENT };
+
 static int handleDefProcess (void* userData, uint32_t stream, uint32_t process, const char *name, uint32_t parent)
 {
     auto arg = static_cast<NewHandlerArgument*>(userData);
-    int current_link = arg->components->addItem(QString(name), -1);//parent -1
+    // Process 0 stands for no parent.
+    arg->tree->add(process, QString(name), parent ? parent : ComponentTree::NO_PARENT, true);
 
     return OTF_RETURN_OK;
 }
@@ -19,15 +23,29 @@ static int handleDefFunction (void* userData, uint32_t stream, uint32_t func, co
     return OTF_RETURN_OK;
 }
 
+static int handleDefCollectiveOperation (void* userData, uint32_t stream, uint32_t collOp, const char *name, uint32_t type, OTF_KeyValueList *list)
+{
+    auto arg = static_cast<NewHandlerArgument*>(userData);
+
+    CollectiveModel::Flow flow = CollectiveModel::AllToAll;
+    if (type == OTF_COLLECTIVE_TYPE_ONE2ALL) flow = CollectiveModel::FanOut;
+    if (type == OTF_COLLECTIVE_TYPE_ALL2ONE) flow = CollectiveModel::FanIn;
+    (*arg->collectiveFlows)[collOp] = flow;
+
+    return OTF_RETURN_OK;
+}
+
 /** Обработчики событий и состояний */
 static int handleEnter (void* userData, uint64_t time, uint32_t function, uint32_t process, uint32_t source, OTF_KeyValueList *list)
 {
     //qDebug() << time << " E proc:" << process;
     auto arg = static_cast<NewHandlerArgument*>(userData);
-    StateModel* sm = new StateModel(process, function, Time(time), Time(0), Qt::yellow);
+    int component = arg->links->value(process, -1);
+    StateModel* sm = new StateModel(component, function, Time(time), Time(0), Qt::yellow);
+    (*arg->openStates)[component] << arg->states->size();
     arg->states->push_back(sm);
 
-    EventModel* em = new EventModel(Time(time), process, "ENTER", 'E');
+    EventModel* em = new EventModel(Time(time), component, "ENTER", 'E', ENTER_EVENT);
     arg->events->push_back(em);
 
     return OTF_RETURN_OK;
@@ -37,16 +55,17 @@ static int handleLeave (void* userData, uint64_t time, uint32_t function, uint32
 {
     //qDebug() << time << " L proc:" << process;
     auto arg = static_cast<NewHandlerArgument*>(userData);
-    for (int i = arg->states->size() - 1; i > 0; --i)
+    int component = arg->links->value(process, -1);
+    // Closes the innermost open state of the component.
+    QVector<int>& open = (*arg->openStates)[component];
+    if (!open.isEmpty())
     {
-        if (process == (*arg->states)[i]->component)
-        {
-            (*arg->states)[i]->end = Time(time);
-            break;
-        }
+        StateModel* state = (*arg->states)[open.takeLast()];
+        state->end = Time(time);
+        arg->durations->add(component, state->type, time - state->start.toULL());
     }
 
-    EventModel* em = new EventModel(Time(time), process, "LEAVE", 'L');
+    EventModel* em = new EventModel(Time(time), component, "LEAVE", 'L', LEAVE_EVENT);
     arg->events->push_back(em);
 
     return OTF_RETURN_OK;
@@ -55,18 +74,7 @@ static int handleLeave (void* userData, uint64_t time, uint32_t function, uint32
 static int handleSendMsg(void *userData, uint64_t time, uint32_t sender, uint32_t receiver, uint32_t group, uint32_t type, uint32_t length, uint32_t source, OTF_KeyValueList *list)
 {
     auto arg = static_cast<NewHandlerArgument*>(userData);
-
-    GroupModel* gm = new GroupModel();
-    gm->id = length;
-    QVector<GroupModel::Point> gmvec;
-    GroupModel::Point sendPoint;
-    sendPoint.component = sender;
-    sendPoint.time = Time(time);
-    gmvec.push_back(sendPoint);
-    gm->points = gmvec;
-    gm->type = GroupModel::arrow;
-
-    arg->groups->push_back(gm);
+    arg->messages->send(sender, receiver, type, group, arg->links->value(sender, -1), length, time);
 
     return OTF_RETURN_OK;
 }
@@ -74,18 +82,19 @@ static int handleSendMsg(void *userData, uint64_t time, uint32_t sender, uint32_
 static int handleRecvMsg(void *userData, uint64_t time, uint32_t recvProc, uint32_t sendProc, uint32_t group, uint32_t type, uint32_t length, uint32_t source, OTF_KeyValueList *list)
 {
     auto arg = static_cast<NewHandlerArgument*>(userData);
+    arg->messages->receive(sendProc, recvProc, type, group, arg->links->value(recvProc, -1), time);
 
-    for (int i = arg->groups->size() - 1; i > 0; --i)
-    {
-        if ((*arg->groups)[i]->id == length)
-        {
-            GroupModel::Point recvPoint;
-            recvPoint.component = recvProc;
-            recvPoint.time = Time(time);
-            (*arg->groups)[i]->points.push_back(recvPoint);
-            break;
-        }
-    }
+    return OTF_RETURN_OK;
+}
+
+static int handleCollectiveOperation(void *userData, uint64_t time, uint32_t process, uint32_t functionToken, uint32_t communicator, uint32_t rootprocess, uint32_t sent, uint32_t received, uint64_t duration, uint32_t source, OTF_KeyValueList *list)
+{
+    auto arg = static_cast<NewHandlerArgument*>(userData);
+    // Process 0 stands for no root.
+    arg->collectives->add(process, communicator,
+                          arg->collectiveFlows->value(functionToken, CollectiveModel::AllToAll),
+                          rootprocess ? rootprocess : CollectiveMatcher::NO_ROOT,
+                          arg->links->value(process, -1), time, time + duration, sent, received);
 
     return OTF_RETURN_OK;
 }
@@ -98,9 +107,18 @@ TraceData* OTFReader::read(QString tracePath)
 
     QVector<EventModel*>* eventsPtr = new QVector<EventModel*>;
     QVector<StateModel*>* statesPtr = new QVector<StateModel*>;
-    QVector<GroupModel*>* groupsPtr = new QVector<GroupModel*>;
 
-    NewHandlerArgument ha = {componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, groupsPtr};
+    MessageMatcher messages;
+    CollectiveMatcher collectives;
+    QHash<quint32, CollectiveModel::Flow> collectiveFlows;
+    DurationSketches durations;
+    ComponentTree tree;
+    QHash<quint64, int> links;
+    QHash<int, QVector<int>> openStates;
+    NewHandlerArgument ha = {componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, &messages, &collectives, &collectiveFlows, &durations, &tree, &links, &openStates};
+
+    eventTypesPtr->addItem("ENTER");
+    eventTypesPtr->addItem("LEAVE");
 
     auto manager = OTF_FileManager_open(100);//? what if > 100?
     assert(manager);
@@ -129,11 +147,19 @@ TraceData* OTFReader::read(QString tracePath)
     OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*)handleRecvMsg, OTF_RECEIVE_RECORD );
     OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_RECEIVE_RECORD );
 
+    /* collective operations */
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*)handleDefCollectiveOperation, OTF_DEFCOLLOP_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_DEFCOLLOP_RECORD );
+
+    OTF_HandlerArray_setHandler( handlers, (OTF_FunctionPointer*)handleCollectiveOperation, OTF_COLLOP_RECORD );
+    OTF_HandlerArray_setFirstHandlerArg( handlers, &ha, OTF_COLLOP_RECORD );
+
     auto reader = OTF_Reader_open( tracePath.toLatin1().data(), manager );
     assert(reader);
 
     // чтение определений и обработка их обработчикоми handlers
     auto ret = OTF_Reader_readDefinitions( reader, handlers );
+    links = tree.build(*componentsPtr);
 
     // чтение событий Events
     OTF_Reader_setRecordLimit(reader, 10000000);
@@ -144,7 +170,7 @@ TraceData* OTFReader::read(QString tracePath)
 
     qDebug() << eventsPtr->size();
 
-    return new TraceData(componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, groupsPtr);
+    return new TraceData(componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, messages.messages(), collectives.store(), durations);
 }
 
 }
@@ -16,7 +16,17 @@ typedef struct {
     Selection* eventTypes;
     QVector<StateModel*>* states;
     QVector<EventModel*>* events;
-    QVector<GroupModel*>* groups;
+    MessageMatcher* messages;
+    CollectiveMatcher* collectives;
+    /** Kinds of collective operations, by definition. */
+    QHash<quint32, CollectiveModel::Flow>* collectiveFlows;
+    DurationSketches* durations;
+    /** Process definitions, and links of components by process. */
+    ComponentTree* tree;
+    const QHash<quint64, int>* links;
+    /** Positions of states not closed yet, by component, the
+        innermost last. */
+    QHash<int, QVector<int>>* openStates;
 } NewHandlerArgument;
 
 class OTFReader : public TraceReader
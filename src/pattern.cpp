@@ -0,0 +1,362 @@
+#include "pattern.h"
+#include "event_model.h"
+#include "state_model.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+/** States of compiled automata. */
+enum
+{
+    Idle = 0,       // nothing is pending, or outside of any 'second' state
+    Waiting = 1,    // some objects are pending
+    Inside = 1      // inside of some 'second' state
+};
+
+}
+
+/**
+ * Runs the automaton over objects of one location,
+ * which must be fed in order of time.
+ */
+template <class Model>
+class Pattern::Runner
+{
+public:
+    Runner(const Pattern& pattern) :
+        pattern_(pattern),
+        state_(Idle),
+        depth_(0),
+        head_(0)
+    {}
+
+    void feed(quint64 time, int symbol, Model* object)
+    {
+        // Time limits expire before anything that happens later.
+        if (pattern_.within_ != 0)
+        {
+            while (head_ < pending_.size() && pending_[head_].first < time)
+            {
+                step(Timeout, time, nullptr);
+            }
+        }
+
+        if (symbol != Other)
+        {
+            step(symbol, time, object);
+        }
+    }
+
+    /** Feeds the end of location and returns matches. */
+    QVector<Model*> finish()
+    {
+        step(End, 0, nullptr);
+        return matches_;
+    }
+
+private:
+    void step(int symbol, quint64 time, Model* object)
+    {
+        const Transition& t = pattern_.transitions_[state_ * SymbolCount + symbol];
+
+        if (t.actions & Report)
+        {
+            matches_ << object;
+        }
+        if (t.actions & ReportPending)
+        {
+            for (int i = head_; i < pending_.size(); ++i)
+            {
+                matches_ << pending_[i].second;
+            }
+        }
+        if (t.actions & ReportOldest)
+        {
+            matches_ << pending_[head_++].second;
+        }
+        if (t.actions & DropOldest)
+        {
+            ++head_;
+        }
+        if (t.actions & Clear)
+        {
+            head_ = pending_.size();
+        }
+        if (head_ == pending_.size())
+        {
+            pending_.clear();
+            head_ = 0;
+        }
+        if (t.actions & Push)
+        {
+            pending_ << qMakePair(time + pattern_.within_, object);
+        }
+        if (t.actions & Enter)
+        {
+            ++depth_;
+        }
+        if ((t.actions & Leave) && depth_ > 0)
+        {
+            --depth_;
+        }
+
+        state_ = (pending_.isEmpty() && depth_ == 0) ? Idle : t.next;
+    }
+
+private:
+    const Pattern& pattern_;
+    int state_;
+
+    /** Nesting counter. */
+    int depth_;
+
+    /** Queue of pending objects with their deadlines, starting at head_. */
+    QVector<QPair<quint64, Model*>> pending_;
+    int head_;
+
+    QVector<Model*> matches_;
+};
+
+struct Pattern::MatchEvents
+{
+    typedef QVector<EventModel*> result_type;
+
+    Pattern pattern;
+    TraceModelPtr model;
+
+    QVector<EventModel*> operator()(int component) const
+    {
+        return pattern.matchEvents(*model, component);
+    }
+};
+
+struct Pattern::MatchStates
+{
+    typedef QVector<StateModel*> result_type;
+
+    Pattern pattern;
+    TraceModelPtr model;
+
+    QVector<StateModel*> operator()(int component) const
+    {
+        return pattern.matchStates(*model, component);
+    }
+};
+
+Pattern::Pattern() :
+    kind_(FollowedBy),
+    target_(-1),
+    within_(0),
+    stateCount_(0)
+{
+    compile();
+}
+
+Pattern::Pattern(Kind kind, const QSet<int>& first, const QSet<int>& second,
+                 int target, const Time& within) :
+    kind_(kind),
+    first_(first),
+    second_(second),
+    target_(target),
+    within_(within.toULL()),
+    stateCount_(0)
+{
+    compile();
+}
+
+Pattern::Kind Pattern::kind() const
+{
+    return kind_;
+}
+
+bool Pattern::matchesStates() const
+{
+    return kind_ == NestedIn || kind_ == NotNestedIn;
+}
+
+QFuture<QVector<EventModel*>> Pattern::matchEvents(const TraceModelPtr& model) const
+{
+    MatchEvents match = { *this, model };
+    return QtConcurrent::mapped(model->lifelineComponents(0, model->getVisibleComponents().size() - 1), match);
+}
+
+QFuture<QVector<StateModel*>> Pattern::matchStates(const TraceModelPtr& model) const
+{
+    MatchStates match = { *this, model };
+    return QtConcurrent::mapped(model->lifelineComponents(0, model->getVisibleComponents().size() - 1), match);
+}
+
+void Pattern::compile()
+{
+    classes_.clear();
+    foreach (int type, first_)
+    {
+        if (type >= classes_.size()) classes_.resize(type + 1);
+        classes_[type] |= First;
+    }
+    foreach (int type, second_)
+    {
+        if (type >= classes_.size()) classes_.resize(type + 1);
+        classes_[type] |= Second;
+    }
+
+    // By default every symbol is ignored.
+    stateCount_ = 2;
+    transitions_.resize(stateCount_ * SymbolCount);
+    for (int state = 0; state < stateCount_; ++state)
+    {
+        for (int symbol = 0; symbol < SymbolCount; ++symbol)
+        {
+            addTransition(state, Symbol(symbol), state, 0);
+        }
+    }
+
+    // An object of both kinds first closes what is pending,
+    // then starts waiting itself.
+    switch (kind_)
+    {
+        case FollowedBy:
+            addTransition(Idle,    First,   Waiting, Push);
+            addTransition(Idle,    Both,    Waiting, Push);
+            addTransition(Waiting, First,   Waiting, Push);
+            addTransition(Waiting, Second,  Idle,    ReportPending|Clear);
+            addTransition(Waiting, Both,    Waiting, ReportPending|Clear|Push);
+            addTransition(Waiting, Timeout, Waiting, DropOldest);
+            addTransition(Waiting, End,     Idle,    Clear);
+        break;
+
+        case NotFollowedBy:
+            addTransition(Idle,    First,   Waiting, Push);
+            addTransition(Idle,    Both,    Waiting, Push);
+            addTransition(Waiting, First,   Waiting, Push);
+            addTransition(Waiting, Second,  Idle,    Clear);
+            addTransition(Waiting, Both,    Waiting, Clear|Push);
+            addTransition(Waiting, Timeout, Waiting, ReportOldest);
+            addTransition(Waiting, End,     Idle,    ReportPending|Clear);
+        break;
+
+        case NestedIn:
+            addTransition(Idle,   Second,    Inside, Enter);
+            addTransition(Idle,   Both,      Inside, Enter);
+            addTransition(Inside, First,     Inside, Report);
+            addTransition(Inside, Second,    Inside, Enter);
+            addTransition(Inside, Both,      Inside, Report|Enter);
+            addTransition(Inside, SecondEnd, Inside, Leave);
+        break;
+
+        case NotNestedIn:
+            addTransition(Idle,   First,     Idle,   Report);
+            addTransition(Idle,   Second,    Inside, Enter);
+            addTransition(Idle,   Both,      Inside, Report|Enter);
+            addTransition(Inside, Second,    Inside, Enter);
+            addTransition(Inside, Both,      Inside, Enter);
+            addTransition(Inside, SecondEnd, Inside, Leave);
+        break;
+    }
+}
+
+void Pattern::addTransition(int state, Symbol symbol, int next, int actions)
+{
+    Transition& t = transitions_[state * SymbolCount + symbol];
+    t.next = next;
+    t.actions = actions;
+}
+
+int Pattern::typeClass(int type) const
+{
+    return (type >= 0 && type < classes_.size()) ? classes_[type] : Other;
+}
+
+QVector<EventModel*> Pattern::matchEvents(const TraceModel& model, int component) const
+{
+    int target = (target_ == -1) ? component : target_;
+
+    QVector<EventModel*> source = model.componentEvents(component);
+    QVector<EventModel*> other;
+    if (target != component)
+    {
+        other = model.componentEvents(target);
+    }
+
+    // Merge events of the component and of the target,
+    // events of the component go first at the same time.
+    Runner<EventModel> runner(*this);
+    int i = 0, j = 0;
+    while (i < source.size() || j < other.size())
+    {
+        if (j == other.size() || (i < source.size() && !(other[j]->time < source[i]->time)))
+        {
+            EventModel* e = source[i++];
+            int symbol = typeClass(e->type);
+            if (target != component) symbol &= First;
+            runner.feed(e->time.toULL(), symbol, e);
+        }
+        else
+        {
+            EventModel* e = other[j++];
+            runner.feed(e->time.toULL(), typeClass(e->type) & Second, e);
+        }
+    }
+
+    return runner.finish();
+}
+
+QVector<StateModel*> Pattern::matchStates(const TraceModel& model, int component) const
+{
+    /** Order of tokens at the same time. */
+    enum { Close, Open, CloseEmpty };
+
+    struct Token
+    {
+        quint64 time;
+        int order;
+        quint64 length;
+        StateModel* state;
+    };
+
+    QVector<Token> tokens;
+    foreach (StateModel* s, model.componentStates(component))
+    {
+        int symbol = typeClass(s->type);
+        if (symbol == Other) continue;
+
+        // Open states end with the trace.
+        quint64 start = s->start.toULL();
+        quint64 end = (s->end == Time(0)) ? ~quint64(0) : qMax(s->end.toULL(), start);
+
+        Token begin = { start, Open, end - start, s };
+        tokens << begin;
+
+        if (symbol & Second)
+        {
+            Token finish = { end, end == start ? CloseEmpty : Close, 0, s };
+            tokens << finish;
+        }
+    }
+
+    // States that end are closed before new ones begin, except
+    // empty ones, which are closed after they begin. Outer states
+    // begin before inner ones.
+    std::stable_sort(tokens.begin(), tokens.end(), [](const Token& a, const Token& b)
+    {
+        if (a.time != b.time) return a.time < b.time;
+        if (a.order != b.order) return a.order < b.order;
+        return a.length > b.length;
+    });
+
+    Runner<StateModel> runner(*this);
+    foreach (const Token& token, tokens)
+    {
+        int symbol = (token.order == Open) ? typeClass(token.state->type) : SecondEnd;
+        runner.feed(token.time, symbol, token.state);
+    }
+
+    return runner.finish();
+}
+
+}
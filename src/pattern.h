@@ -0,0 +1,134 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <QFuture>
+#include <QSet>
+#include <QVector>
+
+#include "time_vis.h"
+#include "trace_model.h"
+
+namespace vis4 {
+
+class EventModel;
+class StateModel;
+
+/**
+ * Pattern over events or states of a location, used by query search.
+ *
+ * Supported patterns are:
+ *  - event of 'first' types (not) followed by event of 'second' types,
+ *    on the same or on the 'target' component, optionally 'within' time;
+ *  - state of 'first' types (not) nested inside state of 'second' types.
+ *
+ * Pattern is compiled to a finite automaton. Objects of a location are
+ * mapped to few symbols by a table over types, and the automaton steps
+ * through a transition table by these symbols. Transitions have actions
+ * on a queue of pending objects (for "followed by") or on a nesting
+ * counter (for "nested"); the automaton is in its initial state exactly
+ * when both are empty.
+ *
+ * Locations are matched independently and in parallel.
+ */
+class Pattern
+{
+public:
+    enum Kind
+    {
+        FollowedBy,
+        NotFollowedBy,
+        NestedIn,
+        NotNestedIn
+    };
+
+    Pattern();
+
+    /**
+     * Compiles the pattern. Types are event types for "followed by"
+     * patterns and state types for nesting ones. 'target' is the
+     * component to look for 'second' events on, -1 means the same
+     * component. Zero 'within' means no time limit.
+     */
+    Pattern(Kind kind, const QSet<int>& first, const QSet<int>& second,
+            int target = -1, const Time& within = Time(0ull));
+
+    Kind kind() const;
+
+    /** Returns true if the pattern matches states, not events. */
+    bool matchesStates() const;
+
+    /**
+     * Runs the pattern over visible components of the model. Every
+     * result of the future holds matches on one component, ordered
+     * by time. Only objects of enabled types are looked at.
+     */
+    QFuture<QVector<EventModel*>> matchEvents(const TraceModelPtr& model) const;
+    QFuture<QVector<StateModel*>> matchStates(const TraceModelPtr& model) const;
+
+private: /* types */
+
+    /** Input symbols of the automaton. */
+    enum Symbol
+    {
+        Other,
+        First,
+        Second,
+        Both,       // object is of both 'first' and 'second' types
+        SecondEnd,  // end of a 'second' state
+        Timeout,    // time limit of the oldest pending object expired
+        End,        // end of the location
+        SymbolCount
+    };
+
+    /** Actions of transitions, applied in order of declaration. */
+    enum Action
+    {
+        Report = 1,         // report the current object
+        ReportPending = 2,  // report all pending objects
+        ReportOldest = 4,   // report and drop the oldest pending object
+        DropOldest = 8,
+        Clear = 16,         // drop all pending objects
+        Push = 32,          // make the current object pending
+        Enter = 64,         // increase nesting counter
+        Leave = 128         // decrease nesting counter
+    };
+
+    struct Transition
+    {
+        int next;
+        int actions;
+    };
+
+    template <class Model> class Runner;
+    struct MatchEvents;
+    struct MatchStates;
+
+private: /* methods */
+
+    void compile();
+    void addTransition(int state, Symbol symbol, int next, int actions);
+
+    /** Symbol bits (First, Second) for the type. */
+    int typeClass(int type) const;
+
+    QVector<EventModel*> matchEvents(const TraceModel& model, int component) const;
+    QVector<StateModel*> matchStates(const TraceModel& model, int component) const;
+
+private: /* members */
+
+    Kind kind_;
+    QSet<int> first_;
+    QSet<int> second_;
+    int target_;
+    quint64 within_;
+
+    /** Symbol bits for every type. */
+    QVector<int> classes_;
+
+    int stateCount_;
+    QVector<Transition> transitions_;
+};
+
+}
+
+#endif // PATTERN_H
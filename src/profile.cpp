@@ -0,0 +1,201 @@
+#include "profile.h"
+#include "state_model.h"
+
+#include <QHash>
+#include <QFile>
+#include <QDataStream>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+const quint32 profile_magic = 0x76697350;
+const quint32 profile_version = 2;
+
+}
+
+QDataStream& operator<<(QDataStream& stream, const RegionProfile& region)
+{
+    return stream << qint32(region.calls) << region.inclusive << region.exclusive
+                  << region.min << region.max;
+}
+
+QDataStream& operator>>(QDataStream& stream, RegionProfile& region)
+{
+    qint32 calls;
+    stream >> calls >> region.inclusive >> region.exclusive >> region.min >> region.max;
+    region.calls = calls;
+    return stream;
+}
+
+void RegionProfile::add(quint64 duration, quint64 self)
+{
+    min = calls ? qMin(min, duration) : duration;
+    max = calls ? qMax(max, duration) : duration;
+    ++calls;
+    inclusive += duration;
+    exclusive += self;
+}
+
+void RegionProfile::merge(const RegionProfile& other)
+{
+    if (!other.calls) return;
+
+    min = calls ? qMin(min, other.min) : other.min;
+    max = calls ? qMax(max, other.max) : other.max;
+    calls += other.calls;
+    inclusive += other.inclusive;
+    exclusive += other.exclusive;
+}
+
+/** Profile of states of one component. */
+struct Profile::ComputeComponent
+{
+    typedef QVector<RegionProfile> result_type;
+
+    int types;
+    quint64 traceEnd;
+
+    /** Open states last till the end of the trace. */
+    quint64 stateEnd(const StateModel* state) const
+    {
+        return (state->end == Time(0)) ? qMax(traceEnd, state->start.toULL()) : state->end.toULL();
+    }
+
+    QVector<RegionProfile> operator()(QVector<StateModel*> states) const
+    {
+        QVector<RegionProfile> result(types);
+        std::sort(states.begin(), states.end(), startsBefore);
+
+        // Enclosing states with their time not spent in nested states yet.
+        QVector<QPair<const StateModel*, quint64>> stack;
+
+        for (int i = 0; i <= states.size(); ++i)
+        {
+            const StateModel* state = (i < states.size()) ? states[i] : nullptr;
+
+            while (!stack.isEmpty() &&
+                   (!state || stateEnd(stack.last().first) <= state->start.toULL()))
+            {
+                const StateModel* closed = stack.last().first;
+                quint64 duration = stateEnd(closed) - closed->start.toULL();
+                result[closed->type].add(duration, stack.last().second);
+                stack.removeLast();
+            }
+
+            if (!state) break;
+
+            quint64 start = state->start.toULL();
+            quint64 end = qMax(stateEnd(state), start);
+            if (!stack.isEmpty())
+            {
+                // Broken nesting is clipped by the enclosing state.
+                quint64 nested = qMin(end, stateEnd(stack.last().first)) - start;
+                stack.last().second -= qMin(nested, stack.last().second);
+            }
+            stack.append(qMakePair(state, end - start));
+        }
+
+        return result;
+    }
+};
+
+Profile Profile::compute(const QVector<StateModel*>& states, int types, quint64 traceEnd)
+{
+    QHash<int, QVector<StateModel*>> byComponent;
+    foreach (StateModel* state, states)
+    {
+        if (state->type >= types) types = state->type + 1;
+        byComponent[int(state->component)] << state;
+    }
+
+    QList<int> components = byComponent.keys();
+    QList<QVector<StateModel*>> parts;
+    foreach (int component, components)
+    {
+        parts << byComponent.take(component);
+    }
+
+    ComputeComponent computeComponent = { types, traceEnd };
+    QList<QVector<RegionProfile>> results =
+        QtConcurrent::blockingMapped<QList<QVector<RegionProfile>>>(parts, computeComponent);
+
+    Profile profile;
+    profile.total_.resize(types);
+    for (int i = 0; i < components.size(); ++i)
+    {
+        for (int type = 0; type < types; ++type)
+        {
+            profile.total_[type].merge(results[i][type]);
+        }
+        profile.components_.insert(components[i], results[i]);
+    }
+    return profile;
+}
+
+bool Profile::isEmpty() const
+{
+    return components_.isEmpty();
+}
+
+const QVector<RegionProfile>& Profile::total() const
+{
+    return total_;
+}
+
+QVector<RegionProfile> Profile::component(int component) const
+{
+    return components_.value(component);
+}
+
+QList<int> Profile::components() const
+{
+    return components_.keys();
+}
+
+bool Profile::load(const QString& filename, int states)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic, version;
+    qint32 savedStates;
+    stream >> magic >> version >> savedStates;
+    if (magic != profile_magic || version != profile_version || savedStates != states)
+    {
+        return false;
+    }
+
+    Profile profile;
+    stream >> profile.total_ >> profile.components_;
+    if (stream.status() != QDataStream::Ok)
+    {
+        return false;
+    }
+
+    *this = profile;
+    return true;
+}
+
+bool Profile::save(const QString& filename, int states) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << profile_magic << profile_version << qint32(states);
+    stream << total_ << components_;
+    return stream.status() == QDataStream::Ok;
+}
+
+}
@@ -0,0 +1,82 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <QVector>
+#include <QMap>
+#include <QString>
+
+namespace vis4 {
+
+class StateModel;
+
+/** Flat profile of one region (state type). Times are in nanoseconds. */
+struct RegionProfile
+{
+    RegionProfile() :
+        calls(0),
+        inclusive(0),
+        exclusive(0),
+        min(0),
+        max(0)
+    {}
+
+    /** Adds one call with given duration and time not spent in nested states. */
+    void add(quint64 duration, quint64 self);
+    void merge(const RegionProfile& other);
+
+    quint64 mean() const { return calls ? inclusive / calls : 0; }
+
+    int calls;
+    quint64 inclusive;
+    quint64 exclusive;
+    quint64 min;
+    quint64 max;
+};
+
+/**
+ * Flat profile of the trace: call count, inclusive and exclusive
+ * time, minimal and maximal duration of every region, for every
+ * component and in total.
+ *
+ * Exclusive time of a state is its duration without states nested
+ * in it on the same component. Calls of a region nested in calls of
+ * the same region are all counted, as usual for flat profiles.
+ */
+class Profile
+{
+public:
+    /** Computes profile of states with 'types' state types,
+        in parallel over components. States left open last till
+        'traceEnd'. */
+    static Profile compute(const QVector<StateModel*>& states, int types, quint64 traceEnd);
+
+    bool isEmpty() const;
+
+    /** Regions of all components, by state type. */
+    const QVector<RegionProfile>& total() const;
+
+    /** Regions of the component, by state type. Empty if the
+        component has no states. */
+    QVector<RegionProfile> component(int component) const;
+
+    /** Components with states, ascending. */
+    QList<int> components() const;
+
+    /**
+     * Profile file is kept next to the trace, so it is computed only
+     * once. 'states' is the number of states in the trace, profile is
+     * not loaded if it was saved for another number of states.
+     */
+    bool load(const QString& filename, int states);
+    bool save(const QString& filename, int states) const;
+
+private:
+    struct ComputeComponent;
+
+    QVector<RegionProfile> total_;
+    QMap<int, QVector<RegionProfile>> components_;
+};
+
+}
+
+#endif // PROFILE_H
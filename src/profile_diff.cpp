@@ -0,0 +1,104 @@
+#include "profile_diff.h"
+#include "selection.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+typedef QHash<QString, QVector<int>> TypesByName;
+
+/** State types by name. Types with the same name are one region. */
+TypesByName typesByName(const Selection& types)
+{
+    TypesByName result;
+    for (int type = 0; type < types.size(); ++type)
+    {
+        result[types.item(type)] << type;
+    }
+    return result;
+}
+
+RegionProfile regionProfile(const Profile& profile, const QVector<int>& types)
+{
+    RegionProfile result;
+    foreach (int type, types)
+    {
+        if (type < profile.total().size())
+        {
+            result.merge(profile.total()[type]);
+        }
+    }
+    return result;
+}
+
+bool largerChange(const RegionDiff& a, const RegionDiff& b)
+{
+    return qAbs(a.inclusiveDelta()) > qAbs(b.inclusiveDelta());
+}
+
+}
+
+/** Joins profiles of the region with given name. */
+struct ProfileDiff::JoinRegion
+{
+    typedef RegionDiff result_type;
+
+    const Profile* first;
+    const Profile* second;
+    const TypesByName* firstTypes;
+    const TypesByName* secondTypes;
+
+    RegionDiff operator()(const QString& name) const
+    {
+        RegionDiff result;
+        result.name = name;
+        result.first = regionProfile(*first, firstTypes->value(name));
+        result.second = regionProfile(*second, secondTypes->value(name));
+        return result;
+    }
+};
+
+ProfileDiff ProfileDiff::compute(const Profile& first, const Selection& firstTypes,
+                                 const Profile& second, const Selection& secondTypes)
+{
+    TypesByName firstByName = typesByName(firstTypes);
+    TypesByName secondByName = typesByName(secondTypes);
+
+    QStringList names = firstByName.keys();
+    foreach (const QString& name, secondByName.keys())
+    {
+        if (!firstByName.contains(name)) names << name;
+    }
+
+    JoinRegion joinRegion = { &first, &second, &firstByName, &secondByName };
+
+    ProfileDiff result;
+    result.regions_ = QtConcurrent::blockingMapped<QVector<RegionDiff>>(names, joinRegion);
+
+    // Regions without calls in both traces are not interesting.
+    result.regions_.erase(std::remove_if(result.regions_.begin(), result.regions_.end(),
+                                         [](const RegionDiff& region) {
+                                             return !region.first.calls && !region.second.calls;
+                                         }),
+                          result.regions_.end());
+    std::stable_sort(result.regions_.begin(), result.regions_.end(), largerChange);
+    return result;
+}
+
+bool ProfileDiff::isEmpty() const
+{
+    return regions_.isEmpty();
+}
+
+const QVector<RegionDiff>& ProfileDiff::regions() const
+{
+    return regions_;
+}
+
+}
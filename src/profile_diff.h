@@ -0,0 +1,52 @@
+#ifndef PROFILE_DIFF_H
+#define PROFILE_DIFF_H
+
+#include <QVector>
+#include <QString>
+
+#include "profile.h"
+
+namespace vis4 {
+
+class Selection;
+
+/** Profiles of one region in two traces. */
+struct RegionDiff
+{
+    QString name;
+    /** Empty if the region is missing in the trace. */
+    RegionProfile first;
+    RegionProfile second;
+
+    qint64 inclusiveDelta() const { return qint64(second.inclusive) - qint64(first.inclusive); }
+    qint64 exclusiveDelta() const { return qint64(second.exclusive) - qint64(first.exclusive); }
+    int callsDelta() const { return second.calls - first.calls; }
+};
+
+/**
+ * Difference of flat profiles of two traces. State types of the
+ * traces have their own numbers, so regions are joined by names;
+ * regions present in one trace only are compared with empty ones.
+ */
+class ProfileDiff
+{
+public:
+    /** Joins totals of the profiles, in parallel over regions.
+        'firstTypes' and 'secondTypes' give names of state types. */
+    static ProfileDiff compute(const Profile& first, const Selection& firstTypes,
+                               const Profile& second, const Selection& secondTypes);
+
+    bool isEmpty() const;
+
+    /** Regions ordered by the change of inclusive time, the largest first. */
+    const QVector<RegionDiff>& regions() const;
+
+private:
+    struct JoinRegion;
+
+    QVector<RegionDiff> regions_;
+};
+
+}
+
+#endif // PROFILE_DIFF_H
@@ -0,0 +1,676 @@
+#include "range_statistics.h"
+#include "state_model.h"
+#include "message_store.h"
+#include "selection.h"
+
+#include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+/** End of the state, or of the trace if the state is not closed. */
+quint64 stateEnd(const StateModel* state, quint64 traceEnd)
+{
+    return (state->end == Time(0)) ? qMax(traceEnd, state->start.toULL()) : state->end.toULL();
+}
+
+}
+
+struct StatisticsIndex::BuildColumn
+{
+    typedef Column result_type;
+
+    /** End of states that are not closed. */
+    quint64 traceEnd;
+
+    Column operator()(const QVector<const StateModel*>& states) const
+    {
+        Column result;
+        sweep(result.intervals, result.tail, states);
+        close(result.intervals, result.tail, traceEnd);
+        return result;
+    }
+};
+
+struct StatisticsIndex::BuildOccupancy
+{
+    typedef QHash<int, QVector<QPair<quint64, int>>> result_type;
+
+    const StatisticsIndex* index;
+
+    /** Types of innermost states of every component. */
+    const QHash<int, QList<int>>* types;
+
+    /** Steps before this time are kept in the merged column. */
+    quint64 from;
+
+    /** Changes of the number of components in states from 'from' on,
+        ordered by time, by type. */
+    QHash<int, QVector<QPair<quint64, int>>> operator()(const QList<int>& leaves) const
+    {
+        QHash<int, QVector<QPair<quint64, int>>> steps;
+        foreach (int leaf, leaves)
+        {
+            foreach (int type, types->value(leaf))
+            {
+                // Segments ending before 'from' are counted already,
+                // the ones crossing it only end after it.
+                const Intervals& intervals = index->innermost_[type][leaf];
+                QVector<QPair<quint64, int>>& list = steps[type];
+                int first = std::lower_bound(intervals.ends.begin(), intervals.ends.end(), from)
+                            - intervals.ends.begin();
+                for (int i = first; i < intervals.starts.size(); ++i)
+                {
+                    if (intervals.starts[i] >= from)
+                    {
+                        list << qMakePair(intervals.starts[i], 1);
+                    }
+                    list << qMakePair(intervals.ends[i], -1);
+                }
+            }
+        }
+
+        for (auto it = steps.begin(); it != steps.end(); ++it)
+        {
+            std::sort(it.value().begin(), it.value().end());
+        }
+        return steps;
+    }
+};
+
+void StatisticsIndex::build(const QVector<StateModel*>& states,
+                            const QVector<QVector<int>>& statesByType,
+                            const MessageStore& messages, quint64 traceEnd)
+{
+    states_.clear();
+    states_.resize(statesByType.size());
+    open_.clear();
+
+    for (int type = 0; type < statesByType.size(); ++type)
+    {
+        // Intervals of every component, ordered by start.
+        QHash<int, QVector<QPair<quint64, quint64>>> byComponent;
+        foreach (int position, statesByType[type])
+        {
+            const StateModel* s = states[position];
+            byComponent[int(s->component)] << qMakePair(s->start.toULL(), stateEnd(s, traceEnd));
+            if (s->end == Time(0))
+            {
+                open_ << qMakePair(type, int(s->component));
+            }
+        }
+
+        for (auto it = byComponent.begin(); it != byComponent.end(); ++it)
+        {
+            QVector<QPair<quint64, quint64>>& list = it.value();
+            std::sort(list.begin(), list.end());
+
+            // Overlapping intervals are joined.
+            Intervals& intervals = states_[type][it.key()];
+            for (int i = 0; i < list.size(); ++i)
+            {
+                if (!intervals.ends.isEmpty() && list[i].first <= intervals.ends.last())
+                {
+                    intervals.ends.last() = qMax(intervals.ends.last(), list[i].second);
+                }
+                else
+                {
+                    intervals.starts << list[i].first;
+                    intervals.ends << list[i].second;
+                }
+            }
+
+            intervals.sums.resize(intervals.starts.size() + 1);
+            intervals.sums[0] = 0;
+            for (int i = 0; i < intervals.starts.size(); ++i)
+            {
+                intervals.sums[i + 1] = intervals.sums[i] + (intervals.ends[i] - intervals.starts[i]);
+            }
+        }
+    }
+
+    // Columns of innermost states are built in parallel over components.
+    QHash<int, QVector<const StateModel*>> byComponent;
+    foreach (const StateModel* s, states)
+    {
+        byComponent[int(s->component)] << s;
+    }
+
+    QList<int> components = byComponent.keys();
+    QList<QVector<const StateModel*>> parts;
+    foreach (int component, components)
+    {
+        parts << byComponent.take(component);
+    }
+
+    BuildColumn buildColumn = { traceEnd };
+    QList<Column> columns = QtConcurrent::blockingMapped<QList<Column>>(parts, buildColumn);
+
+    innermost_.clear();
+    innermost_.resize(statesByType.size());
+    tails_.clear();
+    for (int i = 0; i < components.size(); ++i)
+    {
+        const QHash<int, Intervals>& column = columns[i].intervals;
+        for (auto it = column.constBegin(); it != column.constEnd(); ++it)
+        {
+            if (it.key() >= innermost_.size())
+            {
+                innermost_.resize(it.key() + 1);
+            }
+            innermost_[it.key()][components[i]] = it.value();
+        }
+        tails_[components[i]] = columns[i].tail;
+    }
+
+    sends_.clear();
+    receives_.clear();
+    for (int i = 0; i < messages.size(); ++i)
+    {
+        const MessageModel& m = messages.message(i);
+        sends_[m.sender] << m.sendTime;
+        receives_[m.receiver] << m.receiveTime;
+    }
+
+    for (auto it = sends_.begin(); it != sends_.end(); ++it)
+    {
+        std::sort(it.value().begin(), it.value().end());
+    }
+    for (auto it = receives_.begin(); it != receives_.end(); ++it)
+    {
+        std::sort(it.value().begin(), it.value().end());
+    }
+}
+
+void StatisticsIndex::buildHierarchy(const Selection& components)
+{
+    QList<int> parents;
+    for (int component = 0; component < components.size(); ++component)
+    {
+        if (components.hasChildren(component)) parents << component;
+    }
+
+    occupancy_.clear();
+    leaves_.clear();
+    buildOccupancy(components, parents, 0);
+}
+
+void StatisticsIndex::append(const QVector<StateModel*>& states, int from,
+                             const QVector<MessageModel>& messages, const Selection& components,
+                             quint64 traceEnd)
+{
+    // States not closed last till the new end of the trace.
+    foreach (const QPair<int, int>& key, open_)
+    {
+        Intervals& intervals = states_[key.first][key.second];
+        if (traceEnd > intervals.ends.last())
+        {
+            intervals.ends.last() = traceEnd;
+            intervals.sums.last() = intervals.sums[intervals.sums.size() - 2] +
+                                    (intervals.ends.last() - intervals.starts.last());
+        }
+    }
+
+    // Intervals of new states are joined to the last ones.
+    QHash<int, QVector<const StateModel*>> byComponent;
+    for (int i = from; i < states.size(); ++i)
+    {
+        const StateModel* s = states[i];
+        if (s->type >= states_.size())
+        {
+            states_.resize(s->type + 1);
+        }
+
+        Intervals& intervals = states_[s->type][int(s->component)];
+        if (intervals.sums.isEmpty())
+        {
+            intervals.sums << 0;
+        }
+        quint64 end = stateEnd(s, traceEnd);
+        if (!intervals.ends.isEmpty() && s->start.toULL() <= intervals.ends.last())
+        {
+            intervals.ends.last() = qMax(intervals.ends.last(), end);
+            intervals.sums.last() = intervals.sums[intervals.sums.size() - 2] +
+                                    (intervals.ends.last() - intervals.starts.last());
+        }
+        else
+        {
+            intervals.starts << s->start.toULL();
+            intervals.ends << end;
+            intervals.sums << intervals.sums.last() + (end - s->start.toULL());
+        }
+        if (s->end == Time(0))
+        {
+            open_ << qMakePair(int(s->type), int(s->component));
+        }
+        byComponent[int(s->component)] << s;
+    }
+
+    // Columns with states not closed depend on the end of the trace.
+    for (auto it = tails_.constBegin(); it != tails_.constEnd(); ++it)
+    {
+        if (!it->stack.isEmpty() && it->stack.first().first == ~quint64(0))
+        {
+            byComponent[it.key()];
+        }
+    }
+
+    // Columns change only after the last start of their components,
+    // and merged columns after the earliest of these starts.
+    quint64 changed = ~quint64(0);
+    for (auto it = byComponent.constBegin(); it != byComponent.constEnd(); ++it)
+    {
+        int component = it.key();
+        if (tails_.contains(component))
+        {
+            changed = qMin(changed, tails_[component].time);
+        }
+        foreach (const StateModel* s, it.value())
+        {
+            changed = qMin(changed, s->start.toULL());
+        }
+
+        QHash<int, Intervals> column;
+        for (int type = 0; type < innermost_.size(); ++type)
+        {
+            if (innermost_[type].contains(component))
+            {
+                column.insert(type, innermost_[type].take(component));
+            }
+        }
+
+        Tail& tail = tails_[component];
+        reopen(column, tail);
+        sweep(column, tail, it.value());
+        close(column, tail, traceEnd);
+
+        for (auto c = column.constBegin(); c != column.constEnd(); ++c)
+        {
+            if (c.key() >= innermost_.size())
+            {
+                innermost_.resize(c.key() + 1);
+            }
+            innermost_[c.key()].insert(component, c.value());
+        }
+    }
+
+    // Merged columns of ancestors. Ones never built are built in full.
+    QSet<int> ancestors;
+    foreach (int component, byComponent.keys())
+    {
+        for (int parent = components.itemParent(component); parent != Selection::ROOT;
+             parent = components.itemParent(parent))
+        {
+            ancestors << parent;
+            if (!leaves_.contains(parent))
+            {
+                changed = 0;
+            }
+        }
+    }
+    if (!ancestors.isEmpty())
+    {
+        buildOccupancy(components, ancestors.toList(), changed);
+    }
+
+    // Times of messages are usually the latest ones.
+    auto insert = [](QVector<quint64>& times, quint64 time)
+    {
+        times.insert(std::upper_bound(times.begin(), times.end(), time) - times.begin(), time);
+    };
+    foreach (const MessageModel& m, messages)
+    {
+        insert(sends_[m.sender], m.sendTime);
+        insert(receives_[m.receiver], m.receiveTime);
+    }
+}
+
+void StatisticsIndex::buildOccupancy(const Selection& components, const QList<int>& parents,
+                                     quint64 from)
+{
+    QHash<int, QList<int>> types;
+    for (int type = 0; type < innermost_.size(); ++type)
+    {
+        for (auto it = innermost_[type].constBegin(); it != innermost_[type].constEnd(); ++it)
+        {
+            types[it.key()] << type;
+        }
+    }
+
+    // Leaves of every component with children, subtrees are
+    // contiguous in tree order.
+    QList<QList<int>> leaves;
+    foreach (int component, parents)
+    {
+        QList<int> subtree;
+        int end = components.subtreeEnd(component);
+        for (int position = components.treePosition(component) + 1; position < end; ++position)
+        {
+            int link = components.treeItem(position);
+            if (!components.hasChildren(link)) subtree << link;
+        }
+
+        leaves << subtree;
+        leaves_[component] = subtree.size();
+    }
+
+    BuildOccupancy buildOccupancy = { this, &types, from };
+    QList<QHash<int, QVector<QPair<quint64, int>>>> steps =
+        QtConcurrent::blockingMapped<QList<QHash<int, QVector<QPair<quint64, int>>>>>(
+            leaves, buildOccupancy);
+
+    if (occupancy_.size() < innermost_.size())
+    {
+        occupancy_.resize(innermost_.size());
+    }
+    for (int i = 0; i < parents.size(); ++i)
+    {
+        for (int type = 0; type < occupancy_.size(); ++type)
+        {
+            // Merged columns without new steps are cut at 'from' too.
+            if (steps[i].contains(type) || occupancy_[type].contains(parents[i]))
+            {
+                extend(occupancy_[type][parents[i]], steps[i].value(type), from);
+            }
+        }
+    }
+}
+
+void StatisticsIndex::addSegment(QHash<int, Intervals>& column, int type, quint64 begin, quint64 end,
+                                 QVector<Undo>* undo)
+{
+    if (end <= begin) return;
+
+    Intervals& intervals = column[type];
+    if (undo)
+    {
+        Undo change = { type, intervals.starts.size(),
+                        intervals.ends.isEmpty() ? 0 : intervals.ends.last() };
+        *undo << change;
+    }
+
+    if (intervals.sums.isEmpty())
+    {
+        intervals.sums << 0;
+    }
+    if (!intervals.ends.isEmpty() && intervals.ends.last() == begin)
+    {
+        intervals.ends.last() = end;
+        intervals.sums.last() = intervals.sums[intervals.sums.size() - 2] +
+                                (end - intervals.starts.last());
+    }
+    else
+    {
+        intervals.starts << begin;
+        intervals.ends << end;
+        intervals.sums << intervals.sums.last() + (end - begin);
+    }
+}
+
+void StatisticsIndex::sweep(QHash<int, Intervals>& column, Tail& tail,
+                            QVector<const StateModel*> states)
+{
+    std::sort(states.begin(), states.end(), startsBefore);
+
+    foreach (const StateModel* state, states)
+    {
+        quint64 start = state->start.toULL();
+        while (!tail.stack.isEmpty() && tail.stack.last().first <= start)
+        {
+            addSegment(column, tail.stack.last().second, tail.time, tail.stack.last().first, nullptr);
+            tail.time = tail.stack.last().first;
+            tail.stack.removeLast();
+        }
+
+        if (!tail.stack.isEmpty())
+        {
+            addSegment(column, tail.stack.last().second, tail.time, start, nullptr);
+        }
+        tail.time = start;
+
+        quint64 end = (state->end == Time(0)) ? ~quint64(0) : state->end.toULL();
+        if (!tail.stack.isEmpty())
+        {
+            end = qMin(end, tail.stack.last().first);
+        }
+        tail.stack.append(qMakePair(end, state->type));
+    }
+}
+
+void StatisticsIndex::close(QHash<int, Intervals>& column, Tail& tail, quint64 traceEnd)
+{
+    quint64 time = tail.time;
+    for (int i = tail.stack.size() - 1; i >= 0; --i)
+    {
+        quint64 end = qMin(tail.stack[i].first, qMax(traceEnd, tail.time));
+        addSegment(column, tail.stack[i].second, time, end, &tail.added);
+        time = qMax(time, end);
+    }
+}
+
+void StatisticsIndex::reopen(QHash<int, Intervals>& column, Tail& tail)
+{
+    for (int i = tail.added.size() - 1; i >= 0; --i)
+    {
+        const Undo& change = tail.added[i];
+        if (change.size == 0)
+        {
+            column.remove(change.type);
+            continue;
+        }
+
+        Intervals& intervals = column[change.type];
+        intervals.starts.resize(change.size);
+        intervals.ends.resize(change.size);
+        intervals.sums.resize(change.size + 1);
+        intervals.ends.last() = change.end;
+        intervals.sums.last() = intervals.sums[change.size - 1] +
+                                (change.end - intervals.starts.last());
+    }
+    tail.added.clear();
+}
+
+void StatisticsIndex::extend(Occupancy& occupancy, const QVector<QPair<quint64, int>>& steps,
+                             quint64 from)
+{
+    int kept = std::lower_bound(occupancy.times.begin(), occupancy.times.end(), from)
+               - occupancy.times.begin();
+    occupancy.times.resize(kept);
+    occupancy.levels.resize(kept);
+    occupancy.integrals.resize(kept);
+
+    int level = kept ? occupancy.levels.last() : 0;
+    quint64 integral = kept ? occupancy.integrals.last() : 0;
+    for (int i = 0; i < steps.size(); ++i)
+    {
+        quint64 time = steps[i].first;
+        if (occupancy.times.isEmpty() || occupancy.times.last() != time)
+        {
+            if (!occupancy.times.isEmpty())
+            {
+                integral += quint64(occupancy.levels.last()) * (time - occupancy.times.last());
+            }
+            occupancy.times << time;
+            occupancy.levels << level;
+            occupancy.integrals << integral;
+        }
+        level += steps[i].second;
+        occupancy.levels.last() = level;
+    }
+}
+
+quint64 StatisticsIndex::stateTime(int type, int component, quint64 begin, quint64 end) const
+{
+    if (type < 0 || type >= states_.size())
+    {
+        return 0;
+    }
+
+    QHash<int, Intervals>::const_iterator it = states_[type].constFind(component);
+    if (it == states_[type].constEnd())
+    {
+        return 0;
+    }
+    const Intervals& intervals = *it;
+
+    // Intervals from the first one that ends after 'begin'
+    // to the last one that starts before 'end'.
+    int first = std::upper_bound(intervals.ends.begin(), intervals.ends.end(), begin)
+                - intervals.ends.begin();
+    int last = std::lower_bound(intervals.starts.begin(), intervals.starts.end(), end)
+               - intervals.starts.begin();
+    if (first >= last)
+    {
+        return 0;
+    }
+
+    quint64 result = intervals.sums[last] - intervals.sums[first];
+    if (intervals.starts[first] < begin)
+    {
+        result -= begin - intervals.starts[first];
+    }
+    if (intervals.ends[last - 1] > end)
+    {
+        result -= intervals.ends[last - 1] - end;
+    }
+    return result;
+}
+
+quint64 StatisticsIndex::innermostTime(int type) const
+{
+    if (type < 0 || type >= innermost_.size())
+    {
+        return 0;
+    }
+
+    quint64 result = 0;
+    foreach (const Intervals& intervals, innermost_[type])
+    {
+        result += intervals.sums.last();
+    }
+    return result;
+}
+
+int StatisticsIndex::leafCount(int component) const
+{
+    return leaves_.value(component, 1);
+}
+
+void StatisticsIndex::binInnermostTime(int type, int component, quint64 begin, quint64 end,
+                                       QVector<quint64>& bins) const
+{
+    if (type < 0 || type >= innermost_.size() || bins.isEmpty() || end <= begin)
+    {
+        return;
+    }
+
+    int count = bins.size();
+    double width = double(end - begin) / count;
+
+    if (type < occupancy_.size())
+    {
+        QHash<int, Occupancy>::const_iterator merged = occupancy_[type].constFind(component);
+        if (merged != occupancy_[type].constEnd())
+        {
+            quint64 previous = integralBefore(*merged, begin);
+            for (int i = 0; i < count; ++i)
+            {
+                quint64 bound = (i + 1 == count) ? end : begin + quint64(width * (i + 1));
+                quint64 integral = integralBefore(*merged, bound);
+                bins[i] += integral - previous;
+                previous = integral;
+            }
+            return;
+        }
+    }
+
+    QHash<int, Intervals>::const_iterator it = innermost_[type].constFind(component);
+    if (it == innermost_[type].constEnd())
+    {
+        return;
+    }
+    const Intervals& intervals = *it;
+
+    quint64 previous = lengthBefore(intervals, begin);
+    for (int i = 0; i < count; ++i)
+    {
+        quint64 bound = (i + 1 == count) ? end : begin + quint64(width * (i + 1));
+        quint64 length = lengthBefore(intervals, bound);
+        bins[i] += length - previous;
+        previous = length;
+
+        if (length == intervals.sums.last())
+        {
+            break;
+        }
+
+        // Bins without states are skipped up to the next interval.
+        int next = std::upper_bound(intervals.starts.begin(), intervals.starts.end(), bound)
+                   - intervals.starts.begin();
+        if (next > 0 && intervals.ends[next - 1] > bound)
+        {
+            continue;
+        }
+        if (next == intervals.starts.size())
+        {
+            break;
+        }
+
+        // There is no state time up to the next interval, so 'previous' holds.
+        int skip = int((intervals.starts[next] - begin) / width) - 1;
+        if (skip > i)
+        {
+            i = skip;
+        }
+    }
+}
+
+int StatisticsIndex::messagesSent(int component, quint64 begin, quint64 end) const
+{
+    return countIn(sends_.value(component), begin, end);
+}
+
+int StatisticsIndex::messagesReceived(int component, quint64 begin, quint64 end) const
+{
+    return countIn(receives_.value(component), begin, end);
+}
+
+quint64 StatisticsIndex::lengthBefore(const Intervals& intervals, quint64 time)
+{
+    int n = std::lower_bound(intervals.starts.begin(), intervals.starts.end(), time)
+            - intervals.starts.begin();
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    quint64 result = intervals.sums[n];
+    if (intervals.ends[n - 1] > time)
+    {
+        result -= intervals.ends[n - 1] - time;
+    }
+    return result;
+}
+
+quint64 StatisticsIndex::integralBefore(const Occupancy& occupancy, quint64 time)
+{
+    int n = std::upper_bound(occupancy.times.begin(), occupancy.times.end(), time)
+            - occupancy.times.begin();
+    if (n == 0)
+    {
+        return 0;
+    }
+    return occupancy.integrals[n - 1] + quint64(occupancy.levels[n - 1]) * (time - occupancy.times[n - 1]);
+}
+
+int StatisticsIndex::countIn(const QVector<quint64>& times, quint64 begin, quint64 end)
+{
+    return std::upper_bound(times.begin(), times.end(), end)
+           - std::lower_bound(times.begin(), times.end(), begin);
+}
+
+}
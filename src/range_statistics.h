@@ -0,0 +1,230 @@
+#ifndef RANGE_STATISTICS_H
+#define RANGE_STATISTICS_H
+
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QPair>
+
+#include "time_vis.h"
+
+namespace vis4 {
+
+class StateModel;
+class MessageStore;
+struct MessageModel;
+class Selection;
+
+/** Statistics of a time range on some components. */
+struct RangeStatistics
+{
+    RangeStatistics() :
+        messagesSent(0),
+        messagesReceived(0)
+    {}
+
+    /** Time spent in states, by state type. */
+    QMap<int, Time> stateTime;
+
+    /** Number of events, by event type. */
+    QMap<int, int> eventCount;
+
+    int messagesSent;
+    int messagesReceived;
+};
+
+/** Bin of a lifeline in the density view. */
+struct DensityBin
+{
+    /** State type, that is innermost for most of the bin time, or -1. */
+    int type;
+
+    /** Fraction of the bin time spent in states. */
+    float activity;
+};
+
+/**
+ * Index for statistics of time ranges, built at load time.
+ *
+ * For every state type and component it keeps the union of state
+ * intervals, with prefix sums of their lengths, so time spent in
+ * states of the type over a range is found by two binary searches.
+ * Nested states of the same type (like recursive calls) are counted
+ * once. Messages are indexed by times of sending and receiving on
+ * every component.
+ *
+ * For the density view it also keeps, for every component, the
+ * column of innermost states: time is split into segments where one
+ * state is the innermost, and segments are indexed like the state
+ * intervals above, by type and component. Components with children
+ * get merged columns of their descendants: the number of descendants
+ * in the innermost state of every type, as a step function with
+ * prefix integrals, so a collapsed lifeline is binned as fast as
+ * a single one.
+ */
+class StatisticsIndex
+{
+public:
+    /** Builds the index. States that are not closed are taken to last
+        till 'traceEnd'. */
+    void build(const QVector<StateModel*>& states, const QVector<QVector<int>>& statesByType,
+               const MessageStore& messages, quint64 traceEnd);
+
+    /** Builds merged columns of components with children, in parallel. */
+    void buildHierarchy(const Selection& components);
+
+    /**
+     * Adds states from position 'from' to the end of the store, and
+     * messages, read after the build. States must start after the
+     * indexed ones on their components. Intervals are extended in place,
+     * columns of innermost states continue from the last start of their
+     * components, and merged columns of their ancestors from the
+     * earliest of these starts, so stored states are not scanned again.
+     */
+    void append(const QVector<StateModel*>& states, int from,
+                const QVector<MessageModel>& messages, const Selection& components,
+                quint64 traceEnd);
+
+    /** Time in states of the type on the component within [begin, end]. */
+    quint64 stateTime(int type, int component, quint64 begin, quint64 end) const;
+
+    /** Number of messages sent or received by the component within [begin, end]. */
+    int messagesSent(int component, quint64 begin, quint64 end) const;
+    int messagesReceived(int component, quint64 begin, quint64 end) const;
+
+    /**
+     * Adds time, when a state of the type is the innermost state on the
+     * component, to every of 'bins.size()' equal parts of [begin, end].
+     * Takes O(log n) time per bin with such states. For a component with
+     * children, time is summed over its descendants.
+     */
+    void binInnermostTime(int type, int component, quint64 begin, quint64 end,
+                          QVector<quint64>& bins) const;
+
+    /** Time, when a state of the type is the innermost state, on all components. */
+    quint64 innermostTime(int type) const;
+
+    /** Number of components without children in the subtree of the component. */
+    int leafCount(int component) const;
+
+private:
+    /** Disjoint intervals ordered by time. 'sums' has the total
+        length of intervals before every one, and of all of them. */
+    struct Intervals
+    {
+        QVector<quint64> starts;
+        QVector<quint64> ends;
+        QVector<quint64> sums;
+    };
+
+    /** Number of components with the innermost state of a type:
+        'levels[i]' holds from 'times[i]' to the next time, 'integrals[i]'
+        is the integral of the number over time before 'times[i]'. */
+    struct Occupancy
+    {
+        QVector<quint64> times;
+        QVector<int> levels;
+        QVector<quint64> integrals;
+    };
+
+    /** Change of intervals of a type, to be taken back. */
+    struct Undo
+    {
+        int type;
+        int size;
+        quint64 end;
+    };
+
+    /**
+     * Sweep over states of a component, that builds its column of
+     * innermost states. Segments of states enclosing the last start
+     * are added up to their ends, and are taken back when states are
+     * appended.
+     */
+    struct Tail
+    {
+        Tail() : time(0) {}
+
+        /** Enclosing states as (end, type), clipped by their parents.
+            The end of a state not closed is ~0. */
+        QVector<QPair<quint64, int>> stack;
+
+        /** Start of the last state. */
+        quint64 time;
+
+        /** Segments added for the stack, the earliest first. */
+        QVector<Undo> added;
+    };
+
+    /** Column of innermost states of a component, with its sweep. */
+    struct Column
+    {
+        QHash<int, Intervals> intervals;
+        Tail tail;
+    };
+
+    /** Builds the column of innermost states of one component. */
+    struct BuildColumn;
+
+    /** Collects steps of the merged column of one component with children. */
+    struct BuildOccupancy;
+
+    /** Builds merged columns of the components with children,
+        keeping their parts before 'from'. */
+    void buildOccupancy(const Selection& components, const QList<int>& parents, quint64 from);
+
+    /** Appends segment, joining it with the previous one of the type.
+        If 'undo' is given, records how to take the segment back. */
+    static void addSegment(QHash<int, Intervals>& column, int type, quint64 begin, quint64 end,
+                           QVector<Undo>* undo);
+
+    /** Continues the sweep over states, that start after the swept ones. */
+    static void sweep(QHash<int, Intervals>& column, Tail& tail, QVector<const StateModel*> states);
+
+    /** Adds segments of the enclosing states, not closed ones ending
+        at 'traceEnd'. */
+    static void close(QHash<int, Intervals>& column, Tail& tail, quint64 traceEnd);
+
+    /** Takes back the segments added by close(). */
+    static void reopen(QHash<int, Intervals>& column, Tail& tail);
+
+    /** Replaces the occupancy from 'from' on by the sorted steps. */
+    static void extend(Occupancy& occupancy, const QVector<QPair<quint64, int>>& steps, quint64 from);
+
+    static int countIn(const QVector<quint64>& times, quint64 begin, quint64 end);
+
+    /** Total length of intervals before 'time'. */
+    static quint64 lengthBefore(const Intervals& intervals, quint64 time);
+
+    /** Integral of the occupancy before 'time'. */
+    static quint64 integralBefore(const Occupancy& occupancy, quint64 time);
+
+private:
+    /** Intervals by state type and component. */
+    QVector<QHash<int, Intervals>> states_;
+
+    /** Segments of innermost states by state type and component. */
+    QVector<QHash<int, Intervals>> innermost_;
+
+    /** Sweeps of the columns of innermost states, by component. */
+    QHash<int, Tail> tails_;
+
+    /** (type, component) of intervals, whose last one lasts till the
+        end of the trace, since a state in it is not closed. */
+    QSet<QPair<int, int>> open_;
+
+    /** Merged columns by state type and component with children. */
+    QVector<QHash<int, Occupancy>> occupancy_;
+
+    /** Number of leaf descendants of components with children. */
+    QHash<int, int> leaves_;
+
+    /** Sorted times of messages by component. */
+    QHash<int, QVector<quint64>> sends_;
+    QHash<int, QVector<quint64>> receives_;
+};
+
+}
+
+#endif // RANGE_STATISTICS_H
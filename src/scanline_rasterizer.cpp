@@ -0,0 +1,93 @@
+#include "scanline_rasterizer.h"
+
+namespace vis4 {
+
+ScanlineRasterizer::ScanlineRasterizer(QImage* image) :
+    bits_(image->bits()),
+    bytesPerLine_(image->bytesPerLine()),
+    bounds_(image->rect()),
+    clip_(image->rect())
+{
+    Q_ASSERT(supports(*image));
+}
+
+bool ScanlineRasterizer::supports(const QImage& image)
+{
+    return image.format() == QImage::Format_RGB32 ||
+           image.format() == QImage::Format_ARGB32 ||
+           image.format() == QImage::Format_ARGB32_Premultiplied;
+}
+
+void ScanlineRasterizer::setClipRect(const QRect& clip)
+{
+    clip_ = clip & bounds_;
+}
+
+void ScanlineRasterizer::fillSpan(int y, int x1, int x2, quint32 color)
+{
+    quint32* p = reinterpret_cast<quint32*>(bits_ + y * bytesPerLine_) + x1;
+    quint32* end = p + (x2 - x1);
+
+    // Align to 8 bytes and write pixels by pairs.
+    if (p < end && (reinterpret_cast<quintptr>(p) & 7))
+    {
+        *p++ = color;
+    }
+
+    quint64 pair = (quint64(color) << 32) | color;
+    quint64* q = reinterpret_cast<quint64*>(p);
+    for (int pairs = (end - p) / 2; pairs > 0; --pairs)
+    {
+        *q++ = pair;
+    }
+
+    p = reinterpret_cast<quint32*>(q);
+    if (p < end)
+    {
+        *p = color;
+    }
+}
+
+void ScanlineRasterizer::fillRect(const QRect& rect, QRgb color)
+{
+    QRect r = rect & clip_;
+    if (r.isEmpty()) return;
+
+    quint32 c = 0xff000000 | color;
+    for (int y = r.top(); y <= r.bottom(); ++y)
+    {
+        fillSpan(y, r.left(), r.right() + 1, c);
+    }
+}
+
+void ScanlineRasterizer::drawBox(const QRect& rect, QRgb fill, QRgb frame)
+{
+    QRect outer(rect.left(), rect.top(), rect.width() + 1, rect.height() + 1);
+    QRect r = outer & clip_;
+    if (r.isEmpty()) return;
+
+    quint32 f = 0xff000000 | fill;
+    quint32 b = 0xff000000 | frame;
+
+    int x1 = r.left();
+    int x2 = r.right() + 1;
+
+    // Inner span excludes the vertical frame lines when they are visible.
+    int inner1 = (x1 == outer.left()) ? x1 + 1 : x1;
+    int inner2 = (x2 == outer.right() + 1) ? x2 - 1 : x2;
+
+    for (int y = r.top(); y <= r.bottom(); ++y)
+    {
+        if (y == outer.top() || y == outer.bottom())
+        {
+            fillSpan(y, x1, x2, b);
+            continue;
+        }
+
+        if (inner1 != x1) fillSpan(y, x1, inner1, b);
+        if (inner1 < inner2) fillSpan(y, inner1, inner2, f);
+        if (inner2 != x2 && inner2 >= inner1) fillSpan(y, inner2, x2, b);
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+#ifndef SCANLINE_RASTERIZER_H
+#define SCANLINE_RASTERIZER_H
+
+#include <QImage>
+#include <QRect>
+#include <QRgb>
+
+namespace vis4 {
+
+/**
+ * Software rasterizer for solid axis-aligned primitives.
+ *
+ * Writes horizontal spans directly into the memory of a 32-bit
+ * QImage, two pixels per store, bypassing QPainter. It's used by
+ * TracePainter for state boxes and event lines, which make up
+ * most of the trace at dense zoom levels. Text, arrows and
+ * antialiased elements are still drawn with QPainter.
+ *
+ * Colors are written as opaque, alpha channel is ignored.
+ */
+class ScanlineRasterizer
+{
+public:
+    /** Image must stay alive and keep its size while rasterizer is used. */
+    explicit ScanlineRasterizer(QImage* image);
+
+    /** Returns true if the image format is supported by rasterizer. */
+    static bool supports(const QImage& image);
+
+    /** Sets the rectangle primitives are clipped to. By default
+        the whole image is used. */
+    void setClipRect(const QRect& clip);
+
+    /** Fills the rectangle with the color. */
+    void fillRect(const QRect& rect, QRgb color);
+
+    /** Draws the rectangle the same way QPainter::drawRect does with
+        one pixel pen: the frame covers pixels from rect.left() to
+        rect.right() + 1 and from rect.top() to rect.bottom() + 1. */
+    void drawBox(const QRect& rect, QRgb fill, QRgb frame);
+
+private:
+    /** Fills pixels from x1 to x2 (exclusive) of the line y.
+        Coordinates must be already clipped. */
+    void fillSpan(int y, int x1, int x2, quint32 color);
+
+private:
+    uchar* bits_;
+    int bytesPerLine_;
+    QRect bounds_;
+    QRect clip_;
+};
+
+}
+
+#endif // SCANLINE_RASTERIZER_H
@@ -1,43 +1,194 @@
 #include "selection.h"
 
+#include <QtAlgorithms>
+
+namespace {
+
+const int word_bits = 64;
+
+inline bool testBit(const QVector<quint64>& words, int pos)
+{
+    return (words[pos / word_bits] >> (pos % word_bits)) & 1;
+}
+
+inline void assignBit(QVector<quint64>& words, int pos, bool value)
+{
+    quint64 mask = quint64(1) << (pos % word_bits);
+    if (value)
+    {
+        words[pos / word_bits] |= mask;
+    }
+    else
+    {
+        words[pos / word_bits] &= ~mask;
+    }
+}
+
+/** Mask of bits from 'from' to 'to' (exclusive) inside one word. */
+inline quint64 wordMask(int from, int to)
+{
+    quint64 high = (to == word_bits) ? ~quint64(0) : ((quint64(1) << to) - 1);
+    return high & ~((quint64(1) << from) - 1);
+}
+
+void assignRange(QVector<quint64>& words, int from, int to, bool value)
+{
+    while (from < to)
+    {
+        int word = from / word_bits;
+        int last = qMin(to, (word + 1) * word_bits);
+        quint64 mask = wordMask(from % word_bits, last - word * word_bits);
+
+        if (value)
+        {
+            words[word] |= mask;
+        }
+        else
+        {
+            words[word] &= ~mask;
+        }
+        from = last;
+    }
+}
+
+int countRange(const QVector<quint64>& words, int from, int to)
+{
+    int count = 0;
+    while (from < to)
+    {
+        int word = from / word_bits;
+        int last = qMin(to, (word + 1) * word_bits);
+        quint64 mask = wordMask(from % word_bits, last - word * word_bits);
+
+        count += qPopulationCount(words[word] & mask);
+        from = last;
+    }
+    return count;
+}
+
+}
+
 namespace vis4 {
 
 const int Selection::ROOT;
 
-Selection::Selection() {}
+Selection::Selection() :
+    ordered_(true)
+{}
 
 Selection::Selection(const Selection& another)
 {
     items_ = another.items_;
-    filter_ = another.filter_;
     links_ = another.links_;
     parents_ = another.parents_;
+    indexes_ = another.indexes_;
     properties_ = another.properties_;
     topLevelItems_ = another.topLevelItems_;
+
+    filter_ = another.filter_;
+    order_ = another.order_;
+    positions_ = another.positions_;
+    subtreeEnds_ = another.subtreeEnds_;
+    ordered_ = another.ordered_;
 }
 
 int Selection::addItem(const QString& title, int parent)
 {
     int link = items_.size();
     items_ << title;
-    filter_ << true;
     properties_ << QHash<QString, QVariant>();//? empty hash? nice
     links_ << QList<int>();
     parents_ << parent;
 
     if (parent == ROOT)
     {
+        indexes_ << topLevelItems_.size();
         topLevelItems_ << link;
     }
     else
     {
-        Q_ASSERT(parent < items_.size());
+        Q_ASSERT(parent < link);
+        indexes_ << links_[parent].size();
         links_[parent] << link;
     }
 
+    // New item always takes the last tree position. It is its pre-order
+    // position only if the parent's subtree ends at the tail.
+    if (ordered_ && parent != ROOT && subtreeEnds_[parent] != link)
+    {
+        ordered_ = false;
+    }
+
+    order_ << link;
+    positions_ << link;
+    subtreeEnds_ << link + 1;
+
+    if (ordered_)
+    {
+        for (int p = parent; p != ROOT; p = parents_[p])
+        {
+            subtreeEnds_[p] = link + 1;
+        }
+    }
+
+    if (link % word_bits == 0)
+    {
+        filter_ << 0;
+    }
+    assignBit(filter_, link, true);
+
     return link;
 }
 
+void Selection::ensureOrdered() const
+{
+    if (ordered_)
+    {
+        return;
+    }
+
+    QVector<quint64> filter(filter_.size(), 0);
+    int position = 0;
+
+    // Iterative depth-first walk, stack holds (link, next child index).
+    QVector<QPair<int, int>> stack;
+    for (int top = 0; top < topLevelItems_.size(); ++top)
+    {
+        stack << qMakePair(topLevelItems_[top], 0);
+        while (!stack.isEmpty())
+        {
+            QPair<int, int>& current = stack.last();
+            int link = current.first;
+
+            if (current.second == 0)
+            {
+                if (testBit(filter_, positions_[link]))
+                {
+                    assignBit(filter, position, true);
+                }
+                order_[position] = link;
+                positions_[link] = position;
+                ++position;
+            }
+
+            if (current.second < links_[link].size())
+            {
+                int child = links_[link][current.second++];
+                stack << qMakePair(child, 0);
+            }
+            else
+            {
+                subtreeEnds_[link] = position;
+                stack.pop_back();
+            }
+        }
+    }
+
+    Q_ASSERT(position == items_.size());
+    filter_ = filter;
+    ordered_ = true;
+}
+
 const QString& Selection::item(int link) const
 {
     Q_ASSERT(link < items_.size());
@@ -89,44 +240,22 @@ int Selection::itemParent(int link) const
 int Selection::itemIndex(int link) const
 {
     Q_ASSERT(link < items_.size());
-    int parent = itemParent(link);
-    if (parent == ROOT)
-    {
-        return topLevelItems_.indexOf(link);
-    }
-    else
-    {
-        return links_[parent].indexOf(link);
-    }
+    return indexes_[link];
 }
 
 const QList<int> Selection::enabledItems(int parent) const
 {
-    QList<int> items;
+    QList<int> result;
 
-    if (parent == ROOT)
+    foreach (int link, items(parent))
     {
-        for (int i = 0; i < topLevelItems_.size(); ++i)
+        if (testBit(filter_, positions_[link]))
         {
-            if (filter_[topLevelItems_[i]])
-            {
-                items << itemLink(i);
-            }
-        }
-    }
-    else
-    {
-        Q_ASSERT(parent < items_.size());
-        for (int i = 0; i < links_[parent].size(); ++i)
-        {
-            if (filter_[links_[parent][i]])
-            {
-                items << itemLink(i, parent);
-            }
+            result << link;
         }
     }
 
-    return items;
+    return result;
 }
 
 
@@ -173,7 +302,7 @@ int Selection::size() const
 bool Selection::isEnabled(int link) const
 {
     Q_ASSERT(link < items_.size());
-    return filter_[link];
+    return testBit(filter_, positions_[link]);
 }
 
 bool Selection::isEnabled(int index, int parent) const
@@ -184,34 +313,24 @@ bool Selection::isEnabled(int index, int parent) const
 void Selection::setEnabled(int link, bool enabled)
 {
     Q_ASSERT(link < items_.size());
-    filter_[link] = enabled;
+    assignBit(filter_, positions_[link], enabled);
 
     int parent = parents_[link];
-    if (!enabled && parent != ROOT && filter_[parent])
+    if (!enabled && parent != ROOT && isEnabled(parent))
     {
-        for (int i = 0; i < itemsCount(parent); ++i)
+        if (enabledCount(parent) == 0)
         {
-            if (filter_[itemLink(i, parent)]) return;
+            setEnabled(parent, false);
         }
-
-        setEnabled(parent, false); return;
+        return;
     }
 
-    if (enabled)
+    if (enabled && hasChildren(link) && enabledCount(link) == 0)
     {
-        for (int i = 0; i < itemsCount(link); ++i)
-        {
-            if (filter_[itemLink(i, link)])
-            {
-                return;
-            }
-        }
-
-        for (int i = 0; i < itemsCount(link); ++i)
+        foreach (int child, links_[link])
         {
-            setEnabled(itemLink(i, link), true);
+            setEnabled(child, true);
         }
-        return;
     }
 }
 
@@ -224,10 +343,27 @@ int Selection::enabledCount(int parent) const
 {
     Q_ASSERT(parent < items_.size());
 
+    // When the subtree has no grandchildren, children
+    // occupy a contiguous range of tree positions.
+    int begin = 0;
+    int end = items_.size();
+    if (parent != ROOT)
+    {
+        ensureOrdered();
+        begin = positions_[parent] + 1;
+        end = subtreeEnds_[parent];
+    }
+
+    if (end - begin == itemsCount(parent))
+    {
+        ensureOrdered();
+        return countRange(filter_, begin, end);
+    }
+
     int count = 0;
-    foreach (int  link, items(parent))
+    foreach (int link, items(parent))
     {
-        if (filter_[link])
+        if (testBit(filter_, positions_[link]))
         {
             count++;
         }
@@ -235,51 +371,92 @@ int Selection::enabledCount(int parent) const
     return count;
 }
 
+void Selection::assignSubtree(int parent, bool value)
+{
+    ensureOrdered();
+
+    if (parent == ROOT)
+    {
+        assignRange(filter_, 0, items_.size(), value);
+    }
+    else
+    {
+        assignRange(filter_, positions_[parent] + 1, subtreeEnds_[parent], value);
+    }
+}
+
 Selection& Selection::enableAll(int parent, bool recursive)
 {
-    QList<int> queue = items(parent);
-    while (!queue.isEmpty())
+    if (recursive)
     {
-        int link = queue.takeFirst();
-        filter_[link] = true;
+        assignSubtree(parent, true);
+        return *this;
+    }
 
-        if (recursive)
-        {
-            queue << links_[link];
-        }
+    foreach (int link, items(parent))
+    {
+        assignBit(filter_, positions_[link], true);
     }
     return *this;
 }
 
 Selection& Selection::disableAll(int parent, bool recursive)
 {
-    QList<int> queue = items(parent);
-    while (!queue.isEmpty())
+    if (recursive)
     {
-        int link = queue.takeFirst();
-        filter_[link] = false;
+        assignSubtree(parent, false);
+        return *this;
+    }
 
-        if (recursive)
-        {
-            queue << links_[link];
-        }
+    foreach (int link, items(parent))
+    {
+        assignBit(filter_, positions_[link], false);
     }
     return *this;
 }
 
+int Selection::treePosition(int link) const
+{
+    Q_ASSERT(link < items_.size());
+    ensureOrdered();
+    return positions_[link];
+}
+
+int Selection::subtreeEnd(int link) const
+{
+    Q_ASSERT(link < items_.size());
+    ensureOrdered();
+    return subtreeEnds_[link];
+}
+
+int Selection::treeItem(int position) const
+{
+    Q_ASSERT(position < items_.size());
+    ensureOrdered();
+    return order_[position];
+}
+
 void Selection::clear()
 {
     items_.clear();
     properties_.clear();
-    filter_.clear();
     links_.clear();
     parents_.clear();
+    indexes_.clear();
     topLevelItems_.clear();
+
+    filter_.clear();
+    order_.clear();
+    positions_.clear();
+    subtreeEnds_.clear();
+    ordered_ = true;
 }
 
 bool Selection::operator==(const Selection & other) const
 {
     Q_ASSERT(items_.size() == other.items_.size());
+    ensureOrdered();
+    other.ensureOrdered();
     return filter_ == other.filter_;
 }
 
@@ -291,10 +468,13 @@ bool Selection::operator!=(const Selection & other) const
 Selection Selection::operator&(const Selection & other) const
 {
     Q_ASSERT(items_.size() == other.items_.size());
+    ensureOrdered();
+    other.ensureOrdered();
+
     Selection result(*this);
     for (int i = 0; i < filter_.size(); ++i)
     {
-        result.filter_[i] = filter_[i] && other.filter_[i];
+        result.filter_[i] = filter_[i] & other.filter_[i];
     }
     return result;
 }
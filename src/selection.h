@@ -11,6 +11,11 @@ namespace vis4 {
 /**
  * Class implements support for containing and filtering
  * a set of items. Items may be placed in hierarchy.
+ *
+ * Enabled flags are kept in a packed bitset ordered by the pre-order
+ * (Euler tour) traversal of the hierarchy, so every subtree occupies
+ * a contiguous range of positions. Subtree operations and counting
+ * work on whole words of that bitset.
  */
 class Selection
 {
@@ -57,6 +62,14 @@ public: /* methods */
     Selection& enableAll(int parent = ROOT, bool recursive = false);
     Selection& disableAll(int parent = ROOT, bool recursive = false);
 
+    /** Methods for traversal in pre-order.
+        Subtree of the item occupies positions from treePosition(link)
+        (the item itself) up to subtreeEnd(link), exclusive. */
+
+    int treePosition(int link) const;
+    int subtreeEnd(int link) const;
+    int treeItem(int position) const;
+
     void clear();
 
     /** Comparison operators overload. */
@@ -66,20 +79,47 @@ public: /* methods */
 
     Selection operator&(const Selection& other) const;
 
+private: /* methods */
+
+    /** Rebuilds pre-order layout after items were added out of order. */
+    void ensureOrdered() const;
+
+    void assignSubtree(int parent, bool value);
+
 private: /* members */
 
     QVector<QString> items_;
 
-    /** state of the item (enabled/disabled) */
-    QVector<bool> filter_;
-
     QVector<QHash<QString, QVariant>> properties_;
 
     QVector<QList<int>> links_;
     QVector<int> parents_;
 
+    /** position of the item among its siblings */
+    QVector<int> indexes_;
+
     /** items with root parent */
     QList<int> topLevelItems_;
+
+    /**
+     * Layout is rebuilt lazily, so it is mutable. Items added to
+     * the middle of the tree are placed at the end until the next
+     * operation that needs the pre-order.
+     */
+
+    /** state of the item (enabled/disabled), one bit per tree position */
+    mutable QVector<quint64> filter_;
+
+    /** links of items in order of tree positions */
+    mutable QVector<int> order_;
+
+    /** tree position of every item */
+    mutable QVector<int> positions_;
+
+    /** end of the subtree of every item, exclusive */
+    mutable QVector<int> subtreeEnds_;
+
+    mutable bool ordered_;
 };
 
 } // namespaces
@@ -23,18 +23,33 @@ public:
     unsigned component;
     QColor color;
 
-    StateModel() {}
+    /** Number of states enclosing this one on the component,
+        zero for outermost states. Set when the trace is loaded. */
+    int depth;
+
+    StateModel() : depth(0) {}
 
     StateModel(unsigned int component, int type, Time begin, Time end, QColor color) :
         component(component),
         type(type),
         start(begin),
         end(end),
-        color(color)
+        color(color),
+        depth(0)
     {}
 
     virtual ~StateModel() {}
 };
 
+/** Order of states on a component: by start, enclosing states first. */
+inline bool startsBefore(const StateModel* a, const StateModel* b)
+{
+    if (a->start != b->start)
+    {
+        return a->start < b->start;
+    }
+    return a->end > b->end;
+}
+
 }
 #endif
@@ -0,0 +1,81 @@
+#include "background_tool.h"
+
+namespace vis4 {
+
+BackgroundTool::BackgroundTool(QWidget* parent, Canvas* c, int dependencies) :
+    Tool(parent, c),
+    dependencies_(dependencies),
+    active_(false),
+    outdated_(true),
+    restart_(false)
+{
+    connect(&watcher, SIGNAL(finished()), this, SLOT(finished()));
+    connect(getCanvas(), SIGNAL(modelChanged(TraceModelPtr&)), this,
+                         SLOT(modelChanged(TraceModelPtr&)));
+    model_ = model();
+}
+
+BackgroundTool::~BackgroundTool()
+{
+    watcher.waitForFinished();
+}
+
+void BackgroundTool::activate()
+{
+    active_ = true;
+    if (outdated_)
+    {
+        recompute();
+    }
+}
+
+void BackgroundTool::deactivate()
+{
+    active_ = false;
+}
+
+void BackgroundTool::recompute()
+{
+    outdated_ = false;
+    if (watcher.isRunning())
+    {
+        // Only the latest model is computed, after the running one.
+        restart_ = true;
+        return;
+    }
+
+    computed_ = model();
+    if (!showKnown(computed_))
+    {
+        watcher.setFuture(compute(computed_));
+    }
+}
+
+void BackgroundTool::finished()
+{
+    if (restart_)
+    {
+        restart_ = false;
+        recompute();
+        return;
+    }
+
+    computed();
+}
+
+void BackgroundTool::modelChanged(TraceModelPtr& model)
+{
+    int d = delta(*model.get(), *model_.get());
+    model_ = model;
+
+    if (d & dependencies_)
+    {
+        outdated_ = true;
+        if (active_)
+        {
+            recompute();
+        }
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef BACKGROUND_TOOL_H
+#define BACKGROUND_TOOL_H
+
+#include <QFuture>
+#include <QFutureWatcher>
+
+#include "tool.h"
+#include "trace_model.h"
+
+namespace vis4 {
+
+/**
+ * Tool showing a view of the model that is computed in background.
+ * The view is computed again when the model changes in one of the
+ * aspects the tool depends on, and only while the tool is shown. If
+ * the model changes during a computation, only the latest model is
+ * computed, after the running computation finishes.
+ */
+class BackgroundTool : public Tool
+{
+    Q_OBJECT
+public:
+    /** 'dependencies' are Trace_model_delta flags of changes that
+        make the view outdated. */
+    BackgroundTool(QWidget* parent, Canvas* c, int dependencies);
+    ~BackgroundTool();
+
+    void activate();
+    void deactivate();
+
+protected:
+    /**
+     * Shows the view of the model without computing it, if the tool
+     * has it already. Returns false if the view must be computed.
+     */
+    virtual bool showKnown(TraceModelPtr model)
+    {
+        return false;
+    }
+
+    /** Starts computation of the view of the model in background. */
+    virtual QFuture<void> compute(TraceModelPtr model) = 0;
+
+    /** Shows the view, when the computation started last finishes. */
+    virtual void computed() = 0;
+
+    /** Model the view is computed for. */
+    TraceModelPtr computedModel() const
+    {
+        return computed_;
+    }
+
+private:
+    void recompute();
+
+private slots:
+    void finished();
+    void modelChanged(TraceModelPtr& model);
+
+private:
+    int dependencies_;
+    bool active_;
+    /** The view doesn't match the current model. */
+    bool outdated_;
+    /** The model changed while the view was computed. */
+    bool restart_;
+
+    QFutureWatcher<void> watcher;
+    TraceModelPtr computed_;
+    TraceModelPtr model_;
+};
+
+}
+
+#endif // BACKGROUND_TOOL_H
@@ -5,13 +5,18 @@
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QToolBar>
 #include <QtWidgets/QStackedWidget>
+#include <QtWidgets/QComboBox>
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
 #include <QtWidgets/QAction>
 #include <QMouseEvent>
+#include <QPainter>
 #include <QStack>
 #include <QtWidgets/QShortcut>
 #include <QKeySequence>
 #include <QCoreApplication>
 #include <QSettings>
+#include <QFutureWatcher>
 
 #include "tool.h"
 #include "trace_model.h"
@@ -19,6 +24,9 @@
 #include "state_model.h"
 #include "canvas.h"
 #include "event_list.h"
+#include "profile_view.h"
+#include "duration_histogram.h"
+#include "canvas_item.h"
 
 namespace vis4 {
 
@@ -114,6 +122,238 @@ private:
     QLineEdit* eventsLabel;
 };
 
+/**
+ * Flat profile of the trace, for all components or one of them.
+ * Profile is computed in background after loading, the panel is
+ * filled when it is ready.
+ */
+class Browser_profile : public QGroupBox
+{
+    Q_OBJECT
+public:
+    Browser_profile(QWidget* parent) :
+        QGroupBox(tr("Profile"), parent)
+    {
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        componentBox = new QComboBox(this);
+        layout->addWidget(componentBox);
+        connect(componentBox, SIGNAL(currentIndexChanged(int)), this,
+                              SLOT(componentChanged()));
+
+        regions = new ProfileModel(this);
+
+        table = new QTableView(this);
+        table->setModel(regions);
+        table->setSortingEnabled(true);
+        table->sortByColumn(ProfileModel::ExclusiveColumn, Qt::DescendingOrder);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->verticalHeader()->hide();
+        table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+        layout->addWidget(table);
+
+        connect(table->selectionModel(), SIGNAL(currentRowChanged(const QModelIndex&, const QModelIndex&)),
+                this, SLOT(currentRowChanged(const QModelIndex&)));
+
+        statusLabel = new QLabel(tr("Computing..."), this);
+        layout->addWidget(statusLabel);
+
+        connect(&watcher, SIGNAL(finished()), this, SLOT(profileReady()));
+    }
+
+    void update(Canvas* canvasPtr)
+    {
+        TraceModelPtr model = canvasPtr->getModel();
+        QFuture<Profile> future = model->profile();
+
+        model_ = model;
+        if (future != watcher.future())
+        {
+            componentBox->clear();
+            statusLabel->show();
+            watcher.setFuture(future);
+        }
+        else
+        {
+            regions->updateTime();
+        }
+    }
+
+signals:
+    /** Emitted when a region is selected in the table. */
+    void regionSelected(int type);
+
+private slots:
+    void profileReady()
+    {
+        profile = watcher.result();
+
+        componentBox->blockSignals(true);
+        componentBox->clear();
+        componentBox->addItem(tr("All components"), -1);
+        foreach (int component, profile.components())
+        {
+            componentBox->addItem(model_->getComponentName(component, true), component);
+        }
+        componentBox->blockSignals(false);
+
+        statusLabel->hide();
+        componentChanged();
+    }
+
+    void componentChanged()
+    {
+        int component = componentBox->itemData(componentBox->currentIndex()).toInt();
+        regions->setRegions(model_, component == -1 ? profile.total()
+                                                    : profile.component(component));
+    }
+
+    void currentRowChanged(const QModelIndex& current)
+    {
+        if (current.isValid())
+        {
+            emit regionSelected(regions->type(current.row()));
+        }
+    }
+
+private:
+    QComboBox* componentBox;
+    QTableView* table;
+    QLabel* statusLabel;
+    ProfileModel* regions;
+
+    QFutureWatcher<Profile> watcher;
+    Profile profile;
+    TraceModelPtr model_;
+};
+
+/**
+ * Distribution of durations of states of one region, with the median,
+ * 90th and 99th percentiles. Clicking a bucket of the histogram
+ * highlights states with durations from it.
+ */
+class Browser_durations : public QGroupBox
+{
+    Q_OBJECT
+public:
+    Browser_durations(QWidget* parent) :
+        QGroupBox(tr("Durations"), parent),
+        type_(-1)
+    {
+        QVBoxLayout* layout = new QVBoxLayout(this);
+
+        regionLabel = new QLabel(tr("Select a region in the profile."), this);
+        regionLabel->setWordWrap(true);
+        layout->addWidget(regionLabel);
+
+        histogram = new DurationHistogram(this);
+        layout->addWidget(histogram);
+        connect(histogram, SIGNAL(bucketClicked(quint64, quint64)), this,
+                           SLOT(histogramClicked(quint64, quint64)));
+
+        percentilesLabel = new QLabel(this);
+        layout->addWidget(percentilesLabel);
+    }
+
+    void setRegion(const TraceModelPtr& model, int type)
+    {
+        type_ = type;
+        sketch = model->stateDurations(type);
+
+        regionLabel->setText(model->getStates().item(type));
+        histogram->setSketch(sketch);
+        updateTime();
+    }
+
+    void updateTime()
+    {
+        if (type_ == -1) return;
+
+        percentilesLabel->setText(
+            tr("Median: <b>%1</b><br>90%: <b>%2</b><br>99%: <b>%3</b>")
+            .arg(Time(sketch.quantile(0.5)).toString(true))
+            .arg(Time(sketch.quantile(0.9)).toString(true))
+            .arg(Time(sketch.quantile(0.99)).toString(true)));
+        histogram->update();
+    }
+
+    void clearSelection()
+    {
+        histogram->clearSelection();
+    }
+
+signals:
+    /** Emitted when states of the type with durations
+        within [min, max] should be highlighted. */
+    void highlight(int type, quint64 min, quint64 max);
+
+private slots:
+    void histogramClicked(quint64 min, quint64 max)
+    {
+        emit highlight(type_, min, max);
+    }
+
+private:
+    QLabel* regionLabel;
+    QLabel* percentilesLabel;
+    DurationHistogram* histogram;
+
+    int type_;
+    DurationSketch sketch;
+};
+
+/** Highlight of several states on the canvas. */
+class States_highlight : public CanvasItem
+{
+public:
+    void setRects(const QVector<QRect>& rects)
+    {
+        rects_ = rects;
+
+        QRect bounds;
+        foreach (const QRect& r, rects_)
+        {
+            bounds |= r;
+        }
+        if (bounds.isValid())
+        {
+            bounds.adjust(-2, -2, 2, 2);
+        }
+        new_geometry(bounds);
+    }
+
+private:
+    QRect xdraw(QPainter& painter)
+    {
+        if (rects_.isEmpty())
+        {
+            return QRect();
+        }
+
+        painter.save();
+
+        QColor halfRed(Qt::red);
+        halfRed.setAlpha(75);
+        painter.setBrush(halfRed);
+        painter.setPen(QPen(Qt::red, 2));
+
+        QRect bounds;
+        foreach (const QRect& r, rects_)
+        {
+            painter.drawRect(r);
+            bounds |= r;
+        }
+        bounds.adjust(-2, -2, 2, 2);
+
+        painter.restore();
+
+        return bounds;
+    }
+
+    QVector<QRect> rects_;
+};
+
 class Browser_event_info : public QGroupBox
 {
     Q_OBJECT
@@ -432,6 +672,21 @@ public:
         state_info_ = new Browser_state_info(infoStack);
         infoStack->addWidget(state_info_);
 
+        profile_ = new Browser_profile(this);
+        mainLayout->addWidget(profile_);
+
+        durations_ = new Browser_durations(this);
+        mainLayout->addWidget(durations_);
+
+        connect(profile_, SIGNAL(regionSelected(int)), this,
+                          SLOT(regionSelected(int)));
+        connect(durations_, SIGNAL(highlight(int, quint64, quint64)), this,
+                            SLOT(highlightDurations(int, quint64, quint64)));
+
+        highlight = new States_highlight;
+        getCanvas()->addItem(highlight);
+        highlighted_type = -1;
+
         createToolbarActions();
 
         connect(getCanvas(), SIGNAL(modelChanged(TraceModelPtr &)),
@@ -504,6 +759,7 @@ public:
     void activate()
     {
         trace_info_->update(getCanvas());
+        profile_->update(getCanvas());
         active_ = true;
     }
 
@@ -552,7 +808,12 @@ private:
         bool result = false;
         if (target == Canvas::componentClicked)
         {
-            if (model()->hasChildren(component) && mEvent->button() == Qt::LeftButton)
+            if (model()->clusterSize(component) > 1 && mEvent->button() == Qt::LeftButton)
+            {
+                getCanvas()->setModel(model()->expandCluster(component));
+                result = true;
+            }
+            else if (model()->hasChildren(component) && mEvent->button() == Qt::LeftButton)
             {
                 TraceModelPtr new_model
                     = model()->setParentComponent(component);
@@ -700,6 +961,9 @@ private slots:
     void modelChanged(TraceModelPtr &)
     {
         trace_info_->update(getCanvas());
+        profile_->update(getCanvas());
+        durations_->updateTime();
+        updateHighlight();
         if (infoStack->currentWidget() == event_info_)
             event_info_->updateTime();
         if (infoStack->currentWidget() == state_info_)
@@ -709,6 +973,21 @@ private slots:
     }
 
 
+    void regionSelected(int type)
+    {
+        durations_->setRegion(model(), type);
+        highlighted_type = -1;
+        updateHighlight();
+    }
+
+    void highlightDurations(int type, quint64 min, quint64 max)
+    {
+        highlighted_type = type;
+        highlighted_min = min;
+        highlighted_max = max;
+        updateHighlight();
+    }
+
     void zoomInCenter()
     {
         zoomInAt(Time::scale(
@@ -765,6 +1044,72 @@ private:
             model()->setRange(new_min, new_max));
     }
 
+    /**
+     * Highlights visible states of the highlighted type with durations
+     * in the highlighted range. A state of such duration overlaps the
+     * visible range only if it starts within 'highlighted_max' before
+     * it. If that is not much more than the range, states are walked in
+     * time order from there, otherwise states crossing the range are
+     * taken from every component. Either way at most
+     * 'max_highlight_steps' states are looked at.
+     */
+    void updateHighlight()
+    {
+        QVector<QRect> rects;
+        if (highlighted_type != -1)
+        {
+            TraceModelPtr m = model();
+
+            Selection states = m->getStates();
+            states.disableAll();
+            states.setEnabled(highlighted_type, true);
+            m = m->filterStates(states);
+
+            int steps = 0;
+            auto add = [&](const StateModel* s)
+            {
+                quint64 duration = (s->end - s->start).toULL();
+                if (s->end == Time(0) || duration < highlighted_min || duration > highlighted_max) return;
+                if (s->end < m->getMinTime()) return;
+
+                Time b = qMax(s->start, m->getMinTime());
+                Time e = qMin(s->end, m->getMaxTime());
+                rects << getCanvas()->boundingRect(s->component, b, e);
+            };
+
+            quint64 min = m->getMinTime().toULL();
+            quint64 span = (m->getMaxTime() - m->getMinTime()).toULL();
+            if (highlighted_max <= span * max_lookbehind_ranges)
+            {
+                Time from = Time(min > highlighted_max ? min - highlighted_max : 0ull);
+                int end = m->stateOccurrencesBefore(m->getMaxTime());
+                for (int n = m->stateOccurrencesBefore(from);
+                     n < end && steps < max_highlight_steps && rects.size() < max_highlighted_states;
+                     ++n, ++steps)
+                {
+                    add(m->stateOccurrence(n));
+                }
+            }
+            else
+            {
+                // Components drawn on lifelines, with descendants
+                // of the ones that have children.
+                int budget = max_highlight_steps;
+                for (int c = 0; c < m->getComponents().size() && budget > 0 &&
+                                rects.size() < max_highlighted_states; ++c)
+                {
+                    if (m->lifeline(c) == -1) continue;
+                    foreach (const StateModel* s, m->rangeStates(c, budget))
+                    {
+                        if (rects.size() >= max_highlighted_states) break;
+                        add(s);
+                    }
+                }
+            }
+        }
+        highlight->setRects(rects);
+    }
+
     /** Disables unavailable toolbar's actions. */
     void checkActions()
     {
@@ -796,6 +1141,20 @@ private:
     Browser_trace_info* trace_info_;
     Browser_event_info* event_info_;
     Browser_state_info* state_info_;
+    Browser_profile* profile_;
+    Browser_durations* durations_;
+
+    /** Only so many states are highlighted, in time order. */
+    enum { max_highlighted_states = 2000 };
+    /** States looked at for the highlight, drawn or not. */
+    enum { max_highlight_steps = 50000 };
+    /** Longest lookbehind for the walk in time order, in time ranges. */
+    enum { max_lookbehind_ranges = 4 };
+
+    States_highlight* highlight;
+    int highlighted_type;
+    quint64 highlighted_min;
+    quint64 highlighted_max;
 
     // Toolbar's actions.
     QAction* startAction;
@@ -0,0 +1,163 @@
+#include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QScrollArea>
+#include <QtWidgets/QAction>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "background_tool.h"
+#include "canvas.h"
+#include "trace_model.h"
+#include "flame_graph.h"
+
+namespace vis4 {
+
+/**
+ * Flame graph of the merged call tree of the visible part of the
+ * trace. The tree is computed in background when the time range, the
+ * lifelines or the state filter change. A few last trees are kept, so
+ * zooming back to a range seen before shows its tree at once.
+ */
+class CallTreeView : public BackgroundTool
+{
+    Q_OBJECT
+public:
+    CallTreeView(QWidget* parent, Canvas* c) :
+        BackgroundTool(parent, c, Trace_model_delta::component_position |
+                                  Trace_model_delta::components |
+                                  Trace_model_delta::state_types |
+                                  Trace_model_delta::time_range)
+    {
+        setObjectName("call_tree");
+        setWindowTitle(tr("Call tree"));
+
+        setWhatsThis(tr("<b>Call tree</b>"
+                     "<p>Shows time spent in nested states within the "
+                     "visible time range, merged over visible lifelines. "
+                     "Every bar is a path of nested states, its width is "
+                     "the time spent on this path."
+                     "<p>Clicking a bar shows its part of the tree on the "
+                     "whole width, clicking a bar below it goes back."));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        graph = new FlameGraph(this);
+        QScrollArea* scroll = new QScrollArea(this);
+        scroll->setWidget(graph);
+        scroll->setWidgetResizable(true);
+        mainLayout->addWidget(scroll);
+
+        statusLabel = new QLabel(this);
+        statusLabel->setWordWrap(true);
+        mainLayout->addWidget(statusLabel);
+    }
+
+    QAction* createAction()
+    {
+        QAction* call_tree_action = new QAction(tr("Call &tree"), this);
+        call_tree_action->setShortcut(QKeySequence(Qt::Key_T));
+        return call_tree_action;
+    }
+
+private:
+    /** Time range, filters and records of a followed trace the
+        tree depends on. */
+    struct Key
+    {
+        quint64 begin;
+        quint64 end;
+        int parent;
+        QList<int> components;
+        QList<int> states;
+        int generation;
+
+        bool operator==(const Key& other) const
+        {
+            return begin == other.begin && end == other.end && parent == other.parent &&
+                   components == other.components && states == other.states &&
+                   generation == other.generation;
+        }
+    };
+
+    static Key keyOf(TraceModelPtr model)
+    {
+        Key key = { model->getMinTime().toULL(), model->getMaxTime().toULL(),
+                    model->getParentComponent(), model->getVisibleComponents(),
+                    model->getStates().enabledItems(), model->dataGeneration() };
+        return key;
+    }
+
+    static CallTree treeOf(TraceModelPtr model)
+    {
+        return model->callTree();
+    }
+
+    bool showKnown(TraceModelPtr model)
+    {
+        Key key = keyOf(model);
+        for (int i = 0; i < cache_.size(); ++i)
+        {
+            if (cache_[i].first == key)
+            {
+                // The most recently used tree goes to the end.
+                cache_.append(cache_.takeAt(i));
+                showTree(cache_.last().second);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QFuture<void> compute(TraceModelPtr model)
+    {
+        statusLabel->setText(tr("Computing..."));
+        // The key is taken now, records may be appended meanwhile.
+        computing_ = keyOf(model);
+        result_ = QtConcurrent::run(&CallTreeView::treeOf, model);
+        return result_;
+    }
+
+    void computed()
+    {
+        cache_.append(qMakePair(computing_, result_.result()));
+        if (cache_.size() > cache_size)
+        {
+            cache_.removeFirst();
+        }
+        showTree(cache_.last().second);
+    }
+
+    void showTree(const CallTree& tree)
+    {
+        QStringList names;
+        const Selection& states = computedModel()->getStates();
+        for (int type = 0; type < states.size(); ++type)
+        {
+            names << states.item(type);
+        }
+        graph->setTree(tree, names);
+
+        statusLabel->setText(tr("%1 paths, %2 in states")
+                             .arg(tree.size() - 1)
+                             .arg(Time(tree.node(CallTree::root()).inclusive).toString(true)));
+    }
+
+private:
+    enum { cache_size = 16 };
+
+    FlameGraph* graph;
+    QLabel* statusLabel;
+
+    QFuture<CallTree> result_;
+    Key computing_;
+
+    /** Recently shown trees, the most recent last. */
+    QList<QPair<Key, CallTree>> cache_;
+};
+
+
+Tool* createCallTree(QWidget* parent, Canvas* canvas)
+{
+    return new CallTreeView(parent, canvas);
+}
+
+}
@@ -0,0 +1,228 @@
+#include "checker.h"
+#include "timeedit.h"
+
+#include <QtWidgets/QWidget>
+#include <QtWidgets/QGridLayout>
+#include <QtWidgets/QComboBox>
+#include <QtWidgets/QCheckBox>
+#include <QtWidgets/QLabel>
+
+namespace vis4 {
+
+namespace {
+
+/* Fills the combo with items of the selection, keeping
+   the current item if it's still there.  */
+void fillTypes(QComboBox* combo, const Selection& types)
+{
+    QString current = combo->currentText();
+
+    combo->blockSignals(true);
+    combo->clear();
+    for (int link = 0; link < types.size(); ++link)
+    {
+        combo->addItem(types.item(link), link);
+    }
+
+    int index = combo->findText(current);
+    combo->setCurrentIndex(index != -1 ? index : 0);
+    combo->blockSignals(false);
+}
+
+int currentLink(const QComboBox* combo)
+{
+    return combo->itemData(combo->currentIndex()).toInt();
+}
+
+/**
+ * "Event A (not) followed by event B on the same or given
+ * component, optionally within given time."
+ */
+class EventSequenceChecker : public Checker
+{
+public:
+    EventSequenceChecker()
+    {
+        widget_ = new QWidget();
+        QGridLayout* layout = new QGridLayout(widget_);
+
+        layout->addWidget(new QLabel(tr("Event:")), 0, 0);
+        layout->addWidget(first_ = new QComboBox(), 0, 1);
+
+        relation_ = new QComboBox();
+        relation_->addItem(tr("not followed by"));
+        relation_->addItem(tr("followed by"));
+        layout->addWidget(relation_, 1, 1);
+
+        layout->addWidget(new QLabel(tr("Event:")), 2, 0);
+        layout->addWidget(second_ = new QComboBox(), 2, 1);
+
+        layout->addWidget(new QLabel(tr("On:")), 3, 0);
+        layout->addWidget(target_ = new QComboBox(), 3, 1);
+
+        layout->addWidget(limited_ = new QCheckBox(tr("Within:")), 4, 0);
+        layout->addWidget(within_ = new TimeEdit(), 4, 1);
+        within_->setTime(Time(10000ull));
+        within_->setEnabled(false);
+
+        connect(first_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(relation_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(second_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(target_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(limited_, SIGNAL(toggled(bool)), within_, SLOT(setEnabled(bool)));
+        connect(limited_, SIGNAL(toggled(bool)), this, SIGNAL(stateChanged()));
+        connect(within_, SIGNAL(timeChanged(Time)), this, SIGNAL(stateChanged()));
+    }
+
+    QString title() const
+    {
+        return tr("Event followed by event");
+    }
+
+    QWidget* widget()
+    {
+        return widget_;
+    }
+
+    void setModel(TraceModelPtr& model)
+    {
+        fillTypes(first_, model->getEvents());
+        fillTypes(second_, model->getEvents());
+
+        QString current = target_->currentText();
+
+        target_->blockSignals(true);
+        target_->clear();
+        target_->addItem(tr("Same component"), -1);
+        // Groups have no events of their own, their members are listed instead.
+        foreach (int component, model->lifelineComponents(0, model->getVisibleComponents().size() - 1))
+        {
+            if (model->hasChildren(component)) continue;
+            target_->addItem(model->getComponentName(component, true), component);
+        }
+
+        int index = target_->findText(current);
+        target_->setCurrentIndex(index != -1 ? index : 0);
+        target_->blockSignals(false);
+    }
+
+    bool isReady() const
+    {
+        return first_->currentIndex() != -1 && second_->currentIndex() != -1 &&
+               (!limited_->isChecked() || within_->time() > Time(0ull));
+    }
+
+    QSet<int> types() const
+    {
+        return QSet<int>() << currentLink(first_) << currentLink(second_);
+    }
+
+    Pattern pattern() const
+    {
+        Pattern::Kind kind = (relation_->currentIndex() == 0) ? Pattern::NotFollowedBy
+                                                              : Pattern::FollowedBy;
+        return Pattern(kind,
+                       QSet<int>() << currentLink(first_),
+                       QSet<int>() << currentLink(second_),
+                       currentLink(target_),
+                       limited_->isChecked() ? within_->time() : Time(0ull));
+    }
+
+private:
+    QWidget* widget_;
+    QComboBox* first_;
+    QComboBox* relation_;
+    QComboBox* second_;
+    QComboBox* target_;
+    QCheckBox* limited_;
+    TimeEdit* within_;
+};
+
+/** "State A (not) nested inside state B on the same component." */
+class NestingChecker : public Checker
+{
+public:
+    NestingChecker()
+    {
+        widget_ = new QWidget();
+        QGridLayout* layout = new QGridLayout(widget_);
+
+        layout->addWidget(new QLabel(tr("State:")), 0, 0);
+        layout->addWidget(first_ = new QComboBox(), 0, 1);
+
+        relation_ = new QComboBox();
+        relation_->addItem(tr("nested inside"));
+        relation_->addItem(tr("not nested inside"));
+        layout->addWidget(relation_, 1, 1);
+
+        layout->addWidget(new QLabel(tr("State:")), 2, 0);
+        layout->addWidget(second_ = new QComboBox(), 2, 1);
+
+        connect(first_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(relation_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+        connect(second_, SIGNAL(currentIndexChanged(int)), this, SIGNAL(stateChanged()));
+    }
+
+    QString title() const
+    {
+        return tr("State nested inside state");
+    }
+
+    QWidget* widget()
+    {
+        return widget_;
+    }
+
+    void setModel(TraceModelPtr& model)
+    {
+        fillTypes(first_, model->getStates());
+        fillTypes(second_, model->getStates());
+    }
+
+    bool isReady() const
+    {
+        return first_->currentIndex() != -1 && second_->currentIndex() != -1;
+    }
+
+    QSet<int> types() const
+    {
+        return QSet<int>() << currentLink(first_) << currentLink(second_);
+    }
+
+    Pattern pattern() const
+    {
+        Pattern::Kind kind = (relation_->currentIndex() == 0) ? Pattern::NestedIn
+                                                              : Pattern::NotNestedIn;
+        return Pattern(kind,
+                       QSet<int>() << currentLink(first_),
+                       QSet<int>() << currentLink(second_));
+    }
+
+private:
+    QWidget* widget_;
+    QComboBox* first_;
+    QComboBox* relation_;
+    QComboBox* second_;
+};
+
+}
+
+QStringList Checker::availableCheckers()
+{
+    return QStringList() << "event_sequence" << "nesting";
+}
+
+pChecker Checker::createChecker(const QString& name)
+{
+    if (name == "event_sequence")
+    {
+        return pChecker(new EventSequenceChecker());
+    }
+    if (name == "nesting")
+    {
+        return pChecker(new NestingChecker());
+    }
+    return pChecker();
+}
+
+}
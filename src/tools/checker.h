@@ -0,0 +1,58 @@
+#ifndef CHECKER_H
+#define CHECKER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+#include <boost/shared_ptr.hpp>
+
+#include "trace_model.h"
+#include "pattern.h"
+
+class QWidget;
+
+namespace vis4 {
+
+class Checker;
+typedef boost::shared_ptr<Checker> pChecker;
+
+/**
+ * Condition for the query find tab.
+ *
+ * Checker provides a widget with settings and builds a pattern from
+ * them. The pattern is matched by the query tab; the checker only
+ * tells which event or state types it needs to be enabled.
+ */
+class Checker : public QObject
+{
+    Q_OBJECT
+public:
+    /** Names of all checkers, for createChecker. */
+    static QStringList availableCheckers();
+    static pChecker createChecker(const QString& name);
+
+    virtual QString title() const = 0;
+
+    /** Widget with settings of the checker. */
+    virtual QWidget* widget() = 0;
+
+    /** Fills settings widget with types and components of the model. */
+    virtual void setModel(TraceModelPtr& model) = 0;
+
+    /** Returns true when settings are complete. */
+    virtual bool isReady() const = 0;
+
+    /** Event types, or state types for state patterns, used by the pattern. */
+    virtual QSet<int> types() const = 0;
+
+    virtual Pattern pattern() const = 0;
+
+signals:
+    /** Emitted when settings change. */
+    void stateChanged();
+};
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+#include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QComboBox>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QScrollArea>
+#include <QtWidgets/QAction>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "background_tool.h"
+#include "canvas.h"
+#include "trace_model.h"
+#include "matrix_view.h"
+
+namespace vis4 {
+
+/**
+ * Communication matrix of the visible part of the trace: number and
+ * size of messages between every pair of lifelines. The matrix is
+ * recomputed in background when the time range or the lifelines
+ * change. Clicking a cell leaves only the sender and the receiver
+ * on the canvas.
+ */
+class Communication : public BackgroundTool
+{
+    Q_OBJECT
+public:
+    Communication(QWidget* parent, Canvas* c) :
+        BackgroundTool(parent, c, Trace_model_delta::component_position |
+                                  Trace_model_delta::components |
+                                  Trace_model_delta::time_range)
+    {
+        setObjectName("communication");
+        setWindowTitle(tr("Communication"));
+
+        setWhatsThis(tr("<b>Communication matrix</b>"
+                     "<p>Shows number or size of messages, sent within "
+                     "the visible time range, between every pair of "
+                     "lifelines. Senders are rows, receivers are columns."
+                     "<p><b>Control+Wheel</b> zooms the matrix, clicking "
+                     "a cell shows only the two components on the diagram."));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        valueBox = new QComboBox(this);
+        valueBox->addItem(tr("Number of messages"), MatrixView::CountValue);
+        valueBox->addItem(tr("Size of messages"), MatrixView::BytesValue);
+        mainLayout->addWidget(valueBox);
+        connect(valueBox, SIGNAL(currentIndexChanged(int)), this,
+                          SLOT(valueChanged()));
+
+        matrix = new MatrixView(this);
+        QScrollArea* scroll = new QScrollArea(this);
+        scroll->setWidget(matrix);
+        scroll->setAlignment(Qt::AlignCenter);
+        mainLayout->addWidget(scroll);
+        connect(matrix, SIGNAL(cellClicked(int, int)), this,
+                        SLOT(cellClicked(int, int)));
+
+        statusLabel = new QLabel(this);
+        statusLabel->setWordWrap(true);
+        mainLayout->addWidget(statusLabel);
+    }
+
+    QAction* createAction()
+    {
+        QAction* communication_action = new QAction(tr("&Communication"), this);
+        communication_action->setShortcut(QKeySequence(Qt::Key_X));
+        return communication_action;
+    }
+
+private:
+    static CommunicationMatrix matrixOf(TraceModelPtr model)
+    {
+        return model->communicationMatrix();
+    }
+
+    QFuture<void> compute(TraceModelPtr model)
+    {
+        statusLabel->setText(tr("Computing..."));
+        result_ = QtConcurrent::run(&Communication::matrixOf, model);
+        return result_;
+    }
+
+    void computed()
+    {
+        CommunicationMatrix result = result_.result();
+
+        QStringList labels;
+        foreach (int component, computedModel()->getVisibleComponents())
+        {
+            labels << computedModel()->getComponentName(component, true);
+        }
+        matrix->setMatrix(result, labels);
+
+        statusLabel->setText(tr("%1 messages, %2 bytes")
+                             .arg(result.totalCount())
+                             .arg(result.totalBytes()));
+    }
+
+private slots:
+    void valueChanged()
+    {
+        matrix->setValue(MatrixView::Value(valueBox->itemData(valueBox->currentIndex()).toInt()));
+    }
+
+    void cellClicked(int sender, int receiver)
+    {
+        TraceModelPtr computed = computedModel();
+        const QList<int>& visible = computed->getVisibleComponents();
+
+        Selection component_filter = computed->getComponents();
+        component_filter.disableAll(computed->getParentComponent());
+        component_filter.setEnabled(visible[sender], true);
+        component_filter.setEnabled(visible[receiver], true);
+
+        getCanvas()->setModel(model()->filterComponents(component_filter));
+    }
+
+private:
+    MatrixView* matrix;
+    QComboBox* valueBox;
+    QLabel* statusLabel;
+
+    QFuture<CommunicationMatrix> result_;
+};
+
+
+Tool* createCommunication(QWidget* parent, Canvas* canvas)
+{
+    return new Communication(parent, canvas);
+}
+
+}
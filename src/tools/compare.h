@@ -0,0 +1,264 @@
+#include <QtWidgets/QVBoxLayout>
+#include <QtWidgets/QHBoxLayout>
+#include <QtWidgets/QComboBox>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QAction>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include "tool.h"
+#include "canvas.h"
+#include "trace_model.h"
+#include "tracemodelimpl.h"
+#include "state_model.h"
+#include "profile_view.h"
+
+namespace vis4 {
+
+/**
+ * Comparison of the trace with another run. The other trace is shown
+ * in a separate window, following the time range of the main diagram,
+ * aligned either by the start of the traces or by the first call of
+ * a chosen region. The table shows per-region changes of the flat
+ * profiles, the other trace relative to this one.
+ */
+class Compare : public Tool
+{
+    Q_OBJECT
+public:
+    Compare(QWidget* parent, Canvas* c) :
+        Tool(parent, c),
+        offset_(0)
+    {
+        setObjectName("compare");
+        setWindowTitle(tr("Compare"));
+
+        setWhatsThis(tr("<b>Compare</b>"
+                     "<p>Opens another trace of the same program, shows it "
+                     "in a separate window following the time range of the "
+                     "main diagram, and lists the changes of time and calls "
+                     "of every region. Times growing in the other trace are "
+                     "red."
+                     "<p>The traces are aligned by their start, or by the "
+                     "first call of the region chosen in <b>Align by</b>."));
+
+        QVBoxLayout* mainLayout = new QVBoxLayout(this);
+
+        QHBoxLayout* fileLayout = new QHBoxLayout();
+        QPushButton* openButton = new QPushButton(tr("Open..."), this);
+        fileLayout->addWidget(openButton);
+        fileLabel = new QLabel(tr("No trace"), this);
+        fileLayout->addWidget(fileLabel, 1);
+        mainLayout->addLayout(fileLayout);
+        connect(openButton, SIGNAL(clicked()), this, SLOT(openTrace()));
+
+        QHBoxLayout* alignLayout = new QHBoxLayout();
+        alignLayout->addWidget(new QLabel(tr("Align by"), this));
+        alignBox = new QComboBox(this);
+        alignBox->addItem(tr("Start of trace"));
+        alignBox->setEnabled(false);
+        alignLayout->addWidget(alignBox, 1);
+        mainLayout->addLayout(alignLayout);
+        connect(alignBox, SIGNAL(currentIndexChanged(int)), this,
+                          SLOT(alignmentChanged()));
+
+        regions = new ProfileDiffModel(this);
+
+        table = new QTableView(this);
+        table->setModel(regions);
+        table->setSortingEnabled(true);
+        table->sortByColumn(ProfileDiffModel::InclusiveChangeColumn, Qt::DescendingOrder);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->verticalHeader()->hide();
+        table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+        mainLayout->addWidget(table);
+
+        statusLabel = new QLabel(this);
+        statusLabel->setWordWrap(true);
+        mainLayout->addWidget(statusLabel);
+
+        other = new Canvas(this);
+        other->setWindowFlags(Qt::Window);
+
+        connect(&loadWatcher, SIGNAL(finished()), this, SLOT(traceLoaded()));
+        connect(&diffWatcher, SIGNAL(finished()), this, SLOT(diffReady()));
+        connect(getCanvas(), SIGNAL(modelChanged(TraceModelPtr&)), this,
+                             SLOT(modelChanged(TraceModelPtr&)));
+    }
+
+    ~Compare()
+    {
+        loadWatcher.waitForFinished();
+        diffWatcher.waitForFinished();
+    }
+
+    QAction* createAction()
+    {
+        QAction* compare_action = new QAction(tr("Com&pare"), this);
+        compare_action->setShortcut(QKeySequence(Qt::Key_V));
+        return compare_action;
+    }
+
+    void activate()
+    {
+        if (second_)
+        {
+            other->show();
+        }
+    }
+
+    void deactivate() {}
+
+private:
+    static TraceModelPtr load(const QString& filename)
+    {
+        return TraceModelImpl::open(filename);
+    }
+
+    /** Waits for profiles of both traces and joins them. */
+    static ProfileDiff diff(TraceModelPtr first, TraceModelPtr second)
+    {
+        return ProfileDiff::compute(first->profile().result(), first->getStates(),
+                                    second->profile().result(), second->getStates());
+    }
+
+    /** Start of the first call of the region, or of the trace if the
+        region is empty or has no calls. */
+    static quint64 anchor(TraceModelPtr model, const QString& region)
+    {
+        TraceModelPtr whole = model->root();
+        if (region.isEmpty())
+        {
+            return whole->getMinTime().toULL();
+        }
+
+        Selection filter = whole->getStates();
+        for (int type = 0; type < filter.size(); ++type)
+        {
+            filter.setEnabled(type, filter.item(type) == region);
+        }
+        StateModel* first = whole->filterStates(filter)->stateOccurrence(0);
+        return first ? first->start.toULL() : whole->getMinTime().toULL();
+    }
+
+    /** Shows the range of the main diagram in the other trace. */
+    void followRange()
+    {
+        if (!second_) return;
+
+        qint64 begin = qint64(model()->getMinTime().toULL()) + offset_;
+        qint64 end = qint64(model()->getMaxTime().toULL()) + offset_;
+        if (begin < 0)
+        {
+            end -= begin;
+            begin = 0;
+        }
+        other->setModel(other->getModel()->setRange(Time(quint64(begin)), Time(quint64(end))));
+    }
+
+private slots:
+    void openTrace()
+    {
+        QString filename = QFileDialog::getOpenFileName(
+            this, tr("Open trace to compare"), QString(),
+            tr("Traces (*.otf2 *.otf *.xml);;All files (*)"));
+        if (filename.isEmpty() || loadWatcher.isRunning()) return;
+
+        filename_ = filename;
+        fileLabel->setText(QFileInfo(filename).fileName());
+        statusLabel->setText(tr("Loading..."));
+        loadWatcher.setFuture(QtConcurrent::run(&Compare::load, filename));
+    }
+
+    void traceLoaded()
+    {
+        second_ = loadWatcher.result();
+
+        // Only regions present in both traces can align them.
+        QStringList names;
+        const Selection& first = model()->getStates();
+        const Selection& second = second_->getStates();
+        for (int type = 0; type < first.size(); ++type)
+        {
+            if (second.itemLink(first.item(type)) != Selection::ROOT && !names.contains(first.item(type)))
+            {
+                names << first.item(type);
+            }
+        }
+        names.sort();
+
+        alignBox->blockSignals(true);
+        alignBox->clear();
+        alignBox->addItem(tr("Start of trace"));
+        alignBox->addItems(names);
+        alignBox->setEnabled(true);
+        alignBox->blockSignals(false);
+
+        other->setWindowTitle(QFileInfo(filename_).fileName());
+        other->setModel(second_);
+        other->resize(window()->width(), window()->height() / 2);
+        other->show();
+        alignmentChanged();
+
+        statusLabel->setText(tr("Computing..."));
+        diffWatcher.setFuture(QtConcurrent::run(&Compare::diff, model()->root(), second_));
+    }
+
+    void diffReady()
+    {
+        ProfileDiff result = diffWatcher.result();
+        regions->setDiff(result);
+        statusLabel->setText(result.isEmpty() ? tr("No regions") : QString());
+    }
+
+    void alignmentChanged()
+    {
+        if (!second_) return;
+
+        QString region = alignBox->currentIndex() > 0 ? alignBox->currentText() : QString();
+        offset_ = qint64(anchor(second_, region)) - qint64(anchor(model(), region));
+        followRange();
+    }
+
+    void modelChanged(TraceModelPtr& model)
+    {
+        if (!model_ || delta(*model.get(), *model_.get()) & Trace_model_delta::time_range)
+        {
+            followRange();
+        }
+        model_ = model;
+        regions->updateTime();
+    }
+
+private:
+    QLabel* fileLabel;
+    QComboBox* alignBox;
+    QTableView* table;
+    QLabel* statusLabel;
+    ProfileDiffModel* regions;
+    /** Diagram of the other trace. */
+    Canvas* other;
+
+    QString filename_;
+    TraceModelPtr second_;
+    TraceModelPtr model_;
+    /** Time in the other trace minus the aligned time in this one. */
+    qint64 offset_;
+
+    QFutureWatcher<TraceModelPtr> loadWatcher;
+    QFutureWatcher<ProfileDiff> diffWatcher;
+};
+
+
+Tool* createCompare(QWidget* parent, Canvas* canvas)
+{
+    return new Compare(parent, canvas);
+}
+
+}
@@ -0,0 +1,159 @@
+#include "duration_histogram.h"
+#include "time_vis.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QHelpEvent>
+#include <QtWidgets/QToolTip>
+
+#include <cmath>
+
+namespace vis4 {
+
+namespace {
+
+const int max_buckets = 24;
+const int histogram_margin = 2;
+
+}
+
+DurationHistogram::DurationHistogram(QWidget* parent) :
+    QWidget(parent),
+    maxCount_(0),
+    selected_(-1)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+}
+
+void DurationHistogram::setSketch(const DurationSketch& sketch)
+{
+    buckets_.clear();
+    maxCount_ = 0;
+    selected_ = -1;
+
+    if (!sketch.isEmpty())
+    {
+        double low = qMax(sketch.min(), quint64(1));
+        double ratio = double(sketch.max()) / low;
+
+        quint64 min = sketch.min();
+        quint64 below = 0;
+        for (int i = 1; i <= max_buckets && min <= sketch.max(); ++i)
+        {
+            quint64 max = (i == max_buckets) ? sketch.max()
+                                             : quint64(low * std::pow(ratio, double(i) / max_buckets));
+            if (max < min) continue;
+
+            quint64 rank = sketch.rank(max);
+            Bucket bucket = { min, max, rank - qMin(below, rank) };
+            buckets_ << bucket;
+            maxCount_ = qMax(maxCount_, bucket.count);
+
+            below = rank;
+            min = max + 1;
+        }
+    }
+
+    update();
+}
+
+void DurationHistogram::clearSelection()
+{
+    selected_ = -1;
+    update();
+}
+
+QSize DurationHistogram::sizeHint() const
+{
+    return QSize(200, 100);
+}
+
+bool DurationHistogram::event(QEvent* event)
+{
+    if (event->type() == QEvent::ToolTip)
+    {
+        QHelpEvent* help = static_cast<QHelpEvent*>(event);
+        int bucket = bucketAt(help->pos().x());
+        if (bucket != -1)
+        {
+            const Bucket& b = buckets_[bucket];
+            QToolTip::showText(help->globalPos(),
+                               tr("%1 - %2: about %3 states")
+                               .arg(Time(b.min).toString(true))
+                               .arg(Time(b.max).toString(true))
+                               .arg(b.count));
+        }
+        else
+        {
+            QToolTip::hideText();
+        }
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+void DurationHistogram::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+
+    if (buckets_.isEmpty())
+    {
+        painter.drawText(rect(), Qt::AlignCenter, tr("No states"));
+        return;
+    }
+
+    for (int i = 0; i < buckets_.size(); ++i)
+    {
+        QColor color = (i == selected_) ? QColor(Qt::red) : palette().color(QPalette::Highlight);
+        painter.fillRect(barRect(i), color);
+    }
+
+    int textHeight = fontMetrics().height();
+    QRect labels(histogram_margin, height() - textHeight,
+                 width() - 2 * histogram_margin, textHeight);
+    painter.drawText(labels, Qt::AlignLeft, Time(buckets_.first().min).toString(true));
+    painter.drawText(labels, Qt::AlignRight, Time(buckets_.last().max).toString(true));
+}
+
+void DurationHistogram::mousePressEvent(QMouseEvent* event)
+{
+    int bucket = bucketAt(event->pos().x());
+    if (bucket == -1 || event->button() != Qt::LeftButton)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    selected_ = bucket;
+    update();
+    emit bucketClicked(buckets_[bucket].min, buckets_[bucket].max);
+}
+
+int DurationHistogram::bucketAt(int x) const
+{
+    for (int i = 0; i < buckets_.size(); ++i)
+    {
+        QRect bar = barRect(i);
+        if (x >= bar.left() && x <= bar.right())
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QRect DurationHistogram::barRect(int bucket) const
+{
+    int bottom = height() - fontMetrics().height() - histogram_margin;
+    int available = bottom - histogram_margin;
+    int width = (this->width() - 2 * histogram_margin) / qMax(buckets_.size(), 1);
+
+    // Every non-empty bucket is at least one pixel high.
+    const Bucket& b = buckets_[bucket];
+    int height = maxCount_ ? int(double(b.count) / maxCount_ * available) : 0;
+    if (b.count && !height) height = 1;
+
+    return QRect(histogram_margin + bucket * width, bottom - height, qMax(width - 1, 1), height);
+}
+
+}
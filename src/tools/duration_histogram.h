@@ -0,0 +1,60 @@
+#ifndef DURATION_HISTOGRAM_H
+#define DURATION_HISTOGRAM_H
+
+#include <QtWidgets/QWidget>
+#include <QVector>
+
+#include "duration_sketch.h"
+
+namespace vis4 {
+
+/**
+ * Histogram of state durations, drawn from a duration sketch.
+ *
+ * Buckets are spaced logarithmically between the shortest and the
+ * longest duration, counts are estimated by ranks in the sketch, so
+ * the histogram takes the same time for any number of states.
+ */
+class DurationHistogram : public QWidget
+{
+    Q_OBJECT
+public:
+    DurationHistogram(QWidget* parent = nullptr);
+
+    void setSketch(const DurationSketch& sketch);
+
+    /** Drops selection of the bucket. */
+    void clearSelection();
+
+    QSize sizeHint() const;
+
+signals:
+    /** Emitted when a bucket is clicked, with its bounds in nanoseconds. */
+    void bucketClicked(quint64 min, quint64 max);
+
+protected:
+    bool event(QEvent* event);
+    void paintEvent(QPaintEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+
+private:
+    struct Bucket
+    {
+        quint64 min;
+        quint64 max;
+        quint64 count;
+    };
+
+    /** Returns bucket under x, or -1. */
+    int bucketAt(int x) const;
+    QRect barRect(int bucket) const;
+
+private:
+    QVector<Bucket> buckets_;
+    quint64 maxCount_;
+    int selected_;
+};
+
+}
+
+#endif
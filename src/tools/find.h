@@ -5,6 +5,9 @@
 #include <QtWidgets/QRadioButton>
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/QComboBox>
+#include <QtWidgets/QSpinBox>
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
 #include <QMouseEvent>
 #include <QStandardItemModel>
 #include <QtWidgets/QLabel>
@@ -17,6 +20,7 @@
 
 #include "tool.h"
 #include "find_tabs.h"
+#include "find_results.h"
 #include "canvas_item.h"
 #include "canvas.h"
 #include "trace_model.h"
@@ -112,6 +116,8 @@ class Find : public Tool
 public:
     Find(QWidget* parent, Canvas* c) :
         Tool(parent, c),
+        nothing_yet(true),
+        searchedComponent(-1),
         highlighted_component(-1),
       componentListModel_(0), state_restored(false)
     {
@@ -126,9 +132,17 @@ public:
                      "<p>The 'Search for' group allows you to select search for "
                      "events or for states."
                      "<p>The last group has a list of event or state types that "
-                     "must be searched for. For events, if an event is "
+                     "must be searched for, or a query, such as an event "
+                     "not followed by another one within some time. "
+                     "For events, if an event is "
                      "globally filtered, it will be shown in gray and you "
-                     "cannot search for it."));
+                     "cannot search for it."
+                     "<p>F3 shows the next match, Shift+F3 the previous one. "
+                     "Matches are numbered in time order, and you can go "
+                     "to a match by its number."
+                     "<p>'Find all' lists every match in a table, which "
+                     "can be sorted by any column. Click on a row to show "
+                     "the match on the diagram."));
 
         QAction* find_again = new QAction(parent);
         find_again->setShortcut(Qt::Key_F3);
@@ -138,6 +152,14 @@ public:
         connect(find_again, SIGNAL(triggered(bool)), this,
                             SLOT(findNext()));
 
+        QAction* find_previous = new QAction(parent);
+        find_previous->setShortcut(Qt::SHIFT + Qt::Key_F3);
+        find_previous->setShortcutContext(Qt::WindowShortcut);
+        c->addAction(find_previous);
+
+        connect(find_previous, SIGNAL(triggered(bool)), this,
+                               SLOT(findPrevious()));
+
         QVBoxLayout* mainLayout = new QVBoxLayout(this);
 
         QHBoxLayout* startTimeLayout = new QHBoxLayout();
@@ -183,15 +205,17 @@ public:
         findTabWidget = new QTabWidget(this);
         mainLayout->addWidget(findTabWidget);
 
-        //queryTab = new FindQueryTab(this);
+        queryTab = new FindQueryTab(this);
         findTabWidget->addTab(queryTab, queryTab->name());
 
         connect(queryTab, SIGNAL(showEvent(EventModel*)), this,
                           SLOT(eventFound(EventModel*)));
+        connect(queryTab, SIGNAL(showState(StateModel*)), this,
+                          SLOT(stateFound(StateModel*)));
         connect(queryTab, SIGNAL(stateChanged()), this,
                           SLOT(tabStateChanged()));
 
-        //eventsTab = new FindEventsTab(this);
+        eventsTab = new FindEventsTab(this);
         findTabWidget->addTab(eventsTab, eventsTab->name());
 
         connect(eventsTab, SIGNAL(showEvent(EventModel*)),this,
@@ -199,7 +223,7 @@ public:
         connect(eventsTab, SIGNAL(stateChanged()), this,
                            SLOT(tabStateChanged()));
 
-        //statesTab = new FindStatesTab(this);
+        statesTab = new FindStatesTab(this);
         findTabWidget->addTab(statesTab, statesTab->name());
         connect(statesTab, SIGNAL(showState(StateModel*)), this,
                            SLOT(stateFound(StateModel*)));
@@ -214,18 +238,80 @@ public:
         QHBoxLayout* buttons = new QHBoxLayout(0);
         mainLayout->addLayout(buttons);
 
+        matchLabel = new QLabel(this);
+        buttons->addWidget(matchLabel);
         buttons->addStretch();
 
+        previousButton = new QPushButton(tr("Previous"), this);
+        buttons->addWidget(previousButton);
+        connect(previousButton, SIGNAL(clicked(bool)), this,
+                                SLOT( findPrevious() ));
+
         findButton = new QPushButton(tr("Find"), this);
         buttons->addWidget(findButton);
         connect(findButton, SIGNAL(clicked(bool)), this,
                             SLOT( findNext() ));
 
+        // Go to match by number
+
+        QHBoxLayout* gotoLayout = new QHBoxLayout(0);
+        mainLayout->addLayout(gotoLayout);
+
+        gotoLayout->addWidget(new QLabel(tr("Match:"), this));
+        matchNumber = new QSpinBox(this);
+        matchNumber->setMinimum(1);
+        gotoLayout->addWidget(matchNumber);
+        gotoLayout->addStretch();
+
+        gotoButton = new QPushButton(tr("Go"), this);
+        gotoLayout->addWidget(gotoButton);
+        connect(gotoButton, SIGNAL(clicked(bool)), this,
+                            SLOT( findMatch() ));
+
+        // "Find all" results
+
+        QHBoxLayout* resultsLayout = new QHBoxLayout(0);
+        mainLayout->addLayout(resultsLayout);
+
+        resultsLabel = new QLabel(this);
+        resultsLayout->addWidget(resultsLabel);
+        resultsLayout->addStretch();
+
+        findAllButton = new QPushButton(tr("Find all"), this);
+        resultsLayout->addWidget(findAllButton);
+        connect(findAllButton, SIGNAL(clicked(bool)), this,
+                               SLOT( findAll() ));
+
+        results = new FindResultsModel(this);
+        connect(results, SIGNAL(rowsInserted(const QModelIndex&, int, int)), this,
+                         SLOT(updateResultsCount()));
+        connect(results, SIGNAL(modelReset()), this,
+                         SLOT(updateResultsCount()));
+        connect(results, SIGNAL(finished()), this,
+                         SLOT(updateResultsCount()));
+
+        // Rows have fixed height, so the view never
+        // has to look at all of them.
+        resultsView = new QTableView(this);
+        resultsView->setModel(results);
+        resultsView->setSortingEnabled(true);
+        resultsView->sortByColumn(FindResultsModel::TimeColumn, Qt::AscendingOrder);
+        resultsView->setSelectionBehavior(QAbstractItemView::SelectRows);
+        resultsView->setSelectionMode(QAbstractItemView::SingleSelection);
+        resultsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        resultsView->verticalHeader()->hide();
+        resultsView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        resultsView->horizontalHeader()->setStretchLastSection(true);
+        mainLayout->addWidget(resultsView);
+
+        connect(resultsView, SIGNAL(clicked(const QModelIndex&)), this,
+                             SLOT(resultClicked(const QModelIndex&)));
+
         highlight = new Found_item_highlight;
         getCanvas()->addItem(highlight);
 
-        connect(getCanvas(), SIGNAL(modelChanged(TraceModel::TraceModelPtr &)), this,
-                             SLOT(modelChanged(TraceModel::TraceModelPtr &)));
+        connect(getCanvas(), SIGNAL(modelChanged(TraceModelPtr &)), this,
+                             SLOT(modelChanged(TraceModelPtr &)));
         connect(this, SIGNAL(messageBox(const QString &)), this,
                       SLOT(showMessageBox(const QString &)), Qt::QueuedConnection);
 
@@ -415,6 +501,7 @@ private: /* methods */
         nothing_yet = true;
         resetHightlight();
         emit extraHelp(QString());
+        results->clear();
 
         if (reset_time)
         {
@@ -443,6 +530,7 @@ private: /* methods */
         statesTab->setModel(model_);
 
         highlightChanged();
+        updateMatchCount();
         saveState();
     }
 
@@ -490,6 +578,52 @@ private: /* methods */
         statesTab->saveState(settings);
     }
 
+    /* Shows the number of current match and the number of matches.  */
+    void updateMatchCount()
+    {
+        if (!active_tab->isSearchAllowed())
+        {
+            matchLabel->clear();
+            matchNumber->setEnabled(false);
+            gotoButton->setEnabled(false);
+            return;
+        }
+
+        int count = active_tab->matchCount();
+        int current = active_tab->currentMatch();
+
+        if (current == -1)
+            matchLabel->setText(tr("%1 matches").arg(count));
+        else
+            matchLabel->setText(tr("Match %1 of %2").arg(current + 1).arg(count));
+
+        matchNumber->setMaximum(qMax(count, 1));
+        matchNumber->setEnabled(count != 0);
+        gotoButton->setEnabled(count != 0);
+    }
+
+    void searchDone(bool searched)
+    {
+        if (!searched) {
+            if (nothing_yet)
+            {
+                emit messageBox(tr("Nothing was found."));
+                resetSearch(false);
+            }
+            else
+            {
+                emit messageBox(tr("Search is complete."));
+                emit extraHelp(QString());
+            }
+        } else {
+            nothing_yet = false;
+            emit extraHelp(tr("<b>Press F3 to continue search, "
+                              "Shift+F3 to search backwards.</b>"));
+        }
+
+        updateMatchCount();
+    }
+
 private slots:
 
     void restoreState()
@@ -522,30 +656,49 @@ private slots:
         state_restored = true;
     }
 
+private slots:
+
     void findNext()
     {
         if (!findButton->isEnabled()) return;
+        searchDone(active_tab->findNext());
+    }
 
-        QApplication::setOverrideCursor(Qt::WaitCursor);
+    void findPrevious()
+    {
+        if (!previousButton->isEnabled()) return;
+        searchDone(active_tab->findPrevious());
+    }
 
-        bool searched = active_tab->findNext();
-        if (!searched) {
-            if (nothing_yet)
-            {
-                emit messageBox(tr("Nothing was found."));
-                resetSearch(false);
-            }
-            else
-            {
-                emit messageBox(tr("Search is complete."));
-                emit extraHelp(QString());
-            }
-        } else {
-            nothing_yet = false;
-            emit extraHelp(tr("<b>Press F3 to continue search.</b>"));
-        }
+    void findMatch()
+    {
+        if (!gotoButton->isEnabled()) return;
+        searchDone(active_tab->findMatch(matchNumber->value() - 1));
+    }
+
+    void findAll()
+    {
+        if (!findAllButton->isEnabled()) return;
+        active_tab->findAll(results);
+        updateResultsCount();
+    }
+
+    void updateResultsCount()
+    {
+        if (results->isRunning())
+            resultsLabel->setText(tr("Searching... %1 found").arg(results->rowCount()));
+        else if (results->rowCount() != 0)
+            resultsLabel->setText(tr("%1 found").arg(results->rowCount()));
+        else
+            resultsLabel->clear();
+    }
 
-        QApplication::restoreOverrideCursor();
+    void resultClicked(const QModelIndex& index)
+    {
+        if (StateModel* s = results->state(index.row()))
+            stateFound(s);
+        else
+            eventFound(results->event(index.row()));
     }
 
     void reset()
@@ -611,29 +764,26 @@ private slots:
     void tabStateChanged()
     {
         if (sender() == active_tab)
+        {
             findButton->setEnabled(active_tab->isSearchAllowed());
+            previousButton->setEnabled(active_tab->isSearchAllowed());
+            findAllButton->setEnabled(active_tab->isSearchAllowed());
+            updateMatchCount();
+        }
 
         saveState();
     }
 
     void switchTab(int tab)
     {
-        switch (tab) {
-            case 0:
-                active_tab = queryTab;
-            break;
-
-            case 1:
-                active_tab = eventsTab;
-            break;
-
-            case 2:
-                active_tab = statesTab;
-            break;
-        }
+        active_tab = static_cast<FindTab*>(findTabWidget->widget(tab));
 
         findTabWidget->setCurrentIndex(tab);
         findButton->setEnabled(active_tab->isSearchAllowed());
+        previousButton->setEnabled(active_tab->isSearchAllowed());
+        findAllButton->setEnabled(active_tab->isSearchAllowed());
+        updateMatchCount();
+        results->clear();
         saveState();
     }
 
@@ -684,6 +834,14 @@ private: /* memebers */
     FindTab * active_tab;
 
     QPushButton* findButton;
+    QPushButton* previousButton;
+    QPushButton* gotoButton;
+    QPushButton* findAllButton;
+    QLabel* resultsLabel;
+    QTableView* resultsView;
+    FindResultsModel* results;
+    QLabel* matchLabel;
+    QSpinBox* matchNumber;
 
     int highlighted_component;
     Time highlighted_min;
@@ -0,0 +1,281 @@
+#include "find_results.h"
+#include "event_model.h"
+#include "state_model.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace vis4 {
+
+FindResultsModel::FindResultsModel(QObject* parent) :
+    QAbstractTableModel(parent),
+    sortColumn_(TimeColumn),
+    sortOrder_(Qt::AscendingOrder)
+{
+    connect(&stateWatcher_, SIGNAL(resultsReadyAt(int, int)), this,
+                            SLOT(statesReady(int, int)));
+    connect(&stateWatcher_, SIGNAL(finished()), this,
+                            SIGNAL(finished()));
+
+    connect(&eventWatcher_, SIGNAL(resultsReadyAt(int, int)), this,
+                            SLOT(eventsReady(int, int)));
+    connect(&eventWatcher_, SIGNAL(finished()), this,
+                            SIGNAL(finished()));
+}
+
+FindResultsModel::~FindResultsModel()
+{
+    cancel();
+}
+
+void FindResultsModel::findStates(const TraceModelPtr& model)
+{
+    collectStates(model, model->findAllStates());
+}
+
+void FindResultsModel::findEvents(const TraceModelPtr& model)
+{
+    collectEvents(model, model->findAllEvents());
+}
+
+void FindResultsModel::collectStates(const TraceModelPtr& model,
+                                     const QFuture<QVector<StateModel*>>& future)
+{
+    clear();
+    model_ = model;
+    stateWatcher_.setFuture(future);
+}
+
+void FindResultsModel::collectEvents(const TraceModelPtr& model,
+                                     const QFuture<QVector<EventModel*>>& future)
+{
+    clear();
+    model_ = model;
+    eventWatcher_.setFuture(future);
+}
+
+void FindResultsModel::clear()
+{
+    cancel();
+
+    beginResetModel();
+    rows_.clear();
+    model_.reset();
+    endResetModel();
+}
+
+bool FindResultsModel::isRunning() const
+{
+    return stateWatcher_.isRunning() || eventWatcher_.isRunning();
+}
+
+StateModel* FindResultsModel::state(int row) const
+{
+    return rows_[row].state;
+}
+
+EventModel* FindResultsModel::event(int row) const
+{
+    return rows_[row].event;
+}
+
+int FindResultsModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows_.size();
+}
+
+int FindResultsModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant FindResultsModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    const Row& row = rows_[index.row()];
+
+    switch (index.column())
+    {
+        case TimeColumn:
+            return rowTime(row).toString();
+
+        case ComponentColumn:
+            return model_->getComponentName(rowComponent(row));
+
+        case TypeColumn:
+            return row.state ? model_->getStates().item(rowType(row))
+                             : model_->getEvents().item(rowType(row));
+
+        case DurationColumn:
+            return row.state ? rowDuration(row).toString() : QVariant();
+    }
+
+    return QVariant();
+}
+
+QVariant FindResultsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    switch (section)
+    {
+        case TimeColumn:      return tr("Time");
+        case ComponentColumn: return tr("Component");
+        case TypeColumn:      return tr("Type");
+        case DurationColumn:  return tr("Duration");
+    }
+
+    return QVariant();
+}
+
+void FindResultsModel::sort(int column, Qt::SortOrder order)
+{
+    sortColumn_ = column;
+    sortOrder_ = order;
+
+    reorder(0);
+}
+
+void FindResultsModel::statesReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        const QVector<StateModel*> states = stateWatcher_.resultAt(i);
+
+        QVector<Row> rows;
+        rows.reserve(states.size());
+        foreach (StateModel* s, states)
+        {
+            Row row = { s, nullptr };
+            rows << row;
+        }
+        append(rows);
+    }
+}
+
+void FindResultsModel::eventsReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        const QVector<EventModel*> events = eventWatcher_.resultAt(i);
+
+        QVector<Row> rows;
+        rows.reserve(events.size());
+        foreach (EventModel* e, events)
+        {
+            Row row = { nullptr, e };
+            rows << row;
+        }
+        append(rows);
+    }
+}
+
+void FindResultsModel::cancel()
+{
+    stateWatcher_.cancel();
+    stateWatcher_.waitForFinished();
+
+    eventWatcher_.cancel();
+    eventWatcher_.waitForFinished();
+
+    // Drops results of the old search that are not delivered yet.
+    stateWatcher_.setFuture(QFuture<QVector<StateModel*>>());
+    eventWatcher_.setFuture(QFuture<QVector<EventModel*>>());
+}
+
+void FindResultsModel::append(const QVector<Row>& rows)
+{
+    if (rows.isEmpty())
+    {
+        return;
+    }
+
+    int first = rows_.size();
+
+    beginInsertRows(QModelIndex(), first, first + rows.size() - 1);
+    rows_ += rows;
+    endInsertRows();
+
+    reorder(first);
+}
+
+void FindResultsModel::reorder(int first)
+{
+    // Sorts positions of rows, so persistent indexes can follow them.
+    QVector<int> order(rows_.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [this](int a, int b) { return this->less(rows_[a], rows_[b]); };
+
+    emit layoutAboutToBeChanged();
+
+    std::stable_sort(order.begin() + first, order.end(), less);
+    std::inplace_merge(order.begin(), order.begin() + first, order.end(), less);
+
+    QVector<Row> sorted(rows_.size());
+    QVector<int> moved(rows_.size());
+    for (int i = 0; i < order.size(); ++i)
+    {
+        sorted[i] = rows_[order[i]];
+        moved[order[i]] = i;
+    }
+    rows_.swap(sorted);
+
+    QModelIndexList from = persistentIndexList();
+    QModelIndexList to;
+    foreach (const QModelIndex& index, from)
+    {
+        to << this->index(moved[index.row()], index.column());
+    }
+    changePersistentIndexList(from, to);
+
+    emit layoutChanged();
+}
+
+Time FindResultsModel::rowTime(const Row& row) const
+{
+    return row.state ? row.state->start : row.event->time;
+}
+
+Time FindResultsModel::rowDuration(const Row& row) const
+{
+    return row.state ? row.state->end - row.state->start : Time(0ull);
+}
+
+int FindResultsModel::rowComponent(const Row& row) const
+{
+    return row.state ? int(row.state->component) : row.event->component;
+}
+
+int FindResultsModel::rowType(const Row& row) const
+{
+    return row.state ? row.state->type : row.event->type;
+}
+
+bool FindResultsModel::less(const Row& a, const Row& b) const
+{
+    const Row& first = (sortOrder_ == Qt::AscendingOrder) ? a : b;
+    const Row& second = (sortOrder_ == Qt::AscendingOrder) ? b : a;
+
+    switch (sortColumn_)
+    {
+        case ComponentColumn:
+            return rowComponent(first) < rowComponent(second);
+
+        case TypeColumn:
+            return rowType(first) < rowType(second);
+
+        case DurationColumn:
+            return rowDuration(first) < rowDuration(second);
+    }
+
+    return rowTime(first) < rowTime(second);
+}
+
+}
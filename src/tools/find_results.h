@@ -0,0 +1,108 @@
+#ifndef FIND_RESULTS_H
+#define FIND_RESULTS_H
+
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QVector>
+
+#include "trace_model.h"
+
+namespace vis4 {
+
+class EventModel;
+class StateModel;
+
+/**
+ * Table of all matches of a search, for the "find all" mode.
+ *
+ * Matches are collected in parallel by the trace model and are
+ * appended as parts of the search become ready. Rows only refer
+ * to states or events of the trace, all columns are formatted on
+ * demand, so the view stays fast for any number of matches.
+ */
+class FindResultsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column
+    {
+        TimeColumn,
+        ComponentColumn,
+        TypeColumn,
+        DurationColumn,
+        ColumnCount
+    };
+
+    FindResultsModel(QObject* parent = nullptr);
+    ~FindResultsModel();
+
+    /** Starts search of all occurrences in the model,
+        dropping previous results. */
+    void findStates(const TraceModelPtr& model);
+    void findEvents(const TraceModelPtr& model);
+
+    /** Shows results of another search over the model. */
+    void collectStates(const TraceModelPtr& model, const QFuture<QVector<StateModel*>>& future);
+    void collectEvents(const TraceModelPtr& model, const QFuture<QVector<EventModel*>>& future);
+
+    /** Cancels the search and drops results. */
+    void clear();
+
+    bool isRunning() const;
+
+    /** Returns the match in the row, or null if the row is of another kind. */
+    StateModel* state(int row) const;
+    EventModel* event(int row) const;
+
+public: /* overloaded item model methods */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+signals:
+    /** Emitted when all parts of the search are added. */
+    void finished();
+
+private slots:
+    void statesReady(int begin, int end);
+    void eventsReady(int begin, int end);
+
+private: /* methods */
+    struct Row
+    {
+        StateModel* state;
+        EventModel* event;
+    };
+
+    void cancel();
+    void append(const QVector<Row>& rows);
+
+    /** Sorts rows from 'first' on and merges them into the sorted
+        rows before, keeping persistent indexes on their rows. */
+    void reorder(int first);
+
+    Time rowTime(const Row& row) const;
+    Time rowDuration(const Row& row) const;
+    int rowComponent(const Row& row) const;
+    int rowType(const Row& row) const;
+
+    /** Order of rows by the sort column. */
+    bool less(const Row& a, const Row& b) const;
+
+private: /* members */
+    TraceModelPtr model_;
+    QVector<Row> rows_;
+
+    int sortColumn_;
+    Qt::SortOrder sortOrder_;
+
+    QFutureWatcher<QVector<StateModel*>> stateWatcher_;
+    QFutureWatcher<QVector<EventModel*>> eventWatcher_;
+};
+
+}
+
+#endif
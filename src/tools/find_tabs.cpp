@@ -1,4 +1,5 @@
 #include "find_tabs.h"
+#include "find_results.h"
 #include "trace_model.h"
 #include "event_model.h"
 #include "state_model.h"
@@ -12,11 +13,47 @@
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QStackedLayout>
 
-#include <set>
+#include <algorithm>
 
 namespace vis4 {
 
-using std::set;
+//---------------------------------------------------------------------------------------
+// FindTab class implementation
+//---------------------------------------------------------------------------------------
+
+bool FindTab::findNext()
+{
+    int n = (current_ == -1) ? occurrencesBefore(startTime()) : current_ + 1;
+    return findMatch(n);
+}
+
+bool FindTab::findPrevious()
+{
+    int n = (current_ == -1) ? occurrencesBefore(startTime()) - 1 : current_ - 1;
+    return findMatch(n);
+}
+
+bool FindTab::findMatch(int n)
+{
+    if (n < 0 || n >= occurrences())
+    {
+        return false;
+    }
+
+    current_ = n;
+    showOccurrence(n);
+    return true;
+}
+
+int FindTab::matchCount()
+{
+    return occurrences();
+}
+
+int FindTab::currentMatch() const
+{
+    return current_;
+}
 
 //---------------------------------------------------------------------------------------
 // FindEventsTab class implementation
@@ -40,27 +77,47 @@ FindEventsTab::FindEventsTab(Tool* find_tool) :
 void FindEventsTab::reset()
 {
     filtered_model_.reset();
+    current_ = -1;
 }
 
-bool FindEventsTab::findNext()
+void FindEventsTab::ensureFiltered()
 {
     Q_ASSERT(model_.get() != 0);
 
-    if (!filtered_model_.get()) {
-        Selection filter = model_->events() & selector_->selection();
-        filtered_model_ = model_->filter_events(filter);
-        filtered_model_->rewind();
-    }
-
-    Event_model* e = filtered_model_->next_event();
-    if (e != nullptr)
+    if (!filtered_model_.get())
     {
-        model_ = model_->set_range(e->time, model_->max_time());
-        emit showEvent(e);
-        return true;
+        Selection filter = model_->getEvents() & selector_->selection();
+        filtered_model_ = model_->filterEvents(filter);
     }
+}
 
-    return false;
+void FindEventsTab::findAll(FindResultsModel* results)
+{
+    ensureFiltered();
+    results->findEvents(filtered_model_);
+}
+
+int FindEventsTab::occurrences()
+{
+    ensureFiltered();
+    return filtered_model_->eventOccurrences();
+}
+
+int FindEventsTab::occurrencesBefore(const Time& time)
+{
+    ensureFiltered();
+    return filtered_model_->eventOccurrencesBefore(time);
+}
+
+void FindEventsTab::showOccurrence(int n)
+{
+    ensureFiltered();
+    emit showEvent(filtered_model_->eventOccurrence(n));
+}
+
+Time FindEventsTab::startTime()
+{
+    return model_->getMinTime();
 }
 
 void FindEventsTab::setModel(TraceModelPtr & model)
@@ -70,17 +127,23 @@ void FindEventsTab::setModel(TraceModelPtr & model)
         if (delta(*model.get(), *model_.get()) &
             Trace_model_delta::event_types)
         {
-            selector_->initialize(model->events(),
+            selector_->initialize(model->getEvents(),
                 selector_->selection());
             reset();
         }
+        else if (delta(*model.get(), *model_.get()) &
+                 (Trace_model_delta::components | Trace_model_delta::component_position))
+        {
+            reset();
+        }
     }
     else
     {
-            selector_->initialize(model->events(), model->events());
+        selector_->initialize(model->getEvents(), model->getEvents());
     }
 
     model_ = model;
+    filtered_model_.reset();
     emit stateChanged();
 }
 
@@ -131,30 +194,47 @@ FindStatesTab::FindStatesTab(Tool* find_tool)
 void FindStatesTab::reset()
 {
     filtered_model_.reset();
+    current_ = -1;
 }
 
-bool FindStatesTab::findNext()
+void FindStatesTab::ensureFiltered()
 {
     Q_ASSERT(model_.get() != 0);
 
-    if (!filtered_model_.get()) {
-        Selection filter = model_->states() & selector_->selection();
-        filtered_model_ = model_->filter_states(filter);
-        filtered_model_->rewind();
-
+    if (!filtered_model_.get())
+    {
+        Selection filter = model_->getStates() & selector_->selection();
+        filtered_model_ = model_->filterStates(filter);
     }
+}
 
-    for (;;) {
-        State_model* s = filtered_model_->next_state();
-        if (s != nullptr)
-        {
-            model_ = model_->set_range(s->begin, model_->max_time());
-            emit showState(s);
-            return true;
-        }
+void FindStatesTab::findAll(FindResultsModel* results)
+{
+    ensureFiltered();
+    results->findStates(filtered_model_);
+}
 
-        return false;
-    }
+int FindStatesTab::occurrences()
+{
+    ensureFiltered();
+    return filtered_model_->stateOccurrences();
+}
+
+int FindStatesTab::occurrencesBefore(const Time& time)
+{
+    ensureFiltered();
+    return filtered_model_->stateOccurrencesBefore(time);
+}
+
+void FindStatesTab::showOccurrence(int n)
+{
+    ensureFiltered();
+    emit showState(filtered_model_->stateOccurrence(n));
+}
+
+Time FindStatesTab::startTime()
+{
+    return model_->getMinTime();
 }
 
 void FindStatesTab::setModel(TraceModelPtr & model)
@@ -164,18 +244,24 @@ void FindStatesTab::setModel(TraceModelPtr & model)
         if (delta(*model.get(), *model_.get()) &
             Trace_model_delta::state_types)
         {
-            selector_->initialize(model->available_states() & model->states(),
+            selector_->initialize(model->getAvailableStates() & model->getStates(),
                 selector_->selection());
             reset();
         }
+        else if (delta(*model.get(), *model_.get()) &
+                 (Trace_model_delta::components | Trace_model_delta::component_position))
+        {
+            reset();
+        }
     }
     else
     {
-        Selection states = model->available_states() & model->states();
+        Selection states = model->getAvailableStates() & model->getStates();
         selector_->initialize(states, states);
     }
 
     model_ = model;
+    filtered_model_.reset();
     emit stateChanged();
 }
 
@@ -210,7 +296,7 @@ void FindStatesTab::selectionChanged(const Selection & selection)
 
 FindQueryTab::FindQueryTab(Tool * find_tool)
     : FindTab(find_tool), active_checker(0),
-      active_checker_is_ready(false)
+      active_checker_is_ready(false), matched_(false)
 {
     setObjectName("query");
 
@@ -225,15 +311,6 @@ FindQueryTab::FindQueryTab(Tool * find_tool)
 
     layout->addSpacing(10);
 
-    // Do we have any checkers in general?
-    if (Checker::availableCheckers().isEmpty())
-    {
-        checkerCombo->addItem(tr("No checkers"));
-        checkerCombo->setEnabled(false);
-        layout->addStretch(); return;
-    }
-
-
     // Add nice title "Checker settings"
 
     checkerSettings_layout = new QHBoxLayout();
@@ -255,81 +332,106 @@ FindQueryTab::FindQueryTab(Tool * find_tool)
     layout->addLayout(checkerWidgetContainer);
     layout->addStretch();
 
-    // Create tip for case when not all necessary events is enabled.
+    // Create tip for case when not all necessary types are enabled.
 
     checkerWidgetContainer->addWidget(new QWidget(this));
     QVBoxLayout * infoTab_layout = new QVBoxLayout(
         checkerWidgetContainer->widget(0));
 
     QLabel * tipLabel = new QLabel(this);
-    tipLabel->setText(tr("<b>Some necessary events for this checker is filtered. "
+    tipLabel->setText(tr("<b>Some necessary events or states for this checker are filtered. "
         "Checker is not available.</b>"));
     tipLabel->setWordWrap(true);
     infoTab_layout->addWidget(tipLabel);
 
-    QPushButton * activateEventsBtn = new QPushButton(tr("Activate events"), this);
-    connect(activateEventsBtn, SIGNAL( pressed() ),
-        this, SLOT( activateCheckerEvents() ));
-    infoTab_layout->addWidget(activateEventsBtn);
+    QPushButton * activateTypesBtn = new QPushButton(tr("Activate"), this);
+    connect(activateTypesBtn, SIGNAL( pressed() ),
+        this, SLOT( activateCheckerTypes() ));
+    infoTab_layout->addWidget(activateTypesBtn);
     infoTab_layout->addStretch();
 
     initializeCheckers();
 
     connect(checkerCombo, SIGNAL( currentIndexChanged(int) ),
         this, SLOT( checkerStateChanged() ));
+
+    connect(&stateWatcher_, SIGNAL(resultsReadyAt(int, int)), this,
+                            SLOT(statesMatched(int, int)));
+    connect(&stateWatcher_, SIGNAL(finished()), this,
+                            SLOT(matchingFinished()));
+
+    connect(&eventWatcher_, SIGNAL(resultsReadyAt(int, int)), this,
+                            SLOT(eventsMatched(int, int)));
+    connect(&eventWatcher_, SIGNAL(finished()), this,
+                            SLOT(matchingFinished()));
+}
+
+FindQueryTab::~FindQueryTab()
+{
+    cancelMatching();
 }
 
 void FindQueryTab::reset()
 {
-    model_with_checker.reset();
+    cancelMatching();
+    filtered_model_.reset();
+    matched_ = false;
+    event_matches_.clear();
+    state_matches_.clear();
+    current_ = -1;
 }
 
-bool FindQueryTab::findNext()
+void FindQueryTab::findAll(FindResultsModel* results)
 {
-    Q_ASSERT(model_.get() != 0);
+    ensureFiltered();
 
-    if (!model_with_checker.get()) {
-        model_with_checker = model_->install_checker(active_checker);
-        model_with_checker->rewind();
+    Pattern pattern = active_checker->pattern();
+    if (pattern.matchesStates())
+    {
+        results->collectStates(filtered_model_, pattern.matchStates(filtered_model_));
     }
-
-    Event_model* e = model_with_checker->next_event();
-
-    if (e != nullptr)
+    else
     {
-        model_ = model_->set_range(e->time, model_->max_time());
-        emit showEvent(e);
-        return true;
+        results->collectEvents(filtered_model_, pattern.matchEvents(filtered_model_));
     }
-
-    return false;
 }
 
 void FindQueryTab::setModel(TraceModelPtr & model)
 {
-    if (checkers.isEmpty()) return;
+    // Matches don't depend on time range, so they are
+    // dropped only when types or components change.
+    bool changed = !model_.get() ||
+        (delta(*model.get(), *model_.get()) &
+         (Trace_model_delta::event_types | Trace_model_delta::state_types |
+          Trace_model_delta::components | Trace_model_delta::component_position));
 
     model_ = model;
-    updateChecker();
 
+    if (changed)
+    {
+        reset();
+        foreach (pChecker checker, checkers)
+        {
+            checker->setModel(model_);
+        }
+    }
+
+    updateChecker();
     emit stateChanged();
 }
 
 bool FindQueryTab::isSearchAllowed()
 {
-    return active_checker_is_ready;
+    return active_checker_is_ready && matched_;
 }
 
 void FindQueryTab::saveState(QSettings & settings)
 {
-    if (checkers.isEmpty()) return;
     settings.setValue("checker_name", checkerCombo->currentText());
 }
 
 void FindQueryTab::restoreState(QSettings & settings)
 {
-    if (checkers.isEmpty()) return;
-
     // Restore state of checker box
     QString checker_name = settings.value("checker_name").toString();
     if (!checker_name.isEmpty()) {
@@ -339,11 +441,46 @@ void FindQueryTab::restoreState(QSettings & settings)
     }
 }
 
+int FindQueryTab::occurrences()
+{
+    return event_matches_.size() + state_matches_.size();
+}
+
+int FindQueryTab::occurrencesBefore(const Time& time)
+{
+    if (!state_matches_.isEmpty())
+    {
+        return std::lower_bound(state_matches_.begin(), state_matches_.end(), time,
+            [](const StateModel* s, const Time& t) { return s->start < t; })
+            - state_matches_.begin();
+    }
+
+    return std::lower_bound(event_matches_.begin(), event_matches_.end(), time,
+        [](const EventModel* e, const Time& t) { return e->time < t; })
+        - event_matches_.begin();
+}
+
+void FindQueryTab::showOccurrence(int n)
+{
+    if (!state_matches_.isEmpty())
+    {
+        emit showState(state_matches_[n]);
+    }
+    else
+    {
+        emit showEvent(event_matches_[n]);
+    }
+}
+
+Time FindQueryTab::startTime()
+{
+    return model_->getMinTime();
+}
+
 void FindQueryTab::initializeCheckers()
 {
-    QStringList names = Checker::availableCheckers();
-    for (int i = 0; i < names.size(); ++i) {
-        pChecker checker = Checker::createChecker(names[i]);
+    foreach (const QString& name, Checker::availableCheckers()) {
+        pChecker checker = Checker::createChecker(name);
         checkerCombo->addItem(checker->title());
 
         QWidget * widget = checker->widget();
@@ -357,6 +494,98 @@ void FindQueryTab::initializeCheckers()
     }
 }
 
+Selection FindQueryTab::checkerTypes() const
+{
+    Selection types = active_checker->pattern().matchesStates()
+        ? model_->getStates() : model_->getEvents();
+
+    foreach (int link, active_checker->types())
+    {
+        types.setEnabled(link, true);
+    }
+    return types;
+}
+
+void FindQueryTab::ensureFiltered()
+{
+    Q_ASSERT(model_.get() != 0);
+
+    if (filtered_model_.get()) return;
+
+    bool states = active_checker->pattern().matchesStates();
+
+    Selection types = states ? model_->getStates() : model_->getEvents();
+    types.disableAll(Selection::ROOT, true);
+    foreach (int link, active_checker->types())
+    {
+        types.setEnabled(link, true);
+    }
+
+    filtered_model_ = states ? model_->filterStates(types) : model_->filterEvents(types);
+}
+
+void FindQueryTab::startMatching()
+{
+    if (matched_ || stateWatcher_.isRunning() || eventWatcher_.isRunning()) return;
+
+    ensureFiltered();
+
+    // Every part of results holds matches of one component,
+    // parts are added as they are ready.
+    Pattern pattern = active_checker->pattern();
+    if (pattern.matchesStates())
+    {
+        stateWatcher_.setFuture(pattern.matchStates(filtered_model_));
+    }
+    else
+    {
+        eventWatcher_.setFuture(pattern.matchEvents(filtered_model_));
+    }
+}
+
+void FindQueryTab::cancelMatching()
+{
+    stateWatcher_.cancel();
+    stateWatcher_.waitForFinished();
+
+    eventWatcher_.cancel();
+    eventWatcher_.waitForFinished();
+
+    // Drops parts of the old matching that are not delivered yet.
+    stateWatcher_.setFuture(QFuture<QVector<StateModel*>>());
+    eventWatcher_.setFuture(QFuture<QVector<EventModel*>>());
+}
+
+void FindQueryTab::statesMatched(int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        state_matches_ += stateWatcher_.resultAt(i);
+    }
+}
+
+void FindQueryTab::eventsMatched(int begin, int end)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        event_matches_ += eventWatcher_.resultAt(i);
+    }
+}
+
+void FindQueryTab::matchingFinished()
+{
+    QFutureWatcherBase* watcher = static_cast<QFutureWatcherBase*>(sender());
+    if (watcher->isCanceled()) return;
+
+    std::stable_sort(state_matches_.begin(), state_matches_.end(),
+        [](const StateModel* a, const StateModel* b) { return a->start < b->start; });
+    std::stable_sort(event_matches_.begin(), event_matches_.end(),
+        [](const EventModel* a, const EventModel* b) { return a->time < b->time; });
+
+    matched_ = true;
+    emit stateChanged();
+}
+
 void FindQueryTab::updateChecker()
 {
     Q_ASSERT(model_ != 0);
@@ -367,38 +596,24 @@ void FindQueryTab::updateChecker()
         active_checker = checkers[checker_no].get();
         reset();
     }
-    active_checker->setModel(model_);
 
-    // Check events necessary for checker
+    // Check types necessary for checker
 
-    bool checker_events_enabled = true;
-    const Selection & events = model_->events();
+    const Selection & types = active_checker->pattern().matchesStates()
+        ? model_->getStates() : model_->getEvents();
 
-    // Process checker's events
-    set<int> checker_events = active_checker->events();
-    for (set<int>::iterator it = checker_events.begin();
-        (it != checker_events.end()) && checker_events_enabled; it++)
+    bool checker_types_enabled = active_checker->isReady();
+    foreach (int link, active_checker->types())
     {
-        int eventLink = events.itemLink(*it);
-        if (!events.isEnabled(eventLink))
-            { checker_events_enabled = false; break; }
-
-        // Process checker's subevents
-        set<int> checker_subevents = active_checker->subevents(*it);
-        for (set<int>::iterator it2 = checker_subevents.begin();
-            it2 != checker_subevents.end(); it2++)
-        {
-            if (events.itemsCount(eventLink) >= *it2) continue;
-            if (!events.isEnabled(*it2, eventLink))
-                { checker_events_enabled = false; break; }
-        }
+        if (link >= types.size() || !types.isEnabled(link))
+            { checker_types_enabled = false; break; }
     }
 
     // Activate widget for current checker
-    if (checker_events_enabled)
+    if (checker_types_enabled || !active_checker->isReady())
         checkerWidgetContainer->setCurrentIndex(checker_no+1);
     else
-        // Some necessary events filtered,
+        // Some necessary types filtered,
         // so we must tell user about it.
         checkerWidgetContainer->setCurrentIndex(0);
 
@@ -406,37 +621,25 @@ void FindQueryTab::updateChecker()
     for (int i = 0; i < checkerSettings_layout->count(); ++i)
     {
         checkerSettings_layout->itemAt(i)->widget()->
-            setVisible(checker_events_enabled);
+            setVisible(checkerWidgetContainer->currentIndex() != 0);
     }
 
     // Disable "Find" button if checker haven't correct settings.
-    active_checker_is_ready = checker_events_enabled && active_checker->isReady();
-}
+    active_checker_is_ready = checker_types_enabled;
 
-void FindQueryTab::activateCheckerEvents()
-{
-    Selection events = model_->events();
-
-    // Process checker's events
-    set<int> checker_events = active_checker->events();
-    for (set<int>::iterator it = checker_events.begin();
-        it != checker_events.end(); it++)
+    if (active_checker_is_ready)
     {
-        int eventLink = events.itemLink(*it);
-        events.setEnabled(eventLink, true);
-
-        // Process checker's subevents
-        set<int> checker_subevents = active_checker->subevents(*it);
-        for (set<int>::iterator it2 = checker_subevents.begin();
-            it2 != checker_subevents.end(); it2++)
-        {
-            if (events.itemsCount(eventLink) > *it2)
-                events.setEnabled(*it2, eventLink, true);
-        }
+        startMatching();
     }
+}
 
+void FindQueryTab::activateCheckerTypes()
+{
     Canvas * canvas = find_tool_->getCanvas();
-    canvas->setModel(canvas->getModel()->filter_events(events));
+    if (active_checker->pattern().matchesStates())
+        canvas->setModel(canvas->getModel()->filterStates(checkerTypes()));
+    else
+        canvas->setModel(canvas->getModel()->filterEvents(checkerTypes()));
 }
 
 void FindQueryTab::checkerStateChanged()
@@ -3,11 +3,14 @@
 
 #include <QtWidgets/QWidget>
 #include <QSettings>
+#include <QFutureWatcher>
 
 #include <boost/shared_ptr.hpp>
 
 #include "tool.h"
 #include "selection_widget.h"
+#include "time_vis.h"
+#include "checker.h"
 
 class QComboBox;
 class QStackedLayout;
@@ -17,29 +20,61 @@ namespace vis4 {
 class TraceModel;
 class EventModel;
 class StateModel;
-
-/** Base class for find tabs. */
+class FindResultsModel;
+
+/**
+ * Base class for find tabs.
+ *
+ * Matches of a tab are numbered in time order over the whole trace,
+ * so the tab only keeps the number of the current match. Search
+ * starts from the beginning of the model's time range.
+ */
 class FindTab : public QWidget {
     Q_OBJECT
 public: /** methods */
 
     FindTab(Tool* find_tool) :
         QWidget(find_tool),
-        find_tool_(find_tool)
+        find_tool_(find_tool),
+        current_(-1)
     {}
 
     virtual QString name() = 0;
     virtual void reset() = 0;
-    virtual bool findNext() = 0;
     virtual void setModel(TraceModelPtr &) = 0;
     virtual bool isSearchAllowed() = 0;
     virtual void saveState(QSettings & settings) = 0;
     virtual void restoreState(QSettings & settings) = 0;
 
+    /** Shows the match after the current one. */
+    bool findNext();
+    /** Shows the match before the current one. */
+    bool findPrevious();
+    /** Shows the match with given number, counting from zero. */
+    bool findMatch(int n);
+
+    /** Returns the number of matches. */
+    int matchCount();
+    /** Returns the number of current match, or -1. */
+    int currentMatch() const;
+
+    /** Starts search of all matches into 'results'. */
+    virtual void findAll(FindResultsModel* results) = 0;
+
 signals:
     void stateChanged();
+
+protected: /** methods */
+    virtual int occurrences() = 0;
+    virtual int occurrencesBefore(const Time& time) = 0;
+    /** Emits the signal for the match with given number. */
+    virtual void showOccurrence(int n) = 0;
+    /** Returns the time search starts from. */
+    virtual Time startTime() = 0;
+
 protected:
     Tool* find_tool_;
+    int current_;
 };
 
 /** Class for events find tab. */
@@ -55,13 +90,20 @@ public: /** methods */
     }
 
     void reset();
-    bool findNext();
+    void findAll(FindResultsModel* results);
     void setModel(TraceModelPtr& model);
     bool isSearchAllowed();
     void saveState(QSettings& settings);
     void restoreState(QSettings& settings);
 signals:
     void showEvent(EventModel*);
+protected: /** methods */
+    int occurrences();
+    int occurrencesBefore(const Time& time);
+    void showOccurrence(int n);
+    Time startTime();
+private: /** methods */
+    void ensureFiltered();
 private slots:
     void selectionChanged(const vis4::Selection& selection);
 private: /** widgets */
@@ -82,13 +124,20 @@ public: /* methods */
     }
 
     void reset();
-    bool findNext();
+    void findAll(FindResultsModel* results);
     void setModel(TraceModelPtr& model);
     bool isSearchAllowed();
     void saveState(QSettings& settings);
     void restoreState(QSettings& settings);
 signals:
     void showState(StateModel*);
+protected: /** methods */
+    int occurrences();
+    int occurrencesBefore(const Time& time);
+    void showOccurrence(int n);
+    Time startTime();
+private: /** methods */
+    void ensureFiltered();
 private slots:
     void selectionChanged(const vis4::Selection & selection);
 private: /** widgets */
@@ -102,6 +151,7 @@ class FindQueryTab : public FindTab {
     Q_OBJECT
 public: /** methods */
     FindQueryTab(Tool* find_tool);
+    ~FindQueryTab();
 
     QString name()
     {
@@ -109,28 +159,59 @@ public: /** methods */
     }
 
     void reset();
-    bool findNext();
+    void findAll(FindResultsModel* results);
     void setModel(TraceModelPtr & model);
     bool isSearchAllowed();
     void saveState(QSettings & settings);
     void restoreState(QSettings & settings);
-private: /** methods */
-    /** Creates checkers and ininialize event/subevent lists. */
-    void initializeCheckers();
 signals:
     void showEvent(EventModel*);
+    void showState(StateModel*);
+protected: /** methods */
+    int occurrences();
+    int occurrencesBefore(const Time& time);
+    void showOccurrence(int n);
+    Time startTime();
+private: /** methods */
+    /** Creates checkers and their widgets. */
+    void initializeCheckers();
+    /** Returns types enabled in the model, with types of the active checker enabled. */
+    Selection checkerTypes() const;
+    /** Model with only types of the active checker enabled. */
+    void ensureFiltered();
+    /** Starts the pattern in the background, unless matches are
+        ready or being collected. */
+    void startMatching();
+    /** Cancels matching and drops the parts collected so far. */
+    void cancelMatching();
 private slots:
     void updateChecker();
-    void activateCheckerEvents();
+    void activateCheckerTypes();
     void checkerStateChanged();
+    void statesMatched(int begin, int end);
+    void eventsMatched(int begin, int end);
+    /** Orders the collected matches by time and enables search. */
+    void matchingFinished();
 private: /** widgets */
     TraceModelPtr model_;
-    TraceModelPtr model_with_checker;
+    TraceModelPtr filtered_model_;
+
+    QList<pChecker> checkers;
+    Checker* active_checker;
+    bool active_checker_is_ready;
+
+    /** Matches are collected and ordered. Search is allowed
+        only then, as numbers of matches are not known before. */
+    bool matched_;
+    QVector<EventModel*> event_matches_;
+    QVector<StateModel*> state_matches_;
+
+    QFutureWatcher<QVector<StateModel*>> stateWatcher_;
+    QFutureWatcher<QVector<EventModel*>> eventWatcher_;
 
     QComboBox* checkerCombo;
     QStackedLayout* checkerWidgetContainer;
     QLayout* checkerSettings_layout;
-
 };
 
 }
@@ -0,0 +1,168 @@
+#include "flame_graph.h"
+#include "time_vis.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QHelpEvent>
+#include <QtWidgets/QToolTip>
+
+namespace vis4 {
+
+namespace {
+
+const int row_margin = 2;
+
+/** Color of the state type, stable between trees. */
+QColor typeColor(int type)
+{
+    if (type < 0) return QColor(Qt::lightGray);
+    return QColor::fromHsv((type * 137) % 360, 110, 240);
+}
+
+}
+
+FlameGraph::FlameGraph(QWidget* parent) :
+    QWidget(parent),
+    focus_(CallTree::root())
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+}
+
+void FlameGraph::setTree(const CallTree& tree, const QStringList& names)
+{
+    tree_ = tree;
+    names_ = names;
+    focus_ = CallTree::root();
+    drawn_.clear();
+
+    setMinimumHeight((tree_.depth() + 1) * (fontMetrics().height() + row_margin));
+    updateGeometry();
+    update();
+}
+
+QSize FlameGraph::sizeHint() const
+{
+    return QSize(300, (tree_.depth() + 1) * (fontMetrics().height() + row_margin));
+}
+
+bool FlameGraph::event(QEvent* event)
+{
+    if (event->type() == QEvent::ToolTip)
+    {
+        QHelpEvent* help = static_cast<QHelpEvent*>(event);
+        int node = nodeAt(help->pos());
+        if (node != -1)
+        {
+            const CallTree::Node& n = tree_.node(node);
+            quint64 total = tree_.node(CallTree::root()).inclusive;
+            QToolTip::showText(help->globalPos(),
+                               tr("<b>%1</b><br>%2 calls<br>inclusive %3 (%4%)<br>exclusive %5")
+                               .arg(nodeName(node).toHtmlEscaped())
+                               .arg(n.calls)
+                               .arg(Time(n.inclusive).toString(true))
+                               .arg(total ? 100.0 * n.inclusive / total : 0, 0, 'f', 1)
+                               .arg(Time(n.exclusive).toString(true)));
+        }
+        else
+        {
+            QToolTip::hideText();
+        }
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+void FlameGraph::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+    drawn_.clear();
+
+    if (tree_.isEmpty())
+    {
+        painter.drawText(rect(), Qt::AlignCenter, tr("No states"));
+        return;
+    }
+
+    // Ancestors of the focused node span the whole width below it.
+    QVector<int> path;
+    for (int node = tree_.node(focus_).parent; node != -1; node = tree_.node(node).parent)
+    {
+        path.prepend(node);
+    }
+    for (int row = 0; row < path.size(); ++row)
+    {
+        drawNode(painter, path[row], 0, width(), row);
+    }
+
+    drawNode(painter, focus_, 0, width(), path.size());
+}
+
+void FlameGraph::drawNode(QPainter& painter, int node, double x, double width, int row)
+{
+    const CallTree::Node& n = tree_.node(node);
+    int rowHeight = fontMetrics().height() + row_margin;
+    QRectF r(x, height() - (row + 1) * rowHeight, width, rowHeight - 1);
+
+    painter.fillRect(r, typeColor(n.type));
+    if (width > fontMetrics().averageCharWidth() * 3)
+    {
+        QRectF text = r.adjusted(row_margin, 0, -row_margin, 0);
+        painter.drawText(text, Qt::AlignLeft | Qt::AlignVCenter,
+                         fontMetrics().elidedText(nodeName(node), Qt::ElideRight, int(text.width())));
+    }
+    drawn_ << qMakePair(r, node);
+
+    // Ancestors of the focus are drawn without their children.
+    if (row < tree_.node(focus_).depth || !n.inclusive)
+    {
+        return;
+    }
+
+    double childX = x;
+    foreach (int c, n.children)
+    {
+        double childWidth = width * tree_.node(c).inclusive / n.inclusive;
+        if (childWidth >= 1)
+        {
+            drawNode(painter, c, childX, childWidth, row + 1);
+        }
+        childX += childWidth;
+    }
+}
+
+void FlameGraph::mousePressEvent(QMouseEvent* event)
+{
+    int node = nodeAt(event->pos());
+    if (node == -1 || event->button() != Qt::LeftButton)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    focus_ = node;
+    update();
+}
+
+QString FlameGraph::nodeName(int node) const
+{
+    const CallTree::Node& n = tree_.node(node);
+    if (n.type < 0)
+    {
+        return tr("All, %1").arg(Time(n.inclusive).toString(true));
+    }
+    return names_.value(n.type, QString::number(n.type));
+}
+
+int FlameGraph::nodeAt(const QPoint& pos) const
+{
+    for (int i = 0; i < drawn_.size(); ++i)
+    {
+        if (drawn_[i].first.contains(pos))
+        {
+            return drawn_[i].second;
+        }
+    }
+    return -1;
+}
+
+}
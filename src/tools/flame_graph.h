@@ -0,0 +1,53 @@
+#ifndef FLAME_GRAPH_H
+#define FLAME_GRAPH_H
+
+#include <QtWidgets/QWidget>
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+
+#include "call_tree.h"
+
+namespace vis4 {
+
+/**
+ * Flame graph of a call tree: the root at the bottom, every node above
+ * its parent, with width proportional to inclusive time. Clicking a
+ * node makes it span the whole width, clicking one of the nodes below
+ * it zooms out. Nodes narrower than a pixel are not drawn.
+ */
+class FlameGraph : public QWidget
+{
+    Q_OBJECT
+public:
+    FlameGraph(QWidget* parent = nullptr);
+
+    /** Shows the tree, with names of state types for labels. */
+    void setTree(const CallTree& tree, const QStringList& names);
+
+    QSize sizeHint() const;
+
+protected:
+    bool event(QEvent* event);
+    void paintEvent(QPaintEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+
+private:
+    void drawNode(QPainter& painter, int node, double x, double width, int row);
+    QString nodeName(int node) const;
+
+    /** Returns node under the point, or -1. */
+    int nodeAt(const QPoint& pos) const;
+
+private:
+    CallTree tree_;
+    QStringList names_;
+    /** Node spanning the whole width. */
+    int focus_;
+    /** Drawn nodes with their rectangles, for clicks and tooltips. */
+    QVector<QPair<QRectF, int>> drawn_;
+};
+
+}
+
+#endif
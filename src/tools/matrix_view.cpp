@@ -0,0 +1,192 @@
+#include "matrix_view.h"
+
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QHelpEvent>
+#include <QtWidgets/QToolTip>
+
+#include <cmath>
+
+namespace vis4 {
+
+namespace {
+
+const int min_cell_size = 1;
+const int max_cell_size = 32;
+
+/** Initial size of the heatmap, in pixels. */
+const int fit_size = 256;
+
+QRgb blend(const QColor& from, const QColor& to, double share)
+{
+    return qRgb(from.red() + int((to.red() - from.red()) * share),
+                from.green() + int((to.green() - from.green()) * share),
+                from.blue() + int((to.blue() - from.blue()) * share));
+}
+
+}
+
+MatrixView::MatrixView(QWidget* parent) :
+    QWidget(parent),
+    value_(CountValue),
+    cellSize_(min_cell_size)
+{
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+}
+
+void MatrixView::setMatrix(const CommunicationMatrix& matrix, const QStringList& labels)
+{
+    // Zoom is kept while the number of lifelines is the same.
+    if (matrix.size() != matrix_.size())
+    {
+        cellSize_ = qBound(min_cell_size, fit_size / qMax(matrix.size(), 1), max_cell_size);
+    }
+
+    matrix_ = matrix;
+    labels_ = labels;
+    updateImage();
+}
+
+void MatrixView::setValue(Value value)
+{
+    value_ = value;
+    updateImage();
+}
+
+QSize MatrixView::sizeHint() const
+{
+    return QSize(matrix_.size() * cellSize_, matrix_.size() * cellSize_);
+}
+
+bool MatrixView::event(QEvent* event)
+{
+    if (event->type() == QEvent::ToolTip)
+    {
+        QHelpEvent* help = static_cast<QHelpEvent*>(event);
+        QPoint cell = cellAt(help->pos());
+        if (cell.x() != -1)
+        {
+            QToolTip::showText(help->globalPos(),
+                               tr("%1 to %2<br>%3 messages, %4 bytes")
+                               .arg(labels_.value(cell.y()).toHtmlEscaped())
+                               .arg(labels_.value(cell.x()).toHtmlEscaped())
+                               .arg(matrix_.count(cell.y(), cell.x()))
+                               .arg(matrix_.bytes(cell.y(), cell.x())));
+        }
+        else
+        {
+            QToolTip::hideText();
+        }
+        return true;
+    }
+    return QWidget::event(event);
+}
+
+void MatrixView::paintEvent(QPaintEvent*)
+{
+    QPainter painter(this);
+
+    if (image_.isNull())
+    {
+        return;
+    }
+
+    // Cells are scaled without smoothing, so they stay sharp.
+    painter.drawImage(QRect(QPoint(0, 0), sizeHint()), image_);
+}
+
+void MatrixView::mousePressEvent(QMouseEvent* event)
+{
+    QPoint cell = cellAt(event->pos());
+    if (cell.x() == -1 || event->button() != Qt::LeftButton)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    emit cellClicked(cell.y(), cell.x());
+}
+
+void MatrixView::wheelEvent(QWheelEvent* event)
+{
+    if (!(event->modifiers() & Qt::ControlModifier))
+    {
+        // Without Control, the wheel scrolls the view.
+        event->ignore();
+        return;
+    }
+
+    int size = event->angleDelta().y() > 0 ? cellSize_ * 2 : cellSize_ / 2;
+    size = qBound(min_cell_size, size, max_cell_size);
+    if (size != cellSize_)
+    {
+        cellSize_ = size;
+        resize(sizeHint());
+        update();
+    }
+    event->accept();
+}
+
+void MatrixView::updateImage()
+{
+    int size = matrix_.size();
+    if (!size)
+    {
+        image_ = QImage();
+        resize(sizeHint());
+        update();
+        return;
+    }
+
+    // The image is null if it doesn't fit in memory, then nothing is drawn.
+    image_ = QImage(size, size, QImage::Format_RGB32);
+    if (image_.isNull())
+    {
+        resize(sizeHint());
+        update();
+        return;
+    }
+
+    QColor empty = palette().color(QPalette::Base);
+    QColor low = palette().color(QPalette::Midlight);
+    QColor high = palette().color(QPalette::Highlight);
+    quint64 max = (value_ == CountValue) ? matrix_.maxCount() : matrix_.maxBytes();
+    double scale = std::log1p(double(max));
+
+    // Only cells with messages are stored and painted.
+    image_.fill(empty);
+    for (int sender = 0; sender < size; ++sender)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image_.scanLine(sender));
+        const QHash<int, CommunicationMatrix::Cell>& row = matrix_.row(sender);
+        for (auto it = row.constBegin(); it != row.constEnd(); ++it)
+        {
+            quint64 value = (value_ == CountValue) ? it->count : it->bytes;
+            line[it.key()] = value ? blend(low, high, std::log1p(double(value)) / scale)
+                                   : empty.rgb();
+        }
+    }
+
+    resize(sizeHint());
+    update();
+}
+
+QPoint MatrixView::cellAt(const QPoint& pos) const
+{
+    int size = matrix_.size();
+    if (!size || pos.x() < 0 || pos.y() < 0)
+    {
+        return QPoint(-1, -1);
+    }
+
+    int receiver = pos.x() / cellSize_;
+    int sender = pos.y() / cellSize_;
+    if (receiver >= size || sender >= size)
+    {
+        return QPoint(-1, -1);
+    }
+    return QPoint(receiver, sender);
+}
+
+}
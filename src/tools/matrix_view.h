@@ -0,0 +1,59 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <QtWidgets/QWidget>
+#include <QImage>
+#include <QStringList>
+
+#include "communication_matrix.h"
+
+namespace vis4 {
+
+/**
+ * Heatmap of a communication matrix, senders by rows and receivers
+ * by columns. Colors are on the logarithmic scale of either number
+ * or size of messages. The heatmap is rendered to an image with one
+ * pixel per cell, which is scaled when drawn, so zooming with the
+ * mouse wheel doesn't touch the matrix.
+ */
+class MatrixView : public QWidget
+{
+    Q_OBJECT
+public:
+    enum Value { CountValue, BytesValue };
+
+    MatrixView(QWidget* parent = nullptr);
+
+    /** Shows the matrix, with names of rows for tooltips. */
+    void setMatrix(const CommunicationMatrix& matrix, const QStringList& labels);
+    void setValue(Value value);
+
+    QSize sizeHint() const;
+
+signals:
+    /** Emitted when a cell is clicked. */
+    void cellClicked(int sender, int receiver);
+
+protected:
+    bool event(QEvent* event);
+    void paintEvent(QPaintEvent* event);
+    void mousePressEvent(QMouseEvent* event);
+    void wheelEvent(QWheelEvent* event);
+
+private:
+    void updateImage();
+
+    /** Returns cell under the point as (receiver, sender), or (-1, -1). */
+    QPoint cellAt(const QPoint& pos) const;
+
+private:
+    CommunicationMatrix matrix_;
+    QStringList labels_;
+    Value value_;
+    QImage image_;
+    int cellSize_;
+};
+
+}
+
+#endif
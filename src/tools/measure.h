@@ -13,6 +13,8 @@
 #include <QPainter>
 #include <QtWidgets/QAction>
 
+#include <algorithm>
+
 namespace vis4 {
 
 class MeasureRibbon : public CanvasItem
@@ -273,7 +275,10 @@ public:
                      "<p>If you clear near event, the point is automatically "
                      "snapped to the event. If there are several events near, "
                      "you will see a listbox with all events and will be able "
-                     "to select one event to snap to."));
+                     "to select one event to snap to."
+                     "<p>Statistics show time in states, number of events "
+                     "and messages between the points, on lifelines from "
+                     "point A to point B."));
 
 
 
@@ -296,8 +301,18 @@ public:
         distanceLabel = new QLabel("", distanceGroup);
         distanceLayout->addWidget(distanceLabel);
 
-        connect(getCanvas(), SIGNAL(modelChanged(TraceModel::TraceModelPtr&)), this,
-                             SLOT(modelChanged(TraceModel::TraceModelPtr&)));
+        QGroupBox* statisticsGroup = new QGroupBox(tr("Statistics"), this);
+        statisticsGroup->setSizePolicy(QSizePolicy::Expanding,
+                                       QSizePolicy::Maximum);
+        mainLayout->addWidget(statisticsGroup);
+
+        QVBoxLayout* statisticsLayout = new QVBoxLayout(statisticsGroup);
+        statisticsLabel = new QLabel("", statisticsGroup);
+        statisticsLabel->setWordWrap(true);
+        statisticsLayout->addWidget(statisticsLabel);
+
+        connect(getCanvas(), SIGNAL(modelChanged(TraceModelPtr&)), this,
+                             SLOT(modelChanged(TraceModelPtr&)));
 
         connect(pointA, SIGNAL(eventSelected(const Time&)), this,
                         SLOT(eventSelected(const Time&)));
@@ -352,6 +367,63 @@ private:
 
         Time d = distance(time_a, time_b);
         distanceLabel->setText(tr("Distance: %1").arg(d.toString(true)));
+
+        if (point_a_fixed && point_b_fixed)
+            updateStatistics(component_b, time_b);
+        else
+            statisticsLabel->clear();
+    }
+
+    /* Shows statistics between point A and the given point,
+       on lifelines from A to the point.  */
+    void updateStatistics(int lifeline_b, const Time& time)
+    {
+        const QList<int>& visible = model()->getVisibleComponents();
+        int first = qMin(component_a, lifeline_b);
+        int last = qMax(component_a, lifeline_b);
+        if (first < 0 || last >= visible.size())
+        {
+            statisticsLabel->clear();
+            return;
+        }
+
+        Time begin = qMin(time_a, time), end = qMax(time_a, time);
+        RangeStatistics stats = model()->rangeStatistics(
+            visible.mid(first, last - first + 1), begin, end);
+
+        QString text = "<table>";
+        text += tr("<tr><td>Messages sent:</td><td>%1</td></tr>").arg(stats.messagesSent);
+        text += tr("<tr><td>Messages received:</td><td>%1</td></tr>").arg(stats.messagesReceived);
+
+        // Longest states first.
+        QList<QPair<Time, int>> states;
+        for (auto it = stats.stateTime.constBegin(); it != stats.stateTime.constEnd(); ++it)
+            states << qMakePair(it.value(), it.key());
+        std::sort(states.begin(), states.end(),
+                  [](const QPair<Time, int>& a, const QPair<Time, int>& b) { return b.first < a.first; });
+
+        if (!states.isEmpty())
+            text += "<tr><td colspan=2><b>" + tr("Time in states") + "</b></td></tr>";
+        for (int i = 0; i < states.size() && i < max_statistics_rows; ++i)
+        {
+            text += QString("<tr><td>%1</td><td>%2</td></tr>")
+                .arg(model()->getStates().item(states[i].second).toHtmlEscaped())
+                .arg(states[i].first.toString(true));
+        }
+
+        if (!stats.eventCount.isEmpty())
+            text += "<tr><td colspan=2><b>" + tr("Events") + "</b></td></tr>";
+        int rows = 0;
+        for (auto it = stats.eventCount.constBegin();
+             it != stats.eventCount.constEnd() && rows < max_statistics_rows; ++it, ++rows)
+        {
+            text += QString("<tr><td>%1</td><td>%2</td></tr>")
+                .arg(model()->getEvents().item(it.key()).toHtmlEscaped())
+                .arg(it.value());
+        }
+
+        text += "</table>";
+        statisticsLabel->setText(text);
     }
 
 private slots:
@@ -430,6 +502,9 @@ private slots:
         {
             component_b = nearest_lifeline;
             ribbon->setB(p);
+
+            // Statistics follow the ribbon.
+            updateStatistics(component_b, time);
         }
 
 	return false;
@@ -484,6 +559,10 @@ private:
     Measure_point_display* pointA;
     Measure_point_display* pointB;
     QLabel* distanceLabel;
+    QLabel* statisticsLabel;
+
+    /** Maximum number of state or event types in statistics. */
+    static const int max_statistics_rows = 10;
 
     bool point_a_fixed;
     bool point_b_fixed;
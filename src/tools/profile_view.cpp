@@ -0,0 +1,331 @@
+#include "profile_view.h"
+
+#include <QColor>
+
+#include <algorithm>
+
+namespace vis4 {
+
+namespace {
+
+/** Time change with its sign. */
+QString timeChange(qint64 change)
+{
+    QString sign = change < 0 ? "-" : (change > 0 ? "+" : "");
+    return sign + Time(quint64(qAbs(change))).toString(true);
+}
+
+}
+
+ProfileModel::ProfileModel(QObject* parent) :
+    QAbstractTableModel(parent),
+    sortColumn_(ExclusiveColumn),
+    sortOrder_(Qt::DescendingOrder)
+{}
+
+void ProfileModel::setRegions(const TraceModelPtr& model, const QVector<RegionProfile>& regions)
+{
+    beginResetModel();
+    model_ = model;
+    rows_.clear();
+    for (int type = 0; type < regions.size(); ++type)
+    {
+        if (regions[type].calls)
+        {
+            Row row = { type, regions[type] };
+            rows_ << row;
+        }
+    }
+    endResetModel();
+
+    sort(sortColumn_, sortOrder_);
+}
+
+void ProfileModel::updateTime()
+{
+    if (!rows_.isEmpty())
+    {
+        emit dataChanged(index(0, InclusiveColumn), index(rows_.size() - 1, MaxColumn));
+    }
+}
+
+int ProfileModel::type(int row) const
+{
+    return rows_[row].type;
+}
+
+int ProfileModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows_.size();
+}
+
+int ProfileModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProfileModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+    {
+        return QVariant();
+    }
+
+    if (role == Qt::TextAlignmentRole && index.column() != RegionColumn)
+    {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    const Row& row = rows_[index.row()];
+
+    switch (index.column())
+    {
+        case RegionColumn:
+            return model_->getStates().item(row.type);
+
+        case CallsColumn:
+            return row.region.calls;
+
+        case InclusiveColumn:
+            return Time(row.region.inclusive).toString(true);
+
+        case ExclusiveColumn:
+            return Time(row.region.exclusive).toString(true);
+
+        case MinColumn:
+            return Time(row.region.min).toString(true);
+
+        case MeanColumn:
+            return Time(row.region.mean()).toString(true);
+
+        case MaxColumn:
+            return Time(row.region.max).toString(true);
+    }
+
+    return QVariant();
+}
+
+QVariant ProfileModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    switch (section)
+    {
+        case RegionColumn:    return tr("Region");
+        case CallsColumn:     return tr("Calls");
+        case InclusiveColumn: return tr("Inclusive");
+        case ExclusiveColumn: return tr("Exclusive");
+        case MinColumn:       return tr("Min");
+        case MeanColumn:      return tr("Mean");
+        case MaxColumn:       return tr("Max");
+    }
+
+    return QVariant();
+}
+
+void ProfileModel::sort(int column, Qt::SortOrder order)
+{
+    sortColumn_ = column;
+    sortOrder_ = order;
+
+    emit layoutAboutToBeChanged();
+    if (column == RegionColumn)
+    {
+        std::stable_sort(rows_.begin(), rows_.end(), [this](const Row& a, const Row& b)
+        {
+            return model_->getStates().item(a.type) < model_->getStates().item(b.type);
+        });
+    }
+    else
+    {
+        std::stable_sort(rows_.begin(), rows_.end(), [this, column](const Row& a, const Row& b)
+        {
+            return sortKey(a, column) < sortKey(b, column);
+        });
+    }
+    if (order == Qt::DescendingOrder)
+    {
+        std::reverse(rows_.begin(), rows_.end());
+    }
+    emit layoutChanged();
+}
+
+quint64 ProfileModel::sortKey(const Row& row, int column) const
+{
+    switch (column)
+    {
+        case CallsColumn:     return row.region.calls;
+        case InclusiveColumn: return row.region.inclusive;
+        case ExclusiveColumn: return row.region.exclusive;
+        case MinColumn:       return row.region.min;
+        case MeanColumn:      return row.region.mean();
+        case MaxColumn:       return row.region.max;
+    }
+    return 0;
+}
+
+ProfileDiffModel::ProfileDiffModel(QObject* parent) :
+    QAbstractTableModel(parent),
+    sortColumn_(InclusiveChangeColumn),
+    sortOrder_(Qt::DescendingOrder)
+{}
+
+void ProfileDiffModel::setDiff(const ProfileDiff& diff)
+{
+    beginResetModel();
+    rows_ = diff.regions();
+    endResetModel();
+
+    sort(sortColumn_, sortOrder_);
+}
+
+void ProfileDiffModel::updateTime()
+{
+    if (!rows_.isEmpty())
+    {
+        emit dataChanged(index(0, InclusiveColumn), index(rows_.size() - 1, ExclusiveChangeColumn));
+    }
+}
+
+QString ProfileDiffModel::region(int row) const
+{
+    return rows_[row].name;
+}
+
+int ProfileDiffModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : rows_.size();
+}
+
+int ProfileDiffModel::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProfileDiffModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+    {
+        return QVariant();
+    }
+
+    const RegionDiff& row = rows_[index.row()];
+
+    if (role == Qt::TextAlignmentRole && index.column() != RegionColumn)
+    {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    if (role == Qt::ForegroundRole)
+    {
+        qint64 change = (index.column() == InclusiveChangeColumn) ? row.inclusiveDelta() :
+                        (index.column() == ExclusiveChangeColumn) ? row.exclusiveDelta() : 0;
+        if (change > 0) return QColor(Qt::darkRed);
+        if (change < 0) return QColor(Qt::darkGreen);
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    switch (index.column())
+    {
+        case RegionColumn:
+            return row.name;
+
+        case CallsColumn:
+            return row.second.calls;
+
+        case CallsChangeColumn:
+            return row.callsDelta() > 0 ? QString("+%1").arg(row.callsDelta())
+                                        : QString::number(row.callsDelta());
+
+        case InclusiveColumn:
+            return Time(row.second.inclusive).toString(true);
+
+        case InclusiveChangeColumn:
+            return timeChange(row.inclusiveDelta());
+
+        case ExclusiveColumn:
+            return Time(row.second.exclusive).toString(true);
+
+        case ExclusiveChangeColumn:
+            return timeChange(row.exclusiveDelta());
+    }
+
+    return QVariant();
+}
+
+QVariant ProfileDiffModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    {
+        return QVariant();
+    }
+
+    switch (section)
+    {
+        case RegionColumn:          return tr("Region");
+        case CallsColumn:           return tr("Calls");
+        case CallsChangeColumn:     return tr("Change");
+        case InclusiveColumn:       return tr("Inclusive");
+        case InclusiveChangeColumn: return tr("Change");
+        case ExclusiveColumn:       return tr("Exclusive");
+        case ExclusiveChangeColumn: return tr("Change");
+    }
+
+    return QVariant();
+}
+
+void ProfileDiffModel::sort(int column, Qt::SortOrder order)
+{
+    sortColumn_ = column;
+    sortOrder_ = order;
+
+    emit layoutAboutToBeChanged();
+    if (column == RegionColumn)
+    {
+        std::stable_sort(rows_.begin(), rows_.end(), [](const RegionDiff& a, const RegionDiff& b)
+        {
+            return a.name < b.name;
+        });
+    }
+    else
+    {
+        std::stable_sort(rows_.begin(), rows_.end(), [this, column](const RegionDiff& a, const RegionDiff& b)
+        {
+            return sortKey(a, column) < sortKey(b, column);
+        });
+    }
+    if (order == Qt::DescendingOrder)
+    {
+        std::reverse(rows_.begin(), rows_.end());
+    }
+    emit layoutChanged();
+}
+
+qint64 ProfileDiffModel::sortKey(const RegionDiff& row, int column) const
+{
+    switch (column)
+    {
+        case CallsColumn:           return row.second.calls;
+        case CallsChangeColumn:     return row.callsDelta();
+        case InclusiveColumn:       return row.second.inclusive;
+        case InclusiveChangeColumn: return row.inclusiveDelta();
+        case ExclusiveColumn:       return row.second.exclusive;
+        case ExclusiveChangeColumn: return row.exclusiveDelta();
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,121 @@
+#ifndef PROFILE_VIEW_H
+#define PROFILE_VIEW_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+#include "trace_model.h"
+#include "profile_diff.h"
+
+namespace vis4 {
+
+/**
+ * Table of regions of a flat profile, one row per state type
+ * with at least one call.
+ */
+class ProfileModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column
+    {
+        RegionColumn,
+        CallsColumn,
+        InclusiveColumn,
+        ExclusiveColumn,
+        MinColumn,
+        MeanColumn,
+        MaxColumn,
+        ColumnCount
+    };
+
+    ProfileModel(QObject* parent = nullptr);
+
+    /** Shows regions, by state type. Region names are taken from the model. */
+    void setRegions(const TraceModelPtr& model, const QVector<RegionProfile>& regions);
+
+    /** Reformats times, after change of time unit. */
+    void updateTime();
+
+    /** Returns state type of the row. */
+    int type(int row) const;
+
+public: /* overloaded item model methods */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+private:
+    struct Row
+    {
+        int type;
+        RegionProfile region;
+    };
+
+    /** Value of the column used for sorting. */
+    quint64 sortKey(const Row& row, int column) const;
+
+private:
+    TraceModelPtr model_;
+    QVector<Row> rows_;
+
+    int sortColumn_;
+    Qt::SortOrder sortOrder_;
+};
+
+/**
+ * Table of regions of two traces, with the values of the second
+ * trace and their changes from the first one. Growth of time is
+ * shown in red, so regressions stand out.
+ */
+class ProfileDiffModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum Column
+    {
+        RegionColumn,
+        CallsColumn,
+        CallsChangeColumn,
+        InclusiveColumn,
+        InclusiveChangeColumn,
+        ExclusiveColumn,
+        ExclusiveChangeColumn,
+        ColumnCount
+    };
+
+    ProfileDiffModel(QObject* parent = nullptr);
+
+    void setDiff(const ProfileDiff& diff);
+
+    /** Reformats times, after change of time unit. */
+    void updateTime();
+
+    /** Returns region name of the row. */
+    QString region(int row) const;
+
+public: /* overloaded item model methods */
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+private:
+    /** Value of the column used for sorting. */
+    qint64 sortKey(const RegionDiff& row, int column) const;
+
+private:
+    QVector<RegionDiff> rows_;
+
+    int sortColumn_;
+    Qt::SortOrder sortOrder_;
+};
+
+}
+
+#endif
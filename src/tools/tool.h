@@ -150,6 +150,9 @@ Tool* createGoto(QWidget* parent, Canvas* canvas);
 Tool* createMeasure(QWidget* parent, Canvas* canvas);
 Tool* createFilter(QWidget* parent, Canvas* canvas);
 Tool* createFind(QWidget* parent, Canvas* canvas);
+Tool* createCommunication(QWidget* parent, Canvas* canvas);
+Tool* createCallTree(QWidget* parent, Canvas* canvas);
+Tool* createCompare(QWidget* parent, Canvas* canvas);
 
 }
 
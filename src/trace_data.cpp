@@ -1,23 +1,105 @@
 #include "trace_data.h"
 
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <functional>
+
 namespace vis4 {
 
-TraceData::TraceData() {}
+namespace {
+
+Profile loadProfile(const QVector<StateModel*>* states, int types, quint64 traceEnd,
+                    const QString& traceFile)
+{
+    QString profileFile = traceFile + ".profile";
+
+    Profile profile;
+    QFileInfo trace(traceFile), saved(profileFile);
+    if (saved.exists() && saved.lastModified() >= trace.lastModified() &&
+        profile.load(profileFile, states->size()))
+    {
+        return profile;
+    }
+
+    profile = Profile::compute(*states, types, traceEnd);
+    // The trace directory may be read-only, then profile is just not kept.
+    profile.save(profileFile, states->size());
+    return profile;
+}
+
+Clustering clusterComponents(const StatisticsIndex* statistics, QVector<int> components, int types,
+                             quint64 begin, quint64 end)
+{
+    return Clustering::compute(*statistics, components, types, begin, end);
+}
+
+}
+
+TraceData::TraceData() :
+    generation(0),
+    profileOutdated(false),
+    clusteringOutdated(false)
+{}
 
-TraceData::TraceData(Selection* componentsPtr, Selection* stateTypesPtr, Selection* eventTypesPtr, QVector<StateModel*>* states, QVector<EventModel*>* events, QVector<GroupModel*>* groups) :
+TraceData::TraceData(Selection* componentsPtr, Selection* stateTypesPtr, Selection* eventTypesPtr, QVector<StateModel*>* states, QVector<EventModel*>* events, const QVector<MessageModel>& messages, const CollectiveStore& collectives, const DurationSketches& durations) :
     componentsPtr(componentsPtr),
     stateTypesPtr(stateTypesPtr),
     eventTypesPtr(eventTypesPtr),
     states(states),
     events(events),
-    groups(groups),
-    currentState(0),
-    currentEvent(0),
-    currentGroup(0)
+    collectives(collectives),
+    generation(0),
+    profileOutdated(false),
+    clusteringOutdated(false)
 {
-    groups = new QVector<GroupModel*>();//should be arg
-    start = (*events)[0]->time;
-    end = (*events)[events->size() - 1]->time;
+    // A followed trace may have no complete event yet, then the
+    // range is extended by append().
+    start = Time(0);
+    end = Time(0);
+    if (!events->isEmpty())
+    {
+        start = events->first()->time;
+        end = events->last()->time;
+    }
+
+    statesByType.resize(stateTypesPtr->size());
+    for (int i = 0; i < states->size(); ++i)
+    {
+        int type = (*states)[i]->type;
+        if (type >= statesByType.size())
+        {
+            statesByType.resize(type + 1);
+        }
+        statesByType[type].push_back(i);
+    }
+
+    maxDepths.fill(0, componentsPtr->size());
+    computeDepths(0);
+    indexComponentStates(0);
+
+    eventsByType.resize(eventTypesPtr->size());
+    for (int i = 0; i < events->size(); ++i)
+    {
+        int type = (*events)[i]->type;
+        if (type >= eventsByType.size())
+        {
+            eventsByType.resize(type + 1);
+        }
+        eventsByType[type].push_back(i);
+    }
+
+    stateOccurrences.build(states, &StateModel::start, statesByType);
+    eventOccurrences.build(events, &EventModel::time, eventsByType);
+    this->messages.build(messages);
+    statistics.build(*states, statesByType, this->messages, end.toULL());
+    statistics.buildHierarchy(*componentsPtr);
+    stateDurations = durations.merge(statesByType.size());
+
+    startClustering();
 
     std::cout << "TraceData constructor:" << std::endl;
     std::cout << start.toULL() << " : " << end.toULL() << std::endl;
@@ -26,8 +108,163 @@ TraceData::TraceData(Selection* componentsPtr, Selection* stateTypesPtr, Selecti
     std::cout << componentsPtr->size() << " components" << std::endl;
 }
 
+void TraceData::computeDepths(int from)
+{
+    // States of a component are stored in order of start, so the
+    // enclosing states are the ones not yet ended. States left open
+    // at the end of the trace enclose all later ones.
+    for (int i = from; i < states->size(); ++i)
+    {
+        StateModel* s = (*states)[i];
+        QVector<quint64>& ends = openStates[s->component];
+        while (!ends.isEmpty() && ends.last() <= s->start.toULL())
+        {
+            ends.removeLast();
+        }
+
+        s->depth = ends.size();
+        if (s->component < unsigned(maxDepths.size()))
+        {
+            maxDepths[s->component] = qMax(maxDepths[s->component], s->depth);
+        }
+        ends << (s->end == Time(0) ? ~quint64(0) : s->end.toULL());
+    }
+}
+
+void TraceData::indexComponentStates(int from)
+{
+    auto intervalEnd = [](const StateModel* s)
+    {
+        return (s->end == Time(0)) ? ~quint64(0) : s->end.toULL();
+    };
+
+    // States of a component are usually stored in order of start and
+    // are appended to its index. The index of a component with a state
+    // stored out of this order is built again.
+    QSet<int> unordered;
+    for (int i = from; i < states->size(); ++i)
+    {
+        const StateModel* s = (*states)[i];
+        int component = int(s->component);
+        QVector<int>& list = statesByComponent[component];
+        if (!list.isEmpty() && (*states)[list.last()]->start > s->start)
+        {
+            unordered << component;
+        }
+        list << i;
+        if (!unordered.contains(component))
+        {
+            stateIntervals[component].append(s->start.toULL(), intervalEnd(s));
+        }
+    }
+
+    foreach (int component, unordered)
+    {
+        QVector<int>& list = statesByComponent[component];
+        std::stable_sort(list.begin(), list.end(),
+                         [this](int a, int b) { return (*states)[a]->start < (*states)[b]->start; });
+
+        QVector<quint64> begins, ends;
+        begins.reserve(list.size());
+        ends.reserve(list.size());
+        foreach (int position, list)
+        {
+            begins << (*states)[position]->start.toULL();
+            ends << intervalEnd((*states)[position]);
+        }
+        stateIntervals[component].build(begins, ends);
+    }
+}
+
+void TraceData::startClustering() const
+{
+    // Only components without children are clustered, groups of
+    // them are already shown by one lifeline.
+    QVector<int> leaves;
+    for (int component = 0; component < componentsPtr->size(); ++component)
+    {
+        if (!componentsPtr->hasChildren(component)) leaves << component;
+    }
+    clustering = QtConcurrent::run(clusterComponents, &statistics, leaves,
+                                   int(statesByType.size()), start.toULL(), end.toULL());
+}
+
+void TraceData::append(const QVector<StateModel*>& newStates, const QVector<EventModel*>& newEvents,
+                       const QVector<MessageModel>& newMessages)
+{
+    profile.waitForFinished();
+    clustering.waitForFinished();
+
+    ++generation;
+
+    int firstState = states->size();
+    int firstEvent = events->size();
+    if (firstEvent == 0 && !newEvents.isEmpty())
+    {
+        start = newEvents.first()->time;
+    }
+    *states += newStates;
+    *events += newEvents;
+
+    for (int i = firstState; i < states->size(); ++i)
+    {
+        const StateModel* s = (*states)[i];
+        if (s->type >= statesByType.size())
+        {
+            statesByType.resize(s->type + 1);
+        }
+        statesByType[s->type].push_back(i);
+        if (s->end != Time(0))
+        {
+            if (s->type >= stateDurations.size())
+            {
+                stateDurations.resize(s->type + 1);
+            }
+            stateDurations[s->type].add((s->end - s->start).toULL());
+            end = qMax(end, s->end);
+        }
+    }
+
+    for (int i = firstEvent; i < events->size(); ++i)
+    {
+        const EventModel* e = (*events)[i];
+        if (e->type >= eventsByType.size())
+        {
+            eventsByType.resize(e->type + 1);
+        }
+        eventsByType[e->type].push_back(i);
+        end = qMax(end, e->time);
+    }
+
+    foreach (const MessageModel& m, newMessages)
+    {
+        end = qMax(end, Time(qMax(m.sendTime, m.receiveTime)));
+    }
+
+    if (maxDepths.size() < componentsPtr->size())
+    {
+        maxDepths.resize(componentsPtr->size());
+    }
+    computeDepths(firstState);
+    indexComponentStates(firstState);
+
+    stateOccurrences.append(firstState);
+    eventOccurrences.append(firstEvent);
+    messages.append(newMessages);
+    statistics.append(*states, firstState, newMessages, *componentsPtr, end.toULL());
+
+    // Restarting them on every append would keep the thread pool busy
+    // while the trace is followed.
+    QMutexLocker locker(&outdatedMutex);
+    profileOutdated = !traceFile.isEmpty();
+    clusteringOutdated = true;
+}
+
 TraceData::~TraceData()
-{}
+{
+    profile.waitForFinished();
+    clustering.waitForFinished();
+}
 
 /** Returns number of lifeline adjusted to location number. */
 int TraceData::getLifeline(int location) const
@@ -56,43 +293,236 @@ Time TraceData::getMaxTime() const
     return end;
 }
 
-StateModel* TraceData::getNextState()
+void TraceData::rewind(Cursor& cursor, const QVector<QVector<int>>& index, const Selection& types) const
 {
-    if (currentState < states->size())
+    cursor.position = 0;
+    cursor.enabled.clear();
+    cursor.sources.clear();
+    cursor.positions.clear();
+    cursor.heap.clear();
+    cursor.merging = false;
+    cursor.generation = generation;
+
+    // Types unknown to the selection are never filtered out.
+    QVector<bool> enabledTypes(index.size(), true);
+    int enabled = 0;
+    int enabledObjects = 0;
+    int totalObjects = 0;
+    for (int type = 0; type < index.size(); ++type)
     {
-        return (*states)[currentState++];
+        if (type < types.size())
+        {
+            enabledTypes[type] = types.isEnabled(type);
+        }
+
+        totalObjects += index[type].size();
+        if (enabledTypes[type])
+        {
+            ++enabled;
+            enabledObjects += index[type].size();
+        }
     }
-    else
+
+    if (enabled == index.size())
     {
-        currentState = 0;
-        return nullptr;
+        return;
+    }
+
+    // Merging costs a heap operation per object, so it pays off
+    // only when a large part of the store is skipped.
+    if (enabledObjects * 2 > totalObjects)
+    {
+        cursor.enabled = enabledTypes;
+        return;
+    }
+
+    cursor.merging = true;
+    for (int type = 0; type < index.size(); ++type)
+    {
+        if (!enabledTypes[type] || index[type].isEmpty())
+        {
+            continue;
+        }
+
+        int source = cursor.sources.size();
+        cursor.sources.push_back(&index[type]);
+        cursor.positions.push_back(1);
+        cursor.heap.push_back(std::make_pair(index[type][0], source));
     }
+    std::make_heap(cursor.heap.begin(), cursor.heap.end(), std::greater<std::pair<int, int>>());
 }
 
-GroupModel* TraceData::getNextGroup()
+int TraceData::nextMerged(Cursor& cursor) const
 {
-    if (currentGroup < groups->size())
+    if (cursor.heap.empty())
     {
-        return (*groups)[currentGroup++];
+        return -1;
     }
-    else
+
+    std::pop_heap(cursor.heap.begin(), cursor.heap.end(), std::greater<std::pair<int, int>>());
+    std::pair<int, int> top = cursor.heap.back();
+    cursor.heap.pop_back();
+
+    int source = top.second;
+    const QVector<int>& index = *cursor.sources[source];
+    if (cursor.positions[source] < index.size())
     {
-        currentGroup = 0;
-        return nullptr;
+        cursor.heap.push_back(std::make_pair(index[cursor.positions[source]++], source));
+        std::push_heap(cursor.heap.begin(), cursor.heap.end(), std::greater<std::pair<int, int>>());
     }
+
+    return top.first;
+}
+
+void TraceData::rewindStates(Cursor& cursor, const Selection& types) const
+{
+    rewind(cursor, statesByType, types);
+}
+
+void TraceData::rewindEvents(Cursor& cursor, const Selection& types) const
+{
+    rewind(cursor, eventsByType, types);
 }
 
-EventModel* TraceData::getNextEvent()
+StateModel* TraceData::getNextState(Cursor& cursor) const
 {
-    if (currentEvent < events->size())
+    if (cursor.generation != generation)
+    {
+        return nullptr;
+    }
+
+    if (cursor.merging)
+    {
+        int i = nextMerged(cursor);
+        return (i == -1) ? nullptr : (*states)[i];
+    }
+
+    while (cursor.position < states->size())
     {
-        return (*events)[currentEvent++];
+        StateModel* s = (*states)[cursor.position++];
+        if (cursor.enabled.isEmpty() || cursor.enabled[s->type])
+        {
+            return s;
+        }
     }
-    else
+    return nullptr;
+}
+
+EventModel* TraceData::getNextEvent(Cursor& cursor) const
+{
+    if (cursor.generation != generation)
     {
-        currentEvent = 0;
         return nullptr;
     }
+
+    if (cursor.merging)
+    {
+        int i = nextMerged(cursor);
+        return (i == -1) ? nullptr : (*events)[i];
+    }
+
+    while (cursor.position < events->size())
+    {
+        EventModel* e = (*events)[cursor.position++];
+        if (cursor.enabled.isEmpty() || cursor.enabled[e->type])
+        {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+StateModel* TraceData::getState(int position) const
+{
+    return (*states)[position];
+}
+
+EventModel* TraceData::getEvent(int position) const
+{
+    return (*events)[position];
+}
+
+QVector<StateModel*> TraceData::statesCrossing(int component, quint64 begin, quint64 end,
+                                               int maximum) const
+{
+    QVector<StateModel*> result;
+    QHash<int, IntervalIndex>::const_iterator it = stateIntervals.constFind(component);
+    if (it == stateIntervals.constEnd())
+    {
+        return result;
+    }
+
+    const QVector<int>& list = statesByComponent[component];
+    foreach (int i, it->crossing(begin, end, maximum))
+    {
+        result << (*states)[list[i]];
+    }
+    return result;
+}
+
+const OccurrenceIndex<StateModel>& TraceData::getStateOccurrences() const
+{
+    return stateOccurrences;
+}
+
+const OccurrenceIndex<EventModel>& TraceData::getEventOccurrences() const
+{
+    return eventOccurrences;
+}
+
+const MessageStore& TraceData::getMessages() const
+{
+    return messages;
+}
+
+const CollectiveStore& TraceData::getCollectives() const
+{
+    return collectives;
+}
+
+const StatisticsIndex& TraceData::getStatistics() const
+{
+    return statistics;
+}
+
+int TraceData::getMaxDepth(int component) const
+{
+    return maxDepths.value(component);
+}
+
+DurationSketch TraceData::getStateDurations(int type) const
+{
+    return stateDurations.value(type);
+}
+
+void TraceData::startProfile(const QString& traceFile)
+{
+    this->traceFile = traceFile;
+    profile = QtConcurrent::run(loadProfile, states, int(statesByType.size()), end.toULL(),
+                                traceFile);
+}
+
+QFuture<Profile> TraceData::getProfile() const
+{
+    QMutexLocker locker(&outdatedMutex);
+    if (profileOutdated)
+    {
+        profileOutdated = false;
+        profile = QtConcurrent::run(loadProfile, states, int(statesByType.size()),
+                                    end.toULL(), traceFile);
+    }
+    return profile;
+}
+
+QFuture<Clustering> TraceData::getClustering() const
+{
+    QMutexLocker locker(&outdatedMutex);
+    if (clusteringOutdated)
+    {
+        clusteringOutdated = false;
+        startClustering();
+    }
+    return clustering;
 }
 
 const Selection TraceData::getComponents() const
@@ -3,20 +3,63 @@
 
 #include <QString>
 #include <QVector>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+
+#include <vector>
+#include <utility>
 
 #include "time_vis.h"
 #include "event_model.h"
 #include "state_model.h"
-#include "group_model.h"
+#include "message_store.h"
+#include "collective_store.h"
 #include "selection.h"
+#include "occurrence_index.h"
+#include "range_statistics.h"
+#include "interval_index.h"
+#include "profile.h"
+#include "duration_sketch.h"
+#include "clustering.h"
 
 namespace vis4 {
 
 class TraceData
 {
+public:
+    /**
+     * Position of iteration over the states or events store.
+     *
+     * When only some types are enabled, cursor merges per-type
+     * sub-indices, so disabled types are never touched. When most
+     * of types are enabled, it walks the whole store and skips
+     * objects of disabled types.
+     */
+    struct Cursor
+    {
+        /** Next position for iteration over the whole store. */
+        int position;
+
+        /** Enabled flag per type, empty if all types are enabled. */
+        QVector<bool> enabled;
+
+        /** Merged sub-indices and next position in each of them. */
+        QVector<const QVector<int>*> sources;
+        QVector<int> positions;
+
+        /** Heap of (store index, source) pairs, smallest index on top. */
+        std::vector<std::pair<int, int>> heap;
+
+        bool merging;
+
+        /** Generation of the data the cursor was rewound for. */
+        int generation;
+    };
+
 public:
     TraceData();
-    TraceData(Selection* componentsPtr, Selection* stateTypesPtr, Selection* eventTypesPtr, QVector<StateModel*>* states, QVector<EventModel*>* events, QVector<GroupModel*>* groups);
+    TraceData(Selection* componentsPtr, Selection* stateTypesPtr, Selection* eventTypesPtr, QVector<StateModel*>* states, QVector<EventModel*>* events, const QVector<MessageModel>& messages, const CollectiveStore& collectives, const DurationSketches& durations);
     ~TraceData();
 
     /** Returns number of lifeline adjusted to location number. */
@@ -30,9 +73,74 @@ public:
     Time getMinTime() const;
     Time getMaxTime() const;
 
-    StateModel* getNextState();
-    GroupModel* getNextGroup();
-    EventModel* getNextEvent();
+    /** Resets cursor to the beginning of the store, skipping disabled types. */
+    void rewindStates(Cursor& cursor, const Selection& types) const;
+    void rewindEvents(Cursor& cursor, const Selection& types) const;
+
+    /**
+     * Return next object for cursor or nullptr at the end of the store.
+     * Cursor rewound before the last append returns nullptr, since its
+     * sub-indices may have moved.
+     */
+    StateModel* getNextState(Cursor& cursor) const;
+    EventModel* getNextEvent(Cursor& cursor) const;
+
+    /** Return object at position in the store. */
+    StateModel* getState(int position) const;
+    EventModel* getEvent(int position) const;
+
+    /**
+     * Returns states of the component that have a common point with
+     * [begin, end], ordered by start. States not closed last till the
+     * end of the trace. Takes O((k + 1) log n) time for k states found.
+     * Only the first 'maximum' states are found, if it is not negative.
+     */
+    QVector<StateModel*> statesCrossing(int component, quint64 begin, quint64 end,
+                                        int maximum = -1) const;
+
+    /** Indices for search of states and events by time. */
+    const OccurrenceIndex<StateModel>& getStateOccurrences() const;
+    const OccurrenceIndex<EventModel>& getEventOccurrences() const;
+
+    /** Messages, indexed by time of sending and receiving. */
+    const MessageStore& getMessages() const;
+
+    /** Collective operations, indexed by time. */
+    const CollectiveStore& getCollectives() const;
+
+    /** Index for statistics of time ranges. */
+    const StatisticsIndex& getStatistics() const;
+
+    /** Returns the deepest nesting of states on the component. */
+    int getMaxDepth(int component) const;
+
+    /** Returns sketch of durations of states of the type. */
+    DurationSketch getStateDurations(int type) const;
+
+    /**
+     * Appends records read after the trace was loaded, for following a
+     * trace while it is written. Records must follow the loaded ones
+     * in time. Stores and indices are extended in place, profile and
+     * clustering are computed again in background when they are asked
+     * for next time. Nothing may read the data while it is appended.
+     * Cursors must be rewound after it.
+     */
+    void append(const QVector<StateModel*>& newStates, const QVector<EventModel*>& newEvents,
+                const QVector<MessageModel>& newMessages);
+
+    /**
+     * Starts computation of the profile in background. The profile is
+     * saved next to the trace file and is loaded from there next time.
+     */
+    void startProfile(const QString& traceFile);
+    /** Returns the profile, starting it again if records were
+        appended since it was started. */
+    QFuture<Profile> getProfile() const;
+
+    /** Clustering of components by behaviour, computed in background
+        since the trace is loaded, and again when it is asked for after
+        records were appended. */
+    QFuture<Clustering> getClustering() const;
 
     const Selection getComponents() const;//?
     const Selection getEventTypes() const;
@@ -45,11 +153,55 @@ private:
     Time start, end;
     QVector<StateModel*>* states;
     QVector<EventModel*>* events;
-    QVector<GroupModel*>* groups;
+    MessageStore messages;
+    CollectiveStore collectives;
+
+    /** Positions of states and events in stores, grouped by type. */
+    QVector<QVector<int>> statesByType;
+    QVector<QVector<int>> eventsByType;
+
+    OccurrenceIndex<StateModel> stateOccurrences;
+    OccurrenceIndex<EventModel> eventOccurrences;
+
+    StatisticsIndex statistics;
+
+    /** Positions of states of every component ordered by start,
+        and the index of their intervals in this order. */
+    QHash<int, QVector<int>> statesByComponent;
+    QHash<int, IntervalIndex> stateIntervals;
 
-    int currentState;
-    int currentEvent;
-    int currentGroup;
+    /** Deepest nesting of states, by component. */
+    QVector<int> maxDepths;
+
+    /** Ends of states not ended yet at the last stored state, by
+        component, the innermost last. */
+    QHash<unsigned, QVector<quint64>> openStates;
+
+    /** Duration sketches of all components, by state type. */
+    QVector<DurationSketch> stateDurations;
+
+    /** Number of appends, checked by cursors. */
+    int generation;
+
+    QString traceFile;
+    mutable QFuture<Profile> profile;
+    mutable QFuture<Clustering> clustering;
+
+    /** Profile and clustering miss records appended since they
+        were started. */
+    mutable QMutex outdatedMutex;
+    mutable bool profileOutdated;
+    mutable bool clusteringOutdated;
+
+private:
+    /** Sets depths of states from position 'from' to the end of the store. */
+    void computeDepths(int from);
+    /** Adds states from position 'from' to the end of the store
+        to the intervals of their components. */
+    void indexComponentStates(int from);
+    void startClustering() const;
+    void rewind(Cursor& cursor, const QVector<QVector<int>>& index, const Selection& types) const;
+    int nextMerged(Cursor& cursor) const;
 };
 
 }
@@ -10,10 +10,13 @@ int delta(const TraceModel& a, const TraceModel& b)
         result |= Trace_model_delta::component_position;
     if (a.getComponents() != b.getComponents())
         result |= Trace_model_delta::components;
+    // Clusters collapse components without changing the selection.
+    if (a.getVisibleComponents() != b.getVisibleComponents())
+        result |= Trace_model_delta::components;
     if (a.getEvents() != b.getEvents())
         result |= Trace_model_delta::event_types;
     if (a.groupsEnabled() != b.groupsEnabled())
-        result |= Trace_model_delta::event_types;
+        result |= Trace_model_delta::groups;
     if (a.getStates() != b.getStates())
         result |= Trace_model_delta::state_types;
     if (a.getAvailableStates() != b.getAvailableStates())
@@ -4,8 +4,16 @@
 #include <memory>
 #include <vector>
 
+#include <QFuture>
+#include <QVector>
+
 #include "time_vis.h"
 #include "selection.h"
+#include "range_statistics.h"
+#include "profile.h"
+#include "duration_sketch.h"
+#include "communication_matrix.h"
+#include "call_tree.h"
 
 class Trace;
 
@@ -13,7 +21,9 @@ namespace vis4 {
 
 class EventModel;
 class StateModel;
-class GroupModel;
+struct MessageModel;
+struct CollectiveModel;
+struct CollectiveParticipant;
 
 class TraceModel;
 typedef std::shared_ptr<TraceModel> TraceModelPtr;
@@ -96,6 +106,23 @@ public:
         @sa set_parent_component. */
     virtual bool hasChildren(int component) const = 0;
 
+    /**
+     * Returns model, where components of every cluster of similar
+     * behaviour are shown by one representative lifeline, or where
+     * all components are shown again. Clusters are computed in
+     * background after loading, the call waits for them.
+     */
+    virtual TraceModelPtr setClustered(bool clustered) = 0;
+    virtual bool clustered() const = 0;
+
+    /** Returns number of components shown by the lifeline of the
+        component: size of the collapsed cluster it represents, or 1. */
+    virtual int clusterSize(int component) const = 0;
+
+    /** Returns model, where every component of the cluster,
+        represented by the component, has own lifeline. */
+    virtual TraceModelPtr expandCluster(int component) = 0;
+
     virtual Time getMinTime() const = 0;
     virtual Time getMaxTime() const = 0;
 
@@ -112,7 +139,130 @@ public:
     /** Methods for obtaining trace data. */
     virtual EventModel* getNextEvent() = 0;
     virtual StateModel* getNextState() = 0;
-    virtual GroupModel* getNextGroup() = 0;
+
+    /** Messages sent or received within the time range, or passing
+        over it, found by the time index of the message store. */
+    virtual QVector<const MessageModel*> getMessages() const = 0;
+
+    /** Collective operations with a participant within the time range. */
+    virtual QVector<const CollectiveModel*> getCollectives() const = 0;
+
+    /** Returns participant of the collective, 'index' is below 'collective->count'. */
+    virtual const CollectiveParticipant& getParticipant(const CollectiveModel* collective,
+                                                        int index) const = 0;
+
+    /**
+     * Methods for indexed search. Occurrences are states (by start time)
+     * and events of enabled types on visible components in the whole
+     * trace, regardless of the time range, ordered by time. Occurrences
+     * are numbered from zero.
+     */
+    virtual int stateOccurrences() const = 0;
+    virtual int stateOccurrencesBefore(const Time& time) const = 0;
+    virtual StateModel* stateOccurrence(int n) const = 0;
+
+    virtual int eventOccurrences() const = 0;
+    virtual int eventOccurrencesBefore(const Time& time) const = 0;
+    virtual EventModel* eventOccurrence(int n) const = 0;
+
+    /**
+     * Collect all occurrences in parallel over groups of components.
+     * Every result of the future holds occurrences of some components,
+     * ordered by time. Results may become ready in any order.
+     */
+    virtual QFuture<QVector<StateModel*>> findAllStates() const = 0;
+    virtual QFuture<QVector<EventModel*>> findAllEvents() const = 0;
+
+    /**
+     * Return states or events of enabled types on the component in
+     * the whole trace, ordered by time. The component may be hidden.
+     * Safe to call from several threads.
+     */
+    virtual QVector<StateModel*> componentStates(int component) const = 0;
+    virtual QVector<EventModel*> componentEvents(int component) const = 0;
+
+    /**
+     * Returns states of enabled types on the component, that have a
+     * common point with the time range, ordered by start. States
+     * enclosing the range are included. Takes O((k + 1) log n) time for
+     * k states of the component within the range, of all types. Safe to
+     * call from several threads.
+     */
+    virtual QVector<StateModel*> rangeStates(int component) const = 0;
+
+    /**
+     * Same, but looks at no more than 'budget' states of the component
+     * crossing the range, of all types, the earliest ones, and takes the
+     * number of states looked at off 'budget'.
+     */
+    virtual QVector<StateModel*> rangeStates(int component, int& budget) const = 0;
+
+    /**
+     * Returns time in states and number of events of enabled types,
+     * and number of messages, on the components within [begin, end].
+     * A component with children stands for all components drawn on
+     * its lifeline. Takes O(log n) time per component and type.
+     */
+    virtual RangeStatistics rangeStatistics(const QList<int>& components,
+                                            const Time& begin, const Time& end) const = 0;
+
+    /**
+     * Returns flat profile of the whole trace, by state type, for all
+     * components regardless of filters. It is computed in background
+     * after loading, so the future may be not finished yet.
+     */
+    virtual QFuture<Profile> profile() const = 0;
+
+    /**
+     * Returns sketch of durations of all states of the type in the
+     * whole trace. Sketches are built while the trace is read.
+     */
+    virtual DurationSketch stateDurations(int type) const = 0;
+
+    /**
+     * Returns density of states of enabled types for every lifeline, in
+     * 'bins' equal parts of the time range. Lifelines are processed in
+     * parallel, and time in a bin is found by binary searches, so the
+     * cost doesn't depend on the number of states in the range.
+     */
+    virtual QVector<QVector<DensityBin>> stateDensity(int bins) const = 0;
+
+    /**
+     * Returns density of states of one component, like stateDensity()
+     * does for its lifeline. For a component with children it is the
+     * occupancy of all descendants, merged at load time.
+     */
+    virtual QVector<DensityBin> componentDensity(int component, int bins) const = 0;
+
+    /** Returns the deepest nesting of states on visible lifelines,
+        zero when states are not nested. */
+    virtual int maxDepth() const = 0;
+
+    /**
+     * Returns number and size of messages sent within the time range
+     * between every pair of lifelines. Messages of components drawn
+     * on a composite lifeline are counted for it.
+     */
+    virtual CommunicationMatrix communicationMatrix() const = 0;
+
+    /**
+     * Returns merged call tree of states of enabled types on visible
+     * lifelines within the time range. States enclosing the range are
+     * included, with their time clipped by it.
+     */
+    virtual CallTree callTree() const = 0;
+
+    /**
+     * Reads records appended to the trace since it was read, to follow
+     * a trace while it is written. Returns the model showing them, with
+     * the time range extended if it reached the end of the trace, or
+     * this model if nothing was appended.
+     */
+    virtual TraceModelPtr readAppended() = 0;
+
+    /** Number of times records were appended to the trace, so views
+        computed before can tell they are outdated. */
+    virtual int dataGeneration() const = 0;
 
     /** Returns new object with given selection of components. */
     virtual TraceModelPtr filterComponents(const Selection& filter) = 0;
@@ -127,6 +277,15 @@ public:
      */
     virtual const QList<int>& getVisibleComponents() const = 0;
 
+    /**
+     * Returns components drawn on lifelines from 'first' to 'last':
+     * the visible components with their enabled descendants, in tree
+     * order. Records of a component with children are on its
+     * descendants, so everything shown on the lifelines is on these
+     * components.
+     */
+    virtual QList<int> lifelineComponents(int first, int last) const = 0;
+
     /**
      * Returns a lifeline number for given component.
      * Returns -1 if there is no corresponding lifeline.
@@ -189,7 +348,8 @@ struct Trace_model_delta
         components = component_position << 1,
         event_types = components << 1,
         state_types = event_types << 1,
-        time_range = state_types << 1
+        time_range = state_types << 1,
+        groups = time_range << 1
     };
 };
 
@@ -1,41 +1,55 @@
 #include <utility>
 #include <memory>
-unsigned int qHash(const std::pair< std::pair<int, int>, std::pair<int, int> >& p);
+#include <algorithm>
+#include <climits>
+#include <cmath>
 
 #include "trace_painter.h"
 #include "trace_model.h"
 #include "state_model.h"
-#include "group_model.h"
+#include "message_model.h"
+#include "collective_model.h"
 #include "event_model.h"
+#include "scanline_rasterizer.h"
 
 #include <QtPrintSupport/QPrinter>
 #include <QPainter>
 #include <QPixmap>
 #include <QPainterPath>
 #include <QtWidgets/QApplication>
+#include <QHash>
 #include <QSet>
 #include <QSettings>
 #include <QDebug>
 
 namespace {
 
-unsigned joaat_hash (const unsigned char* key, size_t len)
+/** Number of visible letters in component's labels */
+const int component_name_length = 11;
+
+/** Label of a lifeline, with the number of components for a collapsed cluster. */
+QString lifelineLabel(const vis4::TraceModel& model, int component)
 {
-     unsigned hash = 0;
-     for (size_t i = 0; i < len; ++i)
-     {
-         hash += key[i];
-         hash += (hash << 10);
-         hash ^= (hash >> 6);
-     }
-     hash += (hash << 3);
-     hash ^= (hash >> 11);
-     hash += (hash << 15);
-     return hash;
+    int size = model.clusterSize(component);
+    QString name = model.getComponentName(component);
+    return size > 1 ? QString("%1%2 %3").arg(size).arg(QChar(0x00d7)).arg(name) : name;
 }
 
-/** Number of visible letters in component's labels */
-const int component_name_length = 11;
+/** Width of time buckets, in which messages are bundled, in pixels. */
+const int bundle_pixels = 16;
+
+/** Collectives narrower than this, in pixels, are merged into glyphs. */
+const int collective_pixels = 6;
+
+/** Rows of the flame chart are as high as state boxes, until
+    a lifeline has more rows than this. */
+const int flame_readable_rows = 12;
+
+/** Minimal height of a row of the flame chart. */
+const int flame_min_row_height = 3;
+
+/** Number of drawn objects between calls of processEvents(). */
+const int process_events_period = 256;
 
 /** Stores information about event letter we must
     draw, it's position and it's bounding rect. */
@@ -51,13 +65,6 @@ struct Event_letter_drawing
 
 }
 
-unsigned int qHash(const std::pair< std::pair<int, int>, std::pair<int, int> >&
-                   p)
-{
-    return joaat_hash((const unsigned char*)(&(p.first.first)),
-                      sizeof(int)*4);
-}
-
 namespace vis4 {
 
 using std::vector;
@@ -67,8 +74,23 @@ TracePainter::TracePainter() :
     right_margin(5),
     painter(0),
     tg(0),
+    raster_drawing(false),
+    rasterizer(0),
+    density_drawing(false),
+    density_height(0),
+    flame_drawing(false),
+    flame_rows(1),
+    flame_row_height(0),
     state_(Ready)
 {
+    device_target.painter = 0;
+    device_target.rasterizer = 0;
+    for (int i = 0; i < layers_count; ++i)
+    {
+        layer_targets[i].painter = 0;
+        layer_targets[i].rasterizer = 0;
+    }
+
     QFontMetrics fm(QApplication::font());
     text_elements_height = (fm.height() + 2)/2*2;
     text_height = fm.height();
@@ -82,6 +104,8 @@ TracePainter::TracePainter() :
 
     lifeline_stepping = text_elements_height*3 + text_elements_height/2
         + (event_line_extra_height + event_line_and_letter_spacing)*2;
+    base_lifeline_stepping = lifeline_stepping;
+    flame_row_height = text_elements_height;
 
     y_unparented =
         text_elements_height/2 // upper half of lifeline itself
@@ -122,7 +146,11 @@ TracePainter::TracePainter() :
 
 TracePainter::~TracePainter()
 {
-    if (painter) delete painter;
+    resetTarget(device_target, 0);
+    for (int i = 0; i < layers_count; ++i)
+    {
+        resetTarget(layer_targets[i], 0);
+    }
 }
 
 void TracePainter::setState(StateEnum state)
@@ -141,20 +169,194 @@ void TracePainter::setModel(TraceModelPtr & model_)
 void TracePainter::setPaintDevice(QPaintDevice* paintDevice)
 {
     Q_ASSERT(paintDevice);
-    if (painter) delete painter;
-    painter = new QPainter(paintDevice);
-    painter->setRenderHint(QPainter::Antialiasing);
-    painter->setRenderHint(QPainter::TextAntialiasing);
+    resetTarget(device_target, paintDevice);
+    painter = device_target.painter;
+    rasterizer = device_target.rasterizer;
 
     printer_flag = (dynamic_cast<QPrinter*>(paintDevice) != nullptr);
 
+    // Glyph caches are kept while the font stays the same.
+    QFont smallFont(painter->font());
+    smallFont.setPointSize(smallFont.pointSize()*70/100);
+    mainGlyphs.setFont(painter->font());
+    smallGlyphs.setFont(smallFont);
+
     width = painter->device()->width();
     height = painter->device()->height();
 
+    updateComponentsPerPage();
+}
+
+void TracePainter::updateComponentsPerPage()
+{
+    if (density())
+    {
+        // All lifelines are squeezed into one page.
+        components_per_page = qMax(model ? model->getVisibleComponents().size() : 0, 1);
+        return;
+    }
+
     components_per_page = (height - timeline_height -
         (y_unparented - lifeline_stepping / 2)) / lifeline_stepping;
 }
 
+void TracePainter::setRasterDrawing(bool enabled)
+{
+    raster_drawing = enabled;
+
+    resetRasterizer(device_target);
+    for (int i = 0; i < layers_count; ++i)
+    {
+        resetRasterizer(layer_targets[i]);
+    }
+    rasterizer = device_target.rasterizer;
+}
+
+void TracePainter::setDensityDrawing(bool enabled, int height)
+{
+    density_drawing = enabled;
+    density_height = height;
+}
+
+void TracePainter::setFlameDrawing(bool enabled, int depth)
+{
+    flame_drawing = enabled;
+    flame_rows = depth + 1;
+
+    // Rows of deep stacks are thinner, so a lifeline stays within
+    // about a dozen rows of normal height.
+    flame_row_height = qBound(flame_min_row_height,
+                              int(text_elements_height) * flame_readable_rows / flame_rows,
+                              int(text_elements_height));
+
+    lifeline_stepping = base_lifeline_stepping;
+    if (flame())
+    {
+        lifeline_stepping += flame_rows * flame_row_height - text_elements_height;
+    }
+}
+
+int TracePainter::contentsHeight(int components) const
+{
+    if (!density_drawing)
+    {
+        return lifeline_stepping * (components + 1);
+    }
+
+    int row_height, per_row;
+    densityLayout(components, row_height, per_row);
+    return y_unparented + (components + per_row - 1) / per_row * row_height + timeline_height;
+}
+
+bool TracePainter::density() const
+{
+    return density_drawing && !printer_flag;
+}
+
+bool TracePainter::flame() const
+{
+    return flame_drawing && !density_drawing;
+}
+
+void TracePainter::densityLayout(int components, int& row_height, int& per_row) const
+{
+    int rows = qMax(density_height - int(y_unparented) - int(timeline_height), 1);
+
+    // Two pixels per lifeline are easier to point at with the mouse.
+    row_height = (components * 2 <= rows) ? 2 : 1;
+    per_row = qMax((components + rows - 1) / rows, 1);
+}
+
+QRgb TracePainter::densityColor(int type, float activity)
+{
+    if (type == -1 || activity <= 0)
+    {
+        return qRgb(255, 255, 255);
+    }
+
+    // Hues of neighbouring types are spread by the golden angle.
+    QColor base = QColor::fromHsv(int(type * 137.508) % 360, 200, 220);
+    float a = qMin(activity, 1.0f);
+    return qRgb(255 - int((255 - base.red()) * a),
+                255 - int((255 - base.green()) * a),
+                255 - int((255 - base.blue()) * a));
+}
+
+void TracePainter::setLayerDevice(Layer layer, QImage* image)
+{
+    resetTarget(layer_targets[layerIndex(layer)], image);
+}
+
+int TracePainter::separateLayers() const
+{
+    int result = 0;
+    for (int i = 0; i < layers_count; ++i)
+    {
+        if (layer_targets[i].painter) result |= (1 << i);
+    }
+    return result;
+}
+
+void TracePainter::resetTarget(Target& target, QPaintDevice* device)
+{
+    delete target.rasterizer; target.rasterizer = 0;
+    delete target.painter; target.painter = 0;
+    if (!device) return;
+
+    target.painter = new QPainter(device);
+    target.painter->setRenderHint(QPainter::Antialiasing);
+    target.painter->setRenderHint(QPainter::TextAntialiasing);
+    resetRasterizer(target);
+}
+
+void TracePainter::resetRasterizer(Target& target)
+{
+    delete target.rasterizer; target.rasterizer = 0;
+    if (!target.painter) return;
+
+    QImage* image = dynamic_cast<QImage*>(target.painter->device());
+    if (raster_drawing && image && ScanlineRasterizer::supports(*image))
+    {
+        target.rasterizer = new ScanlineRasterizer(image);
+    }
+}
+
+int TracePainter::layerIndex(Layer layer)
+{
+    switch (layer)
+    {
+    case EventsLayer: return 0;
+    case StatesLayer: return 1;
+    case ArrowsLayer: return 2;
+    default: Q_ASSERT(false); return 0;
+    }
+}
+
+void TracePainter::beginLayer(Layer layer, const QRect& clip)
+{
+    // Layers without own images are drawn on the
+    // paint device, which is already clipped.
+    Target& target = layer_targets[layerIndex(layer)];
+    if (!target.painter) return;
+
+    painter = target.painter;
+    rasterizer = target.rasterizer;
+
+    painter->setClipping(false);
+    painter->setCompositionMode(QPainter::CompositionMode_Source);
+    painter->fillRect(0, 0, width, height, Qt::transparent);
+    painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    painter->setClipRect(clip);
+    if (rasterizer) rasterizer->setClipRect(clip);
+}
+
+void TracePainter::endLayer()
+{
+    painter = device_target.painter;
+    rasterizer = device_target.rasterizer;
+}
+
 std::auto_ptr<TraceGeometry> TracePainter::traceGeometry() const
 {
     return std::auto_ptr<TraceGeometry>(tg);
@@ -402,7 +604,7 @@ void TracePainter::splitToPages()
     pages_vertically = (int)ceil(1.0 * model->getVisibleComponents().size() / components_per_page);
 }
 
-void TracePainter::drawPage(int i, int j)
+void TracePainter::drawPage(int i, int j, int layers)
 {
     // Calculate the number of components by vertical
     int from_component = (j == 0) ? 0 : j * components_per_page;
@@ -441,17 +643,51 @@ void TracePainter::drawPage(int i, int j)
     QApplication::processEvents();
     if (state_ == Canceled) return;
 
-    painter->setClipRect(left_margin, y_unparented - lifeline_stepping / 2,
+    QRect lifelines_rect(left_margin, y_unparented - lifeline_stepping / 2,
         width - right_margin-left_margin, components_per_page * lifeline_stepping);
+    if (density())
+    {
+        lifelines_rect = QRect(left_margin, y_unparented,
+            width - right_margin - left_margin, height - y_unparented);
+    }
+    painter->setClipRect(lifelines_rect);
+    if (rasterizer) rasterizer->setClipRect(lifelines_rect);
 
-    drawEvents(from_component, to_component);
-    if (state_ == Canceled) return;
+    // In density mode layers of events and messages are only cleared.
+    if (layers & EventsLayer)
+    {
+        beginLayer(EventsLayer, lifelines_rect);
+        if (!density()) drawEvents(from_component, to_component);
+        endLayer();
+        if (state_ == Canceled) return;
+    }
 
-    drawStates(from_component, to_component);
-    if (state_ == Canceled) return;
+    if (layers & StatesLayer)
+    {
+        beginLayer(StatesLayer, lifelines_rect);
+        if (density())
+        {
+            drawDensity();
+        }
+        else
+        {
+            drawStates(from_component, to_component);
+        }
+        endLayer();
+        if (state_ == Canceled) return;
+    }
 
-    drawGroups(from_component, to_component);
-    if (state_ == Canceled) return;
+    if (layers & ArrowsLayer)
+    {
+        beginLayer(ArrowsLayer, lifelines_rect);
+        if (!density())
+        {
+            drawGroups(from_component, to_component);
+            if (state_ != Canceled) drawCollectives(from_component, to_component);
+        }
+        endLayer();
+        if (state_ == Canceled) return;
+    }
 
     if (printer_flag)
     {
@@ -479,6 +715,68 @@ void TracePainter::drawPage(int i, int j)
 
 #define DL if (drawLabels)
 
+void TracePainter::drawDensity()
+{
+    int lifelines = model->getVisibleComponents().size();
+    int bins = width - left_margin - right_margin;
+    if (lifelines == 0 || bins <= 0) return;
+
+    int row_height, per_row;
+    densityLayout(lifelines, row_height, per_row);
+    int rows = (lifelines + per_row - 1) / per_row;
+
+    QVector<QVector<DensityBin>> density = model->stateDensity(bins);
+
+    QImage image(bins, rows, QImage::Format_RGB32);
+    for (int row = 0; row < rows; ++row)
+    {
+        int first = row * per_row;
+        int last = qMin(first + per_row, lifelines);
+
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(row));
+        for (int x = 0; x < bins; ++x)
+        {
+            // Lifelines sharing a row show the type of the most active
+            // one, and their average activity.
+            const DensityBin* top = &density[first][x];
+            float activity = 0;
+            for (int l = first; l < last; ++l)
+            {
+                const DensityBin& bin = density[l][x];
+                activity += bin.activity;
+                if (bin.activity > top->activity) top = &bin;
+            }
+            line[x] = densityColor(top->type, activity / (last - first));
+        }
+    }
+
+    painter->drawImage(QRect(left_margin, lifeline_position[0], bins, rows * row_height), image);
+}
+
+void TracePainter::drawOccupancy(int lifeline, const QVector<DensityBin>& bins)
+{
+    QRect box(left_margin, lifeline_position[lifeline] - text_elements_height/2,
+              bins.size(), text_elements_height);
+
+    // Pixels of the same color are filled at once.
+    int run = 0;
+    QRgb color = bins.isEmpty() ? 0 : densityColor(bins[0].type, bins[0].activity);
+    for (int x = 1; x <= bins.size(); ++x)
+    {
+        QRgb next = (x < bins.size()) ? densityColor(bins[x].type, bins[x].activity) : 0;
+        if (x < bins.size() && next == color) continue;
+
+        painter->fillRect(box.left() + run, box.top(), x - run, box.height(), QColor(color));
+        run = x;
+        color = next;
+    }
+
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
+    painter->drawRect(box);
+    painter->restore();
+}
+
 void TracePainter::drawComponentsList(int from_component, int to_component, bool drawLabels)
 {
 NP  {
@@ -529,13 +827,48 @@ NP          tg->componentlabel_rects.push_back(qMakePair(r, parent));
     lifeline_position.clear();
     y -= from_component*lifeline_stepping; component_start += 15;
 
+    if (density())
+    {
+        int row_height, per_row;
+        densityLayout(model->getVisibleComponents().size(), row_height, per_row);
+
+        // Labels are drawn without frames, and only where they don't
+        // overlap the previous one.
+        int next_label = INT_MIN;
+        for (int i = 0; i < model->getVisibleComponents().size(); ++i)
+        {
+            int component = model->getVisibleComponents()[i];
+            int row_y = y + (i / per_row) * row_height;
+
+            if (row_y >= next_label)
+            {
+                QRect r(component_start, row_y - text_height / 2, component_width, text_height);
+                painter->drawText(r, Qt::AlignLeft|Qt::AlignVCenter,
+                                  lifelineLabel(*model, component));
+                next_label = row_y + text_height;
+
+                tg->componentlabel_rects.push_back(qMakePair(r, component));
+                if (model->hasChildren(component) || model->clusterSize(component) > 1)
+                {
+                    tg->clickable_components.push_back(qMakePair(r, component));
+                }
+            }
+
+            tg->lifeline_rects.push_back(qMakePair(QRect(0, row_y, width - right_margin, row_height),
+                                                   component));
+            lifeline_position.push_back(row_y);
+        }
+        return;
+    }
+
     for(int i = 0; i < model->getVisibleComponents().size(); i++)
     {
         int component = model->getVisibleComponents()[i];
 
         if (i >= from_component && i <= to_component) {
-            bool composite = model->hasChildren(component);
-            QString name = model->getComponentName(component);
+            // Collapsed clusters are drawn like composite components.
+            bool composite = model->hasChildren(component) || model->clusterSize(component) > 1;
+            QString name = lifelineLabel(*model, component);
 
             // Set background color for current component type
             painter->setBrush(componentLabelColors[static_cast<int>(model->getComponentType(component))]);
@@ -573,21 +906,113 @@ NP          {
 
 void TracePainter::drawStates(int from_component, int to_component)
 {
+    QFontMetrics fm(painter->font());
+    int left_right_pad = fm.width('i');
+
+    const Selection& types = model->getStates();
+    QRgb frame = painter->pen().color().rgb();
+
+    // State boxes are collected per color and submitted with one
+    // drawRects call for each color (or written by the rasterizer
+    // right away), labels are drawn over the boxes of their batch.
+    // Nested states must cover boxes and labels of the enclosing ones,
+    // so the batch is flushed when a box overlaps a pending box on the
+    // same lifeline.
+    QHash<QRgb, QVector<QRect>> boxes;
+    QVector<QPair<QRect, int>> labels;
+    vector<int> pending_right(lifeline_position.size(), INT_MIN);
+
+    // In the flame chart, nested states are drawn on their own rows and
+    // never overlap. States narrower than a pixel are merged into gray
+    // summary spans, one open span per row, drawn when the next tiny
+    // state on the row doesn't touch it.
+    bool flame_chart = flame();
+    bool flame_labels = !flame_chart || flame_row_height >= int(text_height);
+    QRgb summary_color = QColor(Qt::gray).rgba();
+    typedef QPair<int, int> Row;
+    QHash<Row, QPair<int, int>> summaries;
+
+    auto rowRect = [&](int lifeline, int depth, int pixel_begin, int pixel_end) -> QRect
+    {
+        int top = lifeline_position[lifeline] - text_elements_height/2;
+        if (!flame_chart)
+        {
+            return QRect(pixel_begin, top, pixel_end-pixel_begin, text_elements_height);
+        }
+        return QRect(pixel_begin, top + depth * flame_row_height,
+                     pixel_end-pixel_begin, flame_row_height);
+    };
+
+    auto drawSummary = [&](const Row& row, const QPair<int, int>& span)
+    {
+        QRect r = rowRect(row.first, row.second, span.first, qMax(span.second, span.first + 1));
+        if (rasterizer)
+        {
+            rasterizer->drawBox(r, summary_color, summary_color);
+        }
+        else
+        {
+            boxes[summary_color].push_back(r);
+        }
+    };
+
+    auto flush = [&]()
+    {
+        for (auto it = boxes.begin(); it != boxes.end(); ++it)
+        {
+            if (it.value().isEmpty()) continue;
+
+            painter->setBrush(QColor::fromRgba(it.key()));
+            painter->drawRects(it.value());
+            it.value().resize(0);
+        }
+
+        for (int i = 0; i < labels.size(); ++i)
+        {
+            if (printer_flag)
+            {
+                painter->drawText(labels[i].first, Qt::AlignLeft|Qt::AlignVCenter,
+                                  types.item(labels[i].second));
+            }
+            else
+            {
+                mainGlyphs.drawLabel(painter, labels[i].first, labels[i].second,
+                                     types.item(labels[i].second));
+            }
+        }
+        labels.resize(0);
+
+        std::fill(pending_right.begin(), pending_right.end(), INT_MIN);
+    };
+
+    // Lifelines of components with children show merged occupancy
+    // of the descendants instead of their states.
+    vector<bool> aggregated(lifeline_position.size(), false);
+    int bins = width - left_margin - right_margin;
+    for (int lifeline = from_component; lifeline <= to_component && bins > 0; ++lifeline)
+    {
+        int component = model->getVisibleComponents()[lifeline];
+        if (model->hasChildren(component))
+        {
+            aggregated[lifeline] = true;
+            drawOccupancy(lifeline, model->componentDensity(component, bins));
+        }
+    }
+
     model->rewind();
 
-    for(;;)
+    for(int count = 1;; ++count)
     {
         StateModel* s = model->getNextState();
         if (s == nullptr) break;
 
         int lifeline = model->lifeline(s->component);
         if (lifeline < from_component || lifeline > to_component) continue;
+        if (aggregated[lifeline]) continue;
 
         int pixel_begin = pixelPositionForTime(s->start);
         int pixel_end = pixelPositionForTime(s->end);
 
-        painter->setBrush(s->color);
-
         int text_begin = -1;
         if (pixel_begin < left_margin)
         {
@@ -597,13 +1022,53 @@ void TracePainter::drawStates(int from_component, int to_component)
         if (pixel_end > width-right_margin)
             pixel_end = width-right_margin+10;
 
+        if (flame_chart && pixel_end == pixel_begin)
+        {
+            Row row(lifeline, s->depth);
+            auto it = summaries.find(row);
+            if (it != summaries.end() && pixel_begin <= it->second + 1)
+            {
+                it->second = qMax(it->second, pixel_begin + 1);
+            }
+            else
+            {
+                if (it != summaries.end()) drawSummary(row, *it);
+                summaries[row] = qMakePair(pixel_begin, pixel_begin + 1);
+            }
+        }
+
         /* If a state takes only one pixel, prune it. */
         if (pixel_end != pixel_begin)
         {
-            QRect r = drawTextBox(model->getStates().item(s->type), painter,
-                                  pixel_begin, lifeline_position[lifeline],
-                                  pixel_end-pixel_begin, text_elements_height,
-                                  text_begin);
+            if (!flame_chart && pixel_begin < pending_right[lifeline])
+            {
+                flush();
+            }
+            pending_right[lifeline] = qMax(pending_right[lifeline], pixel_end);
+
+            // Same layout as drawTextBox() produces.
+            QRect r = rowRect(lifeline, s->depth, pixel_begin, pixel_end);
+            if (rasterizer)
+            {
+                rasterizer->drawBox(r, s->color.rgb(), frame);
+            }
+            else
+            {
+                boxes[s->color.rgba()].push_back(r);
+            }
+
+            QRect text_r(r);
+            text_r.adjust(left_right_pad, 0, -left_right_pad, 0);
+            if (text_begin != -1)
+            {
+                text_r.setLeft(text_begin);
+            }
+            if (text_r.width() > 0 && flame_labels)
+            {
+                labels.push_back(qMakePair(text_r, s->type));
+            }
+
+            r.adjust(-1, -1, 1, 1);
 
             if (!printer_flag)
             {
@@ -617,9 +1082,18 @@ void TracePainter::drawStates(int from_component, int to_component)
             }
         }
 
-        QApplication::processEvents();
-        if (state_ == Canceled) return;
+        if (count % process_events_period == 0)
+        {
+            QApplication::processEvents();
+            if (state_ == Canceled) return;
+        }
+    }
+
+    for (auto it = summaries.constBegin(); it != summaries.constEnd(); ++it)
+    {
+        drawSummary(it.key(), it.value());
     }
+    flush();
 }
 
 void TracePainter::drawEvents(int from_component, int to_component)
@@ -630,23 +1104,6 @@ void TracePainter::drawEvents(int from_component, int to_component)
     int mainFontDescent = mainFontMetrics.descent();
     int mainFontHeight = mainFontMetrics.height();
 
-    QFont smallFont(painter->font());
-    smallFont.setPointSize(smallFont.pointSize()*70/100);
-    QFontMetrics smallFontMetrics(smallFont);
-
-    vector<int> mainFontLetterWidth(256);
-    for(unsigned i = 0; i < 256; ++i)
-    {
-        char l = (char)i;
-        mainFontLetterWidth[i] = mainFontMetrics.width(QChar(l));
-    }
-
-    vector<int> smallFontLetterWidth(256);
-    for(unsigned i = 0; i < 256; ++i)
-    {
-        char l = (char)i;
-        smallFontLetterWidth[i] = smallFontMetrics.width(QChar(l));
-    }
 
     // To resolve overlapping letter by removing a latter
     // is less priority, we store all letters we want to draw in
@@ -660,6 +1117,10 @@ void TracePainter::drawEvents(int from_component, int to_component)
     // line and draw event line once every 3 pixels.
     vector<int> last_event_line(model->getVisibleComponents().size(), -10);
 
+    // Event lines share the pen, so all of them are submitted
+    // with a single drawLines call.
+    QVector<QLine> lines;
+
     model->rewind();
     for(;;)
     {
@@ -691,15 +1152,10 @@ void TracePainter::drawEvents(int from_component, int to_component)
         bool was_drawned = false;
         if (pos > last_event_line[lifeline] + 2)
         {
-            painter->save();
-            painter->setPen(QPen(Qt::black, 2));
-            painter->setRenderHint(QPainter::Antialiasing, false);
-            painter->drawLine(pos, y-text_elements_height/2-
-                              event_line_extra_height,
-                             pos, y+text_elements_height/2
-                              +event_line_extra_height);
-            painter->setRenderHint(QPainter::Antialiasing);
-            painter->restore();
+            lines.push_back(QLine(pos, y-text_elements_height/2-
+                                  event_line_extra_height,
+                                  pos, y+text_elements_height/2
+                                  +event_line_extra_height));
             last_event_line[lifeline] = pos;
 
             was_drawned = true;
@@ -707,9 +1163,9 @@ void TracePainter::drawEvents(int from_component, int to_component)
 
 NP      tg->eventsNear[lifeline][pos] = true;
 
-        int letter_width = mainFontLetterWidth[(unsigned char)(e->letter)];
+        int letter_width = mainGlyphs.letterWidth(e->letter);
         int subletter_width = e->subletter ?
-            smallFontLetterWidth[(unsigned char)(e->subletter)] : 0;
+            smallGlyphs.letterWidth(e->subletter) : 0;
 
 
         unsigned letter_x = pos;
@@ -794,103 +1250,174 @@ NP      tg->eventsNear[lifeline][pos] = true;
             letters_to_draw[lifeline].insert(le, drawing);
         }
 
-        if (!printer_flag && was_drawned)
+        if (!printer_flag && was_drawned && lines.size() % process_events_period == 0)
         {
             QApplication::processEvents();
             if (state_ == Canceled) return;
         }
     }
+
+    if (rasterizer)
+    {
+        // Two pixels wide line, as QPainter draws it without antialiasing.
+        foreach (const QLine& l, lines)
+        {
+            rasterizer->fillRect(QRect(l.x1() - 1, l.y1(), 2, l.y2() - l.y1() + 1),
+                                 qRgb(0, 0, 0));
+        }
+    }
+    else
+    {
+        painter->save();
+        painter->setPen(QPen(Qt::black, 2));
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        painter->drawLines(lines);
+        painter->restore();
+    }
+
+    // On screen letters are blitted from the glyph cache. Printer
+    // gets real text, and letters of one font are drawn together,
+    // so the font is switched only once.
     for (int i = 0; i < letters_to_draw.size(); ++i)
     {
         Event_letter_drawing d;
         foreach(d, letters_to_draw[i])
         {
-            painter->drawText(d.letterPosition, QChar(d.letter));
+            if (printer_flag)
+            {
+                painter->drawText(d.letterPosition, QChar(d.letter));
+            }
+            else
+            {
+                mainGlyphs.drawLetter(painter, d.letterPosition, d.letter);
+            }
+        }
+    }
 
-            if (d.subletter)
+    painter->save();
+    painter->setFont(smallGlyphs.font());
+    for (int i = 0; i < letters_to_draw.size(); ++i)
+    {
+        Event_letter_drawing d;
+        foreach(d, letters_to_draw[i])
+        {
+            if (!d.subletter) continue;
+
+            if (printer_flag)
             {
-                painter->save();
-                painter->setFont(smallFont);
                 painter->drawText(d.subletterPosition, QChar(d.subletter));
-                painter->restore();
+            }
+            else
+            {
+                smallGlyphs.drawLetter(painter, d.subletterPosition, d.subletter);
             }
         }
     }
+    painter->restore();
 }
 
 void TracePainter::drawGroups(int from_comp, int to_comp)
 {
-    QColor groups_color(Qt::darkGreen);
-    //groups_color.setAlpha(200);
-    painter->setBrush(groups_color);
-    painter->setPen(Qt::darkGreen);
+    // Messages between the same lifelines, sent within one bucket of
+    // pixels, are drawn as one arrow from the mean sending to the mean
+    // receiving position. Width of the arrow grows with the number of
+    // messages, opacity with their total size. When messages are far
+    // enough apart, every bundle has one message and is drawn as is.
+    struct Bundle
+    {
+        int count;
+        quint64 bytes;
+        qint64 from_pixels;
+        qint64 to_pixels;
+    };
+    typedef QPair<QPair<int, int>, int> BundleKey;
+    QHash<BundleKey, Bundle> bundles;
+    QVector<BundleKey> order;
+
+    // Only messages crossing the time range are taken from the store.
+    QVector<const MessageModel*> messages = model->getMessages();
+    for (int count = 1; count <= messages.size(); ++count)
+    {
+        if (!printer_flag && count % process_events_period == 0) {
+            QApplication::processEvents();
+            if (state_ == Canceled) return;
+        }
 
-    QSet< pair< pair<int, int>, pair<int, int> > > drawn;
+        const MessageModel* m = messages[count - 1];
+        int from_lifeline = model->lifeline(m->sender);
+        int to_lifeline = model->lifeline(m->receiver);
 
-    model->rewind();
-    for(;;)
-    {
-        GroupModel* g = model->getNextGroup();
-        if (g == nullptr) break;
+        // For composite lifelines, both endpoints of an
+        // error can end up on the same visible lifeline.
+        // Nothing should be drawn in this case.
+        if (to_lifeline == from_lifeline)
+            continue;
 
-        if (g->type == GroupModel::arrow)
-        {
-            int from_lifeline = model->lifeline(g->points[0].component);
-            int from_pixel = pixelPositionForTime(g->points[0].time);
-            pair<int, int> from_p(from_lifeline, from_pixel/9);
-            QPoint from(from_pixel, lifeline_position[from_lifeline]);
+        // Messages of hidden components have no lifeline.
+        if (from_lifeline == -1 || to_lifeline == -1)
+            continue;
 
-            for(unsigned i = 1; i < g->points.size(); ++i)
-            {
-                int to_lifeline = model->lifeline(g->points[i].component);
+        // Don't try to draw invisible arrow
+        if (((from_lifeline < (int)from_comp) || (from_lifeline > (int)to_comp)) &&
+            ((to_lifeline < (int)from_comp) || (to_lifeline > (int)to_comp))) continue;
+
+        int from_pixel = pixelPositionForTime(Time(m->sendTime));
+        int to_pixel = pixelPositionForTime(Time(m->receiveTime));
 
-                // For composite lifelines, both endpoints of an
-                // error can end up on the same visible lifeline.
-                // Nothing should be drawn in this case.
-                if (to_lifeline == from_lifeline)
-                    continue;
+        BundleKey key(qMakePair(from_lifeline, to_lifeline),
+                      (from_pixel - left_margin) / bundle_pixels);
+        auto it = bundles.find(key);
+        if (it == bundles.end())
+        {
+            Bundle bundle = { 0, 0, 0, 0 };
+            it = bundles.insert(key, bundle);
+            order << key;
+        }
+        ++it->count;
+        it->bytes += m->size;
+        it->from_pixels += from_pixel;
+        it->to_pixels += to_pixel;
+    }
 
-                // Don't try to draw invisible arrow
-                if (((from_lifeline < (int)from_comp) || (from_lifeline > (int)to_comp)) &&
-                    ((to_lifeline < (int)from_comp) || (to_lifeline > (int)to_comp))) continue;
+    quint64 max_bytes = 1;
+    foreach (const Bundle& bundle, bundles)
+    {
+        if (bundle.count > 1) max_bytes = qMax(max_bytes, bundle.bytes);
+    }
 
-                int to_pixel = pixelPositionForTime(g->points[i].time);
-                pair<int, int> to_p(to_lifeline, to_pixel/9);
+    foreach (const BundleKey& key, order)
+    {
+        const Bundle& bundle = bundles[key];
 
-                // See we we've drawn an arrow between those endpoints already.
-                pair< pair<int, int>, pair<int, int> > probe(from_p, to_p);
-                if (!drawn.contains(probe))
-                {
-                    drawn.insert(probe);
-
-                    QPoint to(to_pixel, lifeline_position[to_lifeline]);
-
-                    int delta = text_elements_height/2+7;
-                    QPoint fromAdjusted = from;
-                    if (fromAdjusted.y() < to.y())
-                    {
-                        fromAdjusted.setY(fromAdjusted.y() + delta);
-                        to.setY(to.y() - delta);
-                    }
-                    else
-                    {
-                        fromAdjusted.setY(fromAdjusted.y() - delta);
-                        to.setY(to.y() + delta);
-                    }
-                    draw_unified_arrow(fromAdjusted.x(), fromAdjusted.y(),
-                                       to.x(), to.y(), painter);
-                }
-            }
+        QColor groups_color(Qt::darkGreen);
+        int pen_width = 1;
+        if (bundle.count > 1)
+        {
+            pen_width = qMin(1 + int(log2(bundle.count)), 6);
+            groups_color.setAlpha(96 + int(159 * log1p(bundle.bytes) / log1p(max_bytes)));
         }
+        painter->setBrush(groups_color);
+        painter->setPen(QPen(groups_color, pen_width));
 
-        if (!printer_flag) {
-            QApplication::processEvents();
-            if (state_ == Canceled) return;
+        QPoint from(int(bundle.from_pixels / bundle.count), lifeline_position[key.first.first]);
+        QPoint to(int(bundle.to_pixels / bundle.count), lifeline_position[key.first.second]);
+
+        int delta = text_elements_height/2+7;
+        if (from.y() < to.y())
+        {
+            from.setY(from.y() + delta);
+            to.setY(to.y() - delta);
         }
+        else
+        {
+            from.setY(from.y() - delta);
+            to.setY(to.y() + delta);
+        }
+        draw_unified_arrow(from.x(), from.y(), to.x(), to.y(), painter);
     }
 }
 
-void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background)
+void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background, int layers)
 {
     Q_ASSERT(painter);
     Q_ASSERT(model.get());
@@ -898,6 +1425,17 @@ void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background)
     // Special case when all components are filtered
     if (model->getVisibleComponents().size() == 0)
     {
+        for (int i = 0; i < layers_count; ++i)
+        {
+            if (QPainter* p = layer_targets[i].painter)
+            {
+                p->setClipping(false);
+                p->setCompositionMode(QPainter::CompositionMode_Source);
+                p->fillRect(0, 0, width, height, Qt::transparent);
+                p->setCompositionMode(QPainter::CompositionMode_SourceOver);
+            }
+        }
+
         painter->fillRect(0, 0, width, height, Qt::white);
 
         QLinearGradient g(0, 0, left_margin, 0);
@@ -911,6 +1449,8 @@ void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background)
 
     state_ = (start_in_background) ? Background : Active;
 
+    updateComponentsPerPage();
+
     this->timePerPage = timePerPage;
     timePerFirstPage = timePerPage;
     timePerFullPage = timePerFirstPage *
@@ -925,7 +1465,7 @@ void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background)
         for (int i = 0; i < pages_horizontally; i++)
             for (int j = 0; j < pages_vertically; j++) {
                 if ((i > 0) || (j > 0)) printer->newPage();
-                drawPage(i, j);
+                drawPage(i, j, AllLayers);
             }
         painter->restore();
 
@@ -937,20 +1477,31 @@ void TracePainter::drawTrace(const Time & timePerPage, bool start_in_background)
 
     if (!tg) tg = new TraceGeometry();
 
+    // Paint device is always redrawn, so the layers
+    // drawn on it must be redrawn too.
+    layers |= AllLayers & ~separateLayers();
+
     tg->clickable_components.clear();
-    tg->states.clear();
     tg->lifeline_rects.clear();
     tg->componentlabel_rects.clear();
 
-    tg->eventsNear.clear();
-    tg->eventsNear.resize(model->getVisibleComponents().size());
-    for(int i = 0; i < model->getVisibleComponents().size(); ++i)
+    if (layers & StatesLayer)
     {
-        tg->eventsNear[i].resize(width);
+        tg->states.clear();
+    }
+
+    if (layers & EventsLayer)
+    {
+        tg->eventsNear.clear();
+        tg->eventsNear.resize(model->getVisibleComponents().size());
+        for(int i = 0; i < model->getVisibleComponents().size(); ++i)
+        {
+            tg->eventsNear[i].resize(width);
+        }
     }
 
     painter->fillRect(0, 0, width, height, Qt::white);
-    painter->save(); drawPage(0, 0); painter->restore();
+    painter->save(); drawPage(0, 0, layers); painter->restore();
     if (state_ != Canceled) state_ = Ready;
 }
 
@@ -1064,4 +1615,141 @@ int TraceGeometry::componentLabelAtPos(const QPoint& point)
     return -1;
 }
 
+void TracePainter::drawCollectives(int from_comp, int to_comp)
+{
+    // A collective wide enough on the screen is drawn as a fan from
+    // the root to every other participant, or back to the root, and
+    // as a bar across participants when all exchange with all, so it
+    // costs as much as the number of participants, not its square.
+    // Narrower collectives on one communicator, starting within one
+    // bucket of pixels, are merged into one glyph: a bar from the
+    // first to the last lifeline, thicker for more collectives.
+    struct Glyph
+    {
+        int count;
+        int top;
+        int bottom;
+        qint64 pixels;
+    };
+    typedef QPair<quint32, int> GlyphKey;
+    QHash<GlyphKey, Glyph> glyphs;
+    QVector<GlyphKey> order;
+
+    QColor collectives_color(Qt::darkMagenta);
+    painter->save();
+    painter->setPen(QPen(collectives_color, 1));
+    painter->setBrush(collectives_color);
+
+    QVector<const CollectiveModel*> collectives = model->getCollectives();
+    QVector<int> lifelines;
+    QSet<int> drawn;
+    for (int count = 1; count <= collectives.size(); ++count)
+    {
+        if (!printer_flag && count % process_events_period == 0) {
+            QApplication::processEvents();
+            if (state_ == Canceled) break;
+        }
+
+        const CollectiveModel* c = collectives[count - 1];
+
+        int top = INT_MAX, bottom = INT_MIN;
+        lifelines.resize(c->count);
+        for (int i = 0; i < c->count; ++i)
+        {
+            lifelines[i] = model->lifeline(model->getParticipant(c, i).component);
+            if (lifelines[i] == -1) continue;
+            top = qMin(top, lifelines[i]);
+            bottom = qMax(bottom, lifelines[i]);
+        }
+
+        // Collectives on one lifeline, or out of the page, are not drawn.
+        if (top >= bottom || bottom < from_comp || top > to_comp)
+            continue;
+
+        int begin_pixel = pixelPositionForTime(Time(c->begin));
+        int end_pixel = pixelPositionForTime(Time(c->end));
+        if (end_pixel - begin_pixel < collective_pixels)
+        {
+            GlyphKey key(c->communicator, (begin_pixel - left_margin) / bundle_pixels);
+            auto it = glyphs.find(key);
+            if (it == glyphs.end())
+            {
+                Glyph glyph = { 0, top, bottom, 0 };
+                it = glyphs.insert(key, glyph);
+                order << key;
+            }
+            ++it->count;
+            it->top = qMin(it->top, top);
+            it->bottom = qMax(it->bottom, bottom);
+            it->pixels += begin_pixel;
+            continue;
+        }
+
+        if (c->flow == CollectiveModel::AllToAll)
+        {
+            // The bar is where the last participant joins.
+            quint64 joined = c->begin;
+            for (int i = 0; i < c->count; ++i)
+            {
+                joined = qMax(joined, model->getParticipant(c, i).begin);
+            }
+            int x = pixelPositionForTime(Time(joined));
+
+            painter->drawLine(x, (int)lifeline_position[top], x, (int)lifeline_position[bottom]);
+            for (int i = 0; i < c->count; ++i)
+            {
+                if (lifelines[i] == -1) continue;
+                painter->drawEllipse(QPoint(x, (int)lifeline_position[lifelines[i]]), 2, 2);
+            }
+            continue;
+        }
+
+        int root_lifeline = lifelines[c->root];
+        if (root_lifeline == -1)
+            continue;
+
+        const CollectiveParticipant& root = model->getParticipant(c, c->root);
+        int root_y = lifeline_position[root_lifeline];
+
+        // Participants on one composite lifeline are drawn once.
+        drawn.clear();
+        drawn.insert(root_lifeline);
+        for (int i = 0; i < c->count; ++i)
+        {
+            if (lifelines[i] == -1 || drawn.contains(lifelines[i])) continue;
+            drawn.insert(lifelines[i]);
+
+            const CollectiveParticipant& p = model->getParticipant(c, i);
+            int y = lifeline_position[lifelines[i]];
+            if (c->flow == CollectiveModel::FanOut)
+            {
+                painter->drawLine(pixelPositionForTime(Time(root.begin)), root_y,
+                                  pixelPositionForTime(Time(p.end)), y);
+            }
+            else
+            {
+                painter->drawLine(pixelPositionForTime(Time(p.begin)), y,
+                                  pixelPositionForTime(Time(root.end)), root_y);
+            }
+        }
+    }
+
+    foreach (const GlyphKey& key, order)
+    {
+        const Glyph& glyph = glyphs[key];
+
+        int x = int(glyph.pixels / glyph.count);
+        int top = lifeline_position[glyph.top];
+        int bottom = lifeline_position[glyph.bottom];
+
+        painter->setPen(QPen(collectives_color, qMin(1 + int(log2(glyph.count)), 6)));
+        painter->drawLine(x, top, x, bottom);
+        painter->setPen(QPen(collectives_color, 1));
+        painter->drawLine(x - 3, top, x + 3, top);
+        painter->drawLine(x - 3, bottom, x + 3, bottom);
+    }
+
+    painter->restore();
+}
+
 }
@@ -2,6 +2,7 @@
 #define TRACE_PAINTER_H
 
 #include "time_vis.h"
+#include "glyph_cache.h"
 
 #include <QPainter>
 #include <QMap>
@@ -15,6 +16,7 @@ namespace vis4 {
 class TraceModel;
 class TraceGeometry;
 class StateModel;
+class ScanlineRasterizer;
 
 /** Trace painter.
     Class encapsulates all common methods for drawing on screen
@@ -32,15 +34,60 @@ class TracePainter {
 public: /* types */
     enum StateEnum { Ready, Active, Background, Canceled };
 
+    /** Layers of trace picture, from bottom to top. Component labels
+        and lifelines are always drawn on the paint device. Other
+        layers may be drawn on own images, which are composed over
+        the paint device by the caller. */
+    enum Layer
+    {
+        EventsLayer = 1,
+        StatesLayer = EventsLayer << 1,
+        ArrowsLayer = StatesLayer << 1,
+        AllLayers = EventsLayer | StatesLayer | ArrowsLayer
+    };
+
 public: /* methods */
     TracePainter();
     ~TracePainter();
 
     void setModel(std::shared_ptr<TraceModel> & model);
     void setPaintDevice(QPaintDevice* paintDevice);
+
+    /** If true, state boxes and event lines are written directly
+        into the memory of the paint device, when it's a 32-bit QImage. */
+    void setRasterDrawing(bool enabled);
+
+    /** If true, lifelines on the screen are squeezed into rows of one
+        or two pixels, so that all of them fit into 'height' pixels, and
+        states are drawn as a heatmap: every pixel shows the state type
+        taking most of its time, faded by the share of busy time.
+        When there are more lifelines than rows, neighbouring lifelines
+        share a row. Events and messages are not drawn in this mode. */
+    void setDensityDrawing(bool enabled, int height);
+
+    /** If true, states of every lifeline are drawn as a flame chart:
+        in rows by nesting depth, from the outermost state down to
+        'depth'. Rows get thinner for deep stacks, and states narrower
+        than a pixel are merged into summary spans on their rows.
+        Density drawing takes precedence. */
+    void setFlameDrawing(bool enabled, int depth);
+
+    /** Returns height of the trace picture for given number of lifelines. */
+    int contentsHeight(int components) const;
+
+    /** Sets transparent image for the layer, or null to draw the layer
+        on the paint device. Image must have the size of the paint device
+        and is cleared before the layer is drawn. */
+    void setLayerDevice(Layer layer, QImage* image);
+
+    /** Returns the layers, that have own images. */
+    int separateLayers() const;
     void setState(StateEnum state);
 
-    void drawTrace(const Time& timePerPage, bool start_in_background);
+    /** Draws the trace. Only given layers are redrawn, if they have
+        own images, the rest of layers are kept as is. */
+    void drawTrace(const Time& timePerPage, bool start_in_background,
+                   int layers = AllLayers);
     int getState();
 
 
@@ -88,6 +135,25 @@ private: /* methods */
     void drawEvents(int from_component, int to_component);
     void drawStates(int from_component, int to_component);
     void drawGroups(int from_component, int to_component);
+    void drawCollectives(int from_component, int to_component);
+    void drawDensity();
+
+    /** Draws merged occupancy of descendants on the lifeline. */
+    void drawOccupancy(int lifeline, const QVector<DensityBin>& bins);
+
+    /** Density drawing is requested and the device is not a printer. */
+    bool density() const;
+
+    /** Flame chart drawing is requested and density drawing is not. */
+    bool flame() const;
+
+    /** Height of a row and number of lifelines per row in density mode. */
+    void densityLayout(int components, int& row_height, int& per_row) const;
+
+    /** Color of a heatmap pixel, white for idle time. */
+    static QRgb densityColor(int type, float activity);
+
+    void updateComponentsPerPage();
 
     /** Calculates the number of pages, that must be printed. */
     void splitToPages();//? void func calculating some number seems strange
@@ -95,8 +161,17 @@ private: /* methods */
     /** Draw(or print) the page with given number.
         @param i Page number by horizontal.
         @param j Page number by vertical.
+        @param layers Layers to draw.
     */
-    void drawPage(int i, int j);
+    void drawPage(int i, int j, int layers);
+
+    /** Group of methods for drawing on layer images. */
+    struct Target;
+    void resetTarget(Target& target, QPaintDevice* device);
+    void resetRasterizer(Target& target);
+    void beginLayer(Layer layer, const QRect& clip);
+    void endLayer();
+    static int layerIndex(Layer layer);
 
     /** Draws an arrow from (x1, y1) to (x2, y2) on 'painter'.
        The primary issue is that often, there are several arrows
@@ -153,13 +228,38 @@ public: /** members */
 
 private: /** members */
 
+    /** Painter and rasterizer for a paint device. */
+    struct Target
+    {
+        QPainter* painter;
+        ScanlineRasterizer* rasterizer;
+    };
+
+    static const int layers_count = 3;
+
     shared_ptr<TraceModel> model;      ///< Model for drawing.
     QPainter* painter;                 ///< Active painter.
+    Target device_target;              ///< Target for the paint device.
+    Target layer_targets[layers_count];///< Targets for layer images, may be empty.
     TraceGeometry* tg;                ///< Trace geometry (coords of component labels,
                                         ///< lifelines, states, events etc.
 
     bool printer_flag;          ///< Indicates paint device is QPrinter or not.
 
+    bool raster_drawing;                ///< Raster drawing is requested.
+    ScanlineRasterizer* rasterizer;     ///< Rasterizer for the active painter, if used.
+
+    bool density_drawing;               ///< Density drawing is requested.
+    int density_height;                 ///< Height available for density drawing.
+
+    bool flame_drawing;                 ///< Flame chart drawing is requested.
+    int flame_rows;                     ///< Rows of a lifeline in the flame chart.
+    int flame_row_height;               ///< Height of a row in the flame chart.
+    unsigned int base_lifeline_stepping;///< Lifeline stepping without the flame chart.
+
+    GlyphCache mainGlyphs;              ///< Event letters and state labels.
+    GlyphCache smallGlyphs;             ///< Event subletters.
+
     int left_margin1;           ///< Width of margin at first page.
     int left_margin2;           ///< Width of margin at other pages.
 
@@ -7,4 +7,89 @@ TraceData* TraceReader::read(QString tracePath)
     return nullptr;
 }
 
+bool TraceReader::readAppended(TraceData* data)
+{
+    return false;
+}
+
+void ComponentTree::add(quint64 key, const QString& name, quint64 parent, bool location)
+{
+    keys_ << key;
+    names_[key] = name;
+    isLocation_[key] = location;
+    parents_[key] = parent;
+}
+
+QHash<quint64, int> ComponentTree::build(Selection& components)
+{
+    // Children are listed in order of definition. Parents, that
+    // are not defined, make their children top-level.
+    children_.clear();
+
+    QList<quint64> roots;
+    foreach (quint64 key, keys_)
+    {
+        quint64 parent = parents_[key];
+        if (parent != NO_PARENT && names_.contains(parent))
+        {
+            children_[parent] << key;
+        }
+        else
+        {
+            roots << key;
+        }
+    }
+
+    QHash<quint64, int> links;
+    foreach (quint64 key, roots)
+    {
+        addSubtree(key, names_[key], Selection::ROOT, components, links);
+    }
+    return links;
+}
+
+int ComponentTree::locations(quint64 key) const
+{
+    int result = isLocation_[key] ? 1 : 0;
+    foreach (quint64 child, children_.value(key))
+    {
+        result += locations(child);
+    }
+    return result;
+}
+
+void ComponentTree::addSubtree(quint64 key, const QString& name, int parent,
+                               Selection& components, QHash<quint64, int>& links) const
+{
+    const QList<quint64> children = children_.value(key);
+
+    if (!isLocation_[key])
+    {
+        QList<quint64> used;
+        foreach (quint64 child, children)
+        {
+            if (locations(child)) used << child;
+        }
+
+        if (used.isEmpty())
+        {
+            return;
+        }
+        if (used.size() == 1)
+        {
+            quint64 child = used.first();
+            bool leaf = isLocation_[child] && children_.value(child).isEmpty();
+            addSubtree(child, leaf ? name : names_[child], parent, components, links);
+            return;
+        }
+    }
+
+    int link = components.addItem(name, parent);
+    links[key] = link;
+    foreach (quint64 child, children)
+    {
+        addSubtree(child, names_[child], link, components, links);
+    }
+}
+
 }
@@ -1,6 +1,9 @@
 #ifndef TRACEREADER_H
 #define TRACEREADER_H
 
+#include <QHash>
+#include <QList>
+
 #include "trace_data.h"
 
 namespace vis4 {
@@ -8,7 +11,53 @@ namespace vis4 {
 class TraceReader
 {
 public:
+    virtual ~TraceReader() {}
     virtual TraceData* read(QString tracePath);
+
+    /**
+     * Reads records appended to the trace since the last read and adds
+     * them to 'data', returned by read() earlier. Returns false if
+     * nothing was appended. Readers of formats, that can't be read
+     * while written, never append anything.
+     */
+    virtual bool readAppended(TraceData* data);
+};
+
+/**
+ * Hierarchy of components, as defined in a trace file.
+ *
+ * Definitions may come in any order and are identified by keys,
+ * items are added to the selection when the whole hierarchy is known.
+ * Locations are the components, where states and events happen,
+ * other definitions only group them. Groups without locations are
+ * dropped, and groups with one child are skipped, so a location,
+ * that is the only one in its group, takes the name of the group
+ * (like a process with one thread).
+ */
+class ComponentTree
+{
+public:
+    static const quint64 NO_PARENT = ~quint64(0);
+
+    void add(quint64 key, const QString& name, quint64 parent, bool location);
+
+    /** Adds components to the selection, parents first.
+        Returns links of the added components by key. */
+    QHash<quint64, int> build(Selection& components);
+
+private:
+    /** Number of locations in the subtree. */
+    int locations(quint64 key) const;
+
+    void addSubtree(quint64 key, const QString& name, int parent,
+                    Selection& components, QHash<quint64, int>& links) const;
+
+private:
+    QList<quint64> keys_;
+    QHash<quint64, QString> names_;
+    QHash<quint64, bool> isLocation_;
+    QHash<quint64, QList<quint64>> children_;
+    QHash<quint64, quint64> parents_;
 };
 
 }
@@ -1,12 +1,96 @@
 #include "tracemodelimpl.h"
+#include "xmlreader.h"
 
 #include <QDebug>
 #include <OTF_RBuffer.h>
 #include <QElapsedTimer>
+#include <QtConcurrent/QtConcurrentMap>
 
 namespace vis4 {
 
-TraceModelImpl::TraceModelImpl(const QString& filename, TraceReader* readerPtr)
+namespace {
+
+/** Bins states of a component, merged over descendants for a
+    component with children. */
+struct BinComponent
+{
+    typedef QVector<DensityBin> result_type;
+
+    const StatisticsIndex* statistics;
+    QList<int> types;
+    quint64 begin;
+    quint64 end;
+    int bins;
+
+    QVector<DensityBin> operator()(int component) const
+    {
+        QVector<quint64> best(bins, 0), total(bins, 0), time(bins);
+        QVector<DensityBin> result(bins);
+        for (int i = 0; i < bins; ++i)
+        {
+            result[i].type = -1;
+        }
+
+        foreach (int type, types)
+        {
+            time.fill(0);
+            statistics->binInnermostTime(type, component, begin, end, time);
+
+            for (int i = 0; i < bins; ++i)
+            {
+                total[i] += time[i];
+                if (time[i] > best[i])
+                {
+                    best[i] = time[i];
+                    result[i].type = type;
+                }
+            }
+        }
+
+        double capacity = double(end - begin) / bins * statistics->leafCount(component);
+        for (int i = 0; i < bins; ++i)
+        {
+            result[i].activity = capacity > 0 ? float(qMin(1.0, total[i] / capacity)) : 0;
+        }
+        return result;
+    }
+};
+
+/** Binning of states of enabled types over the time range. */
+BinComponent binComponent(const StatisticsIndex& statistics, const Selection& states,
+                          const Time& begin, const Time& end, int bins)
+{
+    BinComponent result;
+    result.statistics = &statistics;
+    for (int type = 0; type < states.size(); ++type)
+    {
+        if (states.isEnabled(type)) result.types << type;
+    }
+    result.begin = begin.toULL();
+    result.end = end.toULL();
+    result.bins = qMax(bins, 1);
+    return result;
+}
+
+/** States of a component crossing the time range of the model. */
+struct RangeStates
+{
+    typedef QVector<StateModel*> result_type;
+
+    const TraceModel* model;
+
+    QVector<StateModel*> operator()(int component) const
+    {
+        return model->rangeStates(component);
+    }
+};
+
+}
+
+TraceModelImpl::TraceModelImpl(const QString& filename, TraceReader* readerPtr) :
+    reader_(readerPtr),
+    groups_enabled_(true),
+    clustered_(false)
 {
     initialize();
     initialize_component_list();
@@ -15,6 +99,7 @@ TraceModelImpl::TraceModelImpl(const QString& filename, TraceReader* readerPtr)
     timer.start();
     dataPtr = readerPtr->read(filename);
     qDebug() << timer.elapsed() << " time";
+    dataPtr->startProfile(filename);
 
     minTime = dataPtr->getMinTime();
     maxTime = dataPtr->getMaxTime();
@@ -22,10 +107,81 @@ TraceModelImpl::TraceModelImpl(const QString& filename, TraceReader* readerPtr)
     components_ = dataPtr->getComponents();
     events_ = dataPtr->getEventTypes();
     states_ = dataPtr->getStateTypes();
+
+    rewind();
 }
 
 TraceModelImpl::~TraceModelImpl() {}
 
+TraceModelPtr TraceModelImpl::open(const QString& filename)
+{
+    TraceReader* reader;
+    if (filename.endsWith(".otf2", Qt::CaseInsensitive))
+    {
+        reader = new OTF2Reader();
+    }
+    else if (filename.endsWith(".otf", Qt::CaseInsensitive))
+    {
+        reader = new OTFReader();
+    }
+    else
+    {
+        reader = new XMLReader();
+    }
+    return TraceModelPtr(new TraceModelImpl(filename, reader));
+}
+
+TraceModelPtr TraceModelImpl::readAppended()
+{
+    Time begin = dataPtr->getMinTime();
+    Time end = dataPtr->getMaxTime();
+    if (!reader_->readAppended(dataPtr))
+    {
+        return shared_from_this();
+    }
+
+    TraceModelImplPtr n(new TraceModelImpl(*this));
+
+    // Components and types, that appeared in the new records, are
+    // added to selections enabled. Links are given in order of
+    // addition, so they are the same as in the trace data.
+    const Selection components = dataPtr->getComponents();
+    for (int link = n->components_.size(); link < components.size(); ++link)
+    {
+        n->components_.addItem(components.item(link), components.itemParent(link));
+    }
+    const Selection events = dataPtr->getEventTypes();
+    for (int link = n->events_.size(); link < events.size(); ++link)
+    {
+        n->events_.addItem(events.item(link), events.itemParent(link));
+    }
+    const Selection states = dataPtr->getStateTypes();
+    for (int link = n->states_.size(); link < states.size(); ++link)
+    {
+        n->states_.addItem(states.item(link), states.itemParent(link));
+    }
+
+    // The range showing the end of the trace follows it, and the
+    // beginning is known once the first records are read.
+    if (minTime == begin)
+    {
+        n->minTime = dataPtr->getMinTime();
+    }
+    if (maxTime == end)
+    {
+        n->maxTime = dataPtr->getMaxTime();
+    }
+
+    n->adjust_components();
+    n->rewind();
+    return n;
+}
+
+int TraceModelImpl::dataGeneration() const
+{
+    return dataPtr->generation;
+}
+
 void TraceModelImpl::initialize_component_list()
 {
     components_.clear();
@@ -43,9 +199,32 @@ const QList<int> & TraceModelImpl::getVisibleComponents() const
     return visible_components_;
 }
 
+QList<int> TraceModelImpl::lifelineComponents(int first, int last) const
+{
+    QList<int> result;
+    for (int ll = qMax(first, 0); ll <= last && ll < visible_components_.size(); ++ll)
+    {
+        int component = visible_components_[ll];
+        int end = components_.subtreeEnd(component);
+        for (int position = components_.treePosition(component); position < end; ++position)
+        {
+            int link = components_.treeItem(position);
+            if (lifeline_map_[link] == ll)
+            {
+                result << link;
+            }
+        }
+    }
+    return result;
+}
+
 int TraceModelImpl::lifeline(int component) const
 {
-    return lifeline_map_.contains(component) ? lifeline_map_[component] : -1;
+    if (component < 0 || component >= lifeline_map_.size())
+    {
+        return -1;
+    }
+    return lifeline_map_[component];
 }
 
 TraceModel::ComponentType TraceModelImpl::getComponentType(int component) const// deprecated
@@ -100,22 +279,306 @@ Time TraceModelImpl::getMinResolution() const
 
 void TraceModelImpl::rewind()
 {
-    currentSubcomponent = -1;
+    dataPtr->rewindStates(stateCursor_, states_);
+    dataPtr->rewindEvents(eventCursor_, events_);
 }
 
 StateModel* TraceModelImpl::getNextState()
 {
-    dataPtr->getNextState();
+    StateModel* s = dataPtr->getNextState(stateCursor_);
+    if (!s)
+    {
+        dataPtr->rewindStates(stateCursor_, states_);
+    }
+    return s;
+}
+
+QVector<const MessageModel*> TraceModelImpl::getMessages() const
+{
+    const MessageStore& store = dataPtr->getMessages();
+
+    QVector<const MessageModel*> result;
+    foreach (int i, store.crossing(minTime.toULL(), maxTime.toULL()))
+    {
+        result << &store.message(i);
+    }
+    return result;
+}
+
+QVector<const CollectiveModel*> TraceModelImpl::getCollectives() const
+{
+    const CollectiveStore& store = dataPtr->getCollectives();
+
+    QVector<const CollectiveModel*> result;
+    foreach (int i, store.crossing(minTime.toULL(), maxTime.toULL()))
+    {
+        result << &store.collective(i);
+    }
+    return result;
 }
 
-GroupModel* TraceModelImpl::getNextGroup()
+const CollectiveParticipant& TraceModelImpl::getParticipant(const CollectiveModel* collective,
+                                                            int index) const
 {
-    dataPtr->getNextGroup();
+    return dataPtr->getCollectives().participant(collective->first + index);
 }
 
 EventModel* TraceModelImpl::getNextEvent()
 {
-    dataPtr->getNextEvent();
+    EventModel* e = dataPtr->getNextEvent(eventCursor_);
+    if (!e)
+    {
+        dataPtr->rewindEvents(eventCursor_, events_);
+    }
+    return e;
+}
+
+int TraceModelImpl::stateOccurrences() const
+{
+    const OccurrenceIndex<StateModel>& index = dataPtr->getStateOccurrences();
+    return index.count(stateQuery_.get(index, states_, lifeline_map_));
+}
+
+int TraceModelImpl::stateOccurrencesBefore(const Time& time) const
+{
+    const OccurrenceIndex<StateModel>& index = dataPtr->getStateOccurrences();
+    return index.countBefore(stateQuery_.get(index, states_, lifeline_map_), time);
+}
+
+StateModel* TraceModelImpl::stateOccurrence(int n) const
+{
+    const OccurrenceIndex<StateModel>& index = dataPtr->getStateOccurrences();
+    int position = index.occurrence(stateQuery_.get(index, states_, lifeline_map_), n);
+    return (position == -1) ? nullptr : dataPtr->getState(position);
+}
+
+int TraceModelImpl::eventOccurrences() const
+{
+    const OccurrenceIndex<EventModel>& index = dataPtr->getEventOccurrences();
+    return index.count(eventQuery_.get(index, events_, lifeline_map_));
+}
+
+int TraceModelImpl::eventOccurrencesBefore(const Time& time) const
+{
+    const OccurrenceIndex<EventModel>& index = dataPtr->getEventOccurrences();
+    return index.countBefore(eventQuery_.get(index, events_, lifeline_map_), time);
+}
+
+EventModel* TraceModelImpl::eventOccurrence(int n) const
+{
+    const OccurrenceIndex<EventModel>& index = dataPtr->getEventOccurrences();
+    int position = index.occurrence(eventQuery_.get(index, events_, lifeline_map_), n);
+    return (position == -1) ? nullptr : dataPtr->getEvent(position);
+}
+
+QFuture<QVector<StateModel*>> TraceModelImpl::findAllStates() const
+{
+    const OccurrenceIndex<StateModel>& index = dataPtr->getStateOccurrences();
+    return index.findAll(index.query(states_, lifeline_map_, true));
+}
+
+QFuture<QVector<EventModel*>> TraceModelImpl::findAllEvents() const
+{
+    const OccurrenceIndex<EventModel>& index = dataPtr->getEventOccurrences();
+    return index.findAll(index.query(events_, lifeline_map_, true));
+}
+
+QVector<StateModel*> TraceModelImpl::componentStates(int component) const
+{
+    QVector<int> components(component + 1, -1);
+    components[component] = 0;
+
+    const OccurrenceIndex<StateModel>& index = dataPtr->getStateOccurrences();
+    return index.collect(index.query(states_, components, true));
+}
+
+QVector<EventModel*> TraceModelImpl::componentEvents(int component) const
+{
+    QVector<int> components(component + 1, -1);
+    components[component] = 0;
+
+    const OccurrenceIndex<EventModel>& index = dataPtr->getEventOccurrences();
+    return index.collect(index.query(events_, components, true));
+}
+
+QVector<StateModel*> TraceModelImpl::rangeStates(int component) const
+{
+    return enabledStates(dataPtr->statesCrossing(component, minTime.toULL(), maxTime.toULL()));
+}
+
+QVector<StateModel*> TraceModelImpl::rangeStates(int component, int& budget) const
+{
+    QVector<StateModel*> found = dataPtr->statesCrossing(component, minTime.toULL(),
+                                                         maxTime.toULL(), qMax(budget, 0));
+    budget -= found.size();
+    return enabledStates(found);
+}
+
+QVector<StateModel*> TraceModelImpl::enabledStates(const QVector<StateModel*>& states) const
+{
+    QVector<StateModel*> result;
+    foreach (StateModel* s, states)
+    {
+        // Types unknown to the filter are never filtered out.
+        if (s->type >= states_.size() || states_.isEnabled(s->type))
+        {
+            result << s;
+        }
+    }
+    return result;
+}
+
+RangeStatistics TraceModelImpl::rangeStatistics(const QList<int>& components,
+                                                const Time& begin, const Time& end) const
+{
+    const StatisticsIndex& statistics = dataPtr->getStatistics();
+    const OccurrenceIndex<EventModel>& events = dataPtr->getEventOccurrences();
+    quint64 b = begin.toULL(), e = end.toULL();
+
+    RangeStatistics result;
+    QMap<int, quint64> stateTime;
+
+    // Components with children are taken with all components on their lifelines.
+    QList<int> expanded;
+    foreach (int component, components)
+    {
+        int ll = lifeline(component);
+        if (hasChildren(component) && ll != -1)
+        {
+            expanded += lifelineComponents(ll, ll);
+        }
+        else
+        {
+            expanded << component;
+        }
+    }
+
+    foreach (int component, expanded)
+    {
+        for (int type = 0; type < states_.size(); ++type)
+        {
+            if (!states_.isEnabled(type)) continue;
+
+            quint64 time = statistics.stateTime(type, component, b, e);
+            if (time != 0)
+            {
+                stateTime[type] += time;
+            }
+        }
+
+        for (int type = 0; type < events_.size(); ++type)
+        {
+            if (!events_.isEnabled(type)) continue;
+
+            int count = events.count(type, component, begin, end);
+            if (count != 0)
+            {
+                result.eventCount[type] += count;
+            }
+        }
+
+        result.messagesSent += statistics.messagesSent(component, b, e);
+        result.messagesReceived += statistics.messagesReceived(component, b, e);
+    }
+
+    for (auto it = stateTime.constBegin(); it != stateTime.constEnd(); ++it)
+    {
+        result.stateTime[it.key()] = Time(it.value());
+    }
+    return result;
+}
+
+QFuture<Profile> TraceModelImpl::profile() const
+{
+    return dataPtr->getProfile();
+}
+
+DurationSketch TraceModelImpl::stateDurations(int type) const
+{
+    return dataPtr->getStateDurations(type);
+}
+
+QVector<QVector<DensityBin>> TraceModelImpl::stateDensity(int bins) const
+{
+    // Descendants of a visible component are merged into its column.
+    BinComponent bin = binComponent(dataPtr->getStatistics(), states_, minTime, maxTime, bins);
+    return QtConcurrent::blockingMapped<QVector<QVector<DensityBin>>>(visible_components_, bin);
+}
+
+QVector<DensityBin> TraceModelImpl::componentDensity(int component, int bins) const
+{
+    return binComponent(dataPtr->getStatistics(), states_, minTime, maxTime, bins)(component);
+}
+
+int TraceModelImpl::maxDepth() const
+{
+    int result = 0;
+    for (int component = 0; component < lifeline_map_.size(); ++component)
+    {
+        if (lifeline_map_[component] != -1)
+        {
+            result = qMax(result, dataPtr->getMaxDepth(component));
+        }
+    }
+    return result;
+}
+
+CommunicationMatrix TraceModelImpl::communicationMatrix() const
+{
+    return CommunicationMatrix::compute(dataPtr->getMessages(), lifeline_map_,
+                                        visible_components_.size(),
+                                        minTime.toULL(), maxTime.toULL());
+}
+
+CallTree TraceModelImpl::callTree() const
+{
+    // Only states crossing the range are taken, from every component
+    // drawn on the visible lifelines.
+    RangeStates collect = { this };
+    QList<QVector<StateModel*>> parts = QtConcurrent::blockingMapped<QList<QVector<StateModel*>>>(
+        lifelineComponents(0, visible_components_.size() - 1), collect);
+    return CallTree::compute(parts, minTime.toULL(), maxTime.toULL());
+}
+
+TraceModelPtr TraceModelImpl::setClustered(bool clustered)
+{
+    if (clustered_ == clustered)
+    {
+        return shared_from_this();
+    }
+
+    TraceModelImplPtr n(new TraceModelImpl(*this));
+    n->clustered_ = clustered;
+    n->expanded_clusters_.clear();
+    if (clustered && clustering_.isEmpty())
+    {
+        n->clustering_ = dataPtr->getClustering().result();
+    }
+    n->adjust_components();
+    return n;
+}
+
+bool TraceModelImpl::clustered() const
+{
+    return clustered_;
+}
+
+int TraceModelImpl::clusterSize(int component) const
+{
+    return cluster_sizes_.value(component, 1);
+}
+
+TraceModelPtr TraceModelImpl::expandCluster(int component)
+{
+    if (clusterSize(component) <= 1)
+    {
+        return shared_from_this();
+    }
+
+    TraceModelImplPtr n(new TraceModelImpl(*this));
+    n->expanded_clusters_.insert(clustering_.cluster(component));
+    n->adjust_components();
+    return n;
 }
 
 TraceModelPtr TraceModelImpl::root()
@@ -128,6 +591,7 @@ TraceModelPtr TraceModelImpl::root()
 
     n->events_.enableAll(Selection::ROOT, true);
     n->adjust_components();
+    n->rewind();
 
     return n;
 }
@@ -214,6 +678,7 @@ TraceModelPtr TraceModelImpl::filterStates(const Selection& filter)
 {
     TraceModelImplPtr n(new TraceModelImpl(*this));
     n->states_ = filter;
+    n->rewind();
     return n;
 }
 
@@ -221,6 +686,7 @@ TraceModelPtr TraceModelImpl::filterEvents(const Selection& filter)
 {
     TraceModelImplPtr n(new TraceModelImpl(*this));
     n->events_ = filter;
+    n->rewind();
     return n;
 }
 
@@ -272,24 +738,79 @@ void TraceModelImpl::adjust_components()
     visible_components_ = components_.enabledItems(parent_component_);
     components_.setItemProperty(0, "current_parent", parent_component_);
 
-    lifeline_map_.clear();
+    cluster_sizes_.clear();
+    if (clustered_)
+    {
+        collapse_clusters();
+    }
+
+    // Every enabled component, reachable from a visible one through
+    // enabled parents, is drawn on the lifeline of the visible one.
+    // Subtrees are contiguous in tree order, so disabled subtrees
+    // are skipped at once.
+    lifeline_map_.fill(-1, components_.size());
     for (int ll = 0; ll < visible_components_.size(); ll++)
     {
-        QList<int> queue;
-        queue << visible_components_[ll];
-        while (!queue.isEmpty())
-        {
-            int comp = queue.takeFirst();
-            lifeline_map_[comp] = ll;
+        int component = visible_components_[ll];
+        lifeline_map_[component] = ll;
 
-            foreach(int child, components_.enabledItems(comp))
+        int position = components_.treePosition(component) + 1;
+        int end = components_.subtreeEnd(component);
+        while (position < end)
+        {
+            int link = components_.treeItem(position);
+            if (!components_.isEnabled(link))
             {
-                queue << child;
+                position = components_.subtreeEnd(link);
+                continue;
             }
+            lifeline_map_[link] = ll;
+            ++position;
         }
     }
-
 }
 
+void TraceModelImpl::collapse_clusters()
+{
+    // Collapsed cluster is shown by its visible member closest to the
+    // center, other members get no lifeline.
+    QVector<bool> visible(components_.size(), false);
+    foreach (int component, visible_components_)
+    {
+        visible[component] = true;
+    }
+
+    QHash<int, int> representatives;
+    QList<int> shown;
+    foreach (int component, visible_components_)
+    {
+        int cluster = clustering_.cluster(component);
+        if (cluster == -1 || expanded_clusters_.contains(cluster))
+        {
+            shown << component;
+            continue;
+        }
+
+        if (!representatives.contains(cluster))
+        {
+            foreach (int member, clustering_.members(cluster))
+            {
+                if (visible[member])
+                {
+                    representatives[cluster] = member;
+                    break;
+                }
+            }
+        }
+
+        int representative = representatives[cluster];
+        ++cluster_sizes_[representative];
+        if (component == representative)
+        {
+            shown << component;
+        }
+    }
+    visible_components_ = shown;
 }
 
+}
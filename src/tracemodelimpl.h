@@ -3,6 +3,7 @@
 
 #include <QVector>
 #include <QMap>
+#include <QSet>
 #include <QDebug>
 #include <QTextCodec>
 
@@ -22,7 +23,6 @@
 #include "event_model.h"
 #include "message_model.h"
 #include "canvas_item.h"
-#include "group_model.h"
 #include "event_list.h"
 #include "trace_data.h"
 #include "otfreader.h"
@@ -41,13 +41,26 @@ public: /** methods */
     TraceModelImpl(const QString& filename, TraceReader* readerPtr);
     ~TraceModelImpl();
 
+    /** Reads the trace with the reader chosen by the file extension:
+        .otf2, .otf, or XML for anything else. */
+    static TraceModelPtr open(const QString& filename);
+
+    TraceModelPtr readAppended() override;
+    int dataGeneration() const override;
+
     int getParentComponent() const;
     const QList<int>& getVisibleComponents() const;
+    QList<int> lifelineComponents(int first, int last) const override;
     int lifeline(int component) const;
     ComponentType getComponentType(int component) const;
     QString getComponentName(int component, bool full = false) const;
     bool hasChildren(int component) const;
 
+    TraceModelPtr setClustered(bool clustered) override;
+    bool clustered() const override;
+    int clusterSize(int component) const override;
+    TraceModelPtr expandCluster(int component) override;
+
     Time getMinTime() const override;
     Time getMaxTime() const override;
     Time getMinResolution() const override;
@@ -55,9 +68,39 @@ public: /** methods */
     void rewind() override;
 
     StateModel* getNextState() override;
-    GroupModel* getNextGroup() override;
+    QVector<const MessageModel*> getMessages() const override;
+    QVector<const CollectiveModel*> getCollectives() const override;
+    const CollectiveParticipant& getParticipant(const CollectiveModel* collective,
+                                                int index) const override;
     EventModel* getNextEvent() override;
 
+    int stateOccurrences() const override;
+    int stateOccurrencesBefore(const Time& time) const override;
+    StateModel* stateOccurrence(int n) const override;
+
+    int eventOccurrences() const override;
+    int eventOccurrencesBefore(const Time& time) const override;
+    EventModel* eventOccurrence(int n) const override;
+
+    QFuture<QVector<StateModel*>> findAllStates() const override;
+    QFuture<QVector<EventModel*>> findAllEvents() const override;
+
+    QVector<StateModel*> componentStates(int component) const override;
+    QVector<EventModel*> componentEvents(int component) const override;
+    QVector<StateModel*> rangeStates(int component) const override;
+    QVector<StateModel*> rangeStates(int component, int& budget) const override;
+
+    RangeStatistics rangeStatistics(const QList<int>& components,
+                                    const Time& begin, const Time& end) const override;
+
+    QFuture<Profile> profile() const override;
+    DurationSketch stateDurations(int type) const override;
+    QVector<QVector<DensityBin>> stateDensity(int bins) const override;
+    QVector<DensityBin> componentDensity(int component, int bins) const override;
+    int maxDepth() const override;
+    CommunicationMatrix communicationMatrix() const override;
+    CallTree callTree() const override;
+
     TraceModelPtr root();
     TraceModelPtr setParentComponent(int component);
     TraceModelPtr setRange(const Time& min, const Time& max);
@@ -80,6 +123,9 @@ public: /** methods */
 
 private:    /** members */
     TraceData* dataPtr;
+    /** Reader of the trace, owned by the model and its copies,
+        reads records appended after the trace was loaded. */
+    std::shared_ptr<TraceReader> reader_;
 
     int parent_component_;
     Selection components_;
@@ -88,15 +134,33 @@ private:    /** members */
     Selection states_;
     Selection available_states_;
     QList<int> visible_components_;
-    QMap<int, int> lifeline_map_;
-    int currentSubcomponent;
+    /** lifeline of every component, -1 if it is not shown */
+    QVector<int> lifeline_map_;
+
+    bool clustered_;
+    Clustering clustering_;
+    /** clusters shown in full */
+    QSet<int> expanded_clusters_;
+    /** number of components shown by every representative */
+    QHash<int, int> cluster_sizes_;
+
+    /** Occurrence queries for the current filters. */
+    CachedQuery<StateModel> stateQuery_;
+    CachedQuery<EventModel> eventQuery_;
+
+    /** Iteration positions, rewound for the current type filters. */
+    TraceData::Cursor stateCursor_;
+    TraceData::Cursor eventCursor_;
 
     Time minTime;
     Time maxTime;
 private:    /** methods */
     Time getTime(int t) const;
+    /** States of enabled types among 'states'. */
+    QVector<StateModel*> enabledStates(const QVector<StateModel*>& states) const;
     void initialize();
     void adjust_components();
+    void collapse_clusters();
     void initialize_component_list();
 };
 
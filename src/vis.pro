@@ -1,6 +1,7 @@
 QT += xml \
     widgets \
-    printsupport
+    printsupport \
+    concurrent
 CONFIG += c++11
 LIBS = -L/usr/lib \
     -lm \
@@ -20,45 +21,93 @@ SOURCES += vis4.cpp \
     main_window.cpp \
     canvas.cpp \
     trace_painter.cpp \
+    scanline_rasterizer.cpp \
+    glyph_cache.cpp \
     timeline.cpp \
     timeunit_control.cpp \
     tools/tool.cpp \
+    tools/background_tool.cpp \
     tools/timeedit.cpp \
     tools/selection_widget.cpp \
+    tools/find_tabs.cpp \
+    tools/find_results.cpp \
+    tools/profile_view.cpp \
+    tools/duration_histogram.cpp \
+    tools/matrix_view.cpp \
+    tools/flame_graph.cpp \
+    tools/checker.cpp \
     time_vis.cpp \
-    message_model.cpp \
+    message_store.cpp \
+    collective_store.cpp \
+    interval_index.cpp \
+    communication_matrix.cpp \
     otfreader.cpp \
     otf2reader.cpp \
+    otf2writer.cpp \
     trace_reader.cpp \
     trace_data.cpp \
+    occurrence_index.cpp \
+    pattern.cpp \
+    range_statistics.cpp \
+    profile.cpp \
+    profile_diff.cpp \
+    duration_sketch.cpp \
+    clustering.cpp \
+    call_tree.cpp \
     xmlreader.cpp \
     tracemodelimpl.cpp
 HEADERS += trace_model.h \
     selection.h \
     state_model.h \
-    group_model.h \
     event_model.h \
     event_list.h \
     canvas_item.h \
     main_window.h \
     canvas.h \
     trace_painter.h \
+    scanline_rasterizer.h \
+    glyph_cache.h \
     timeline.h \
     timeunit_control.h \
     tools/tool.h \
+    tools/background_tool.h \
     tools/browser.h \
     tools/measure.h \
     tools/goto.h \
     tools/find.h \
+    tools/find_tabs.h \
+    tools/find_results.h \
+    tools/profile_view.h \
+    tools/duration_histogram.h \
+    tools/matrix_view.h \
+    tools/communication.h \
+    tools/flame_graph.h \
+    tools/call_tree_view.h \
+    tools/compare.h \
+    tools/checker.h \
     tools/filter.h \
     tools/timeedit.h \
     tools/selection_widget.h \
     time_vis.h \
     message_model.h \
+    message_store.h \
+    collective_model.h \
+    collective_store.h \
+    interval_index.h \
+    communication_matrix.h \
     trace_data.h \
+    occurrence_index.h \
+    pattern.h \
+    range_statistics.h \
+    profile.h \
+    profile_diff.h \
+    duration_sketch.h \
+    clustering.h \
+    call_tree.h \
     trace_reader.h \
     otfreader.h \
     otf2reader.h \
+    otf2writer.h \
     xmlreader.h \
     tracemodelimpl.h
 
@@ -1,27 +1,112 @@
 #include <QtWidgets/QApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTextStream>
 
 #include "main_window.h"
 #include "tracemodelimpl.h"
 #include "xmlreader.h"
 #include "otfreader.h"
 #include "otf2reader.h"
+#include "otf2writer.h"
+
+namespace {
+
+using namespace vis4;
+
+/** Enables the named items with their subtrees and ancestors, all of
+    them if no names are given. */
+Selection enableNamed(Selection selection, const QStringList& names)
+{
+    if (names.isEmpty())
+    {
+        return selection.enableAll(Selection::ROOT, true);
+    }
+
+    selection.disableAll(Selection::ROOT, true);
+    for (int link = 0; link < selection.size(); ++link)
+    {
+        if (!names.contains(selection.item(link))) continue;
+
+        selection.enableAll(link, true);
+        for (int item = link; item != Selection::ROOT; item = selection.itemParent(item))
+        {
+            selection.setEnabled(item, true);
+        }
+    }
+    return selection;
+}
+
+/** Writes the part of the trace chosen by the options without showing it. */
+int exportTrace(TraceModelPtr model, const QCommandLineParser& parser)
+{
+    quint64 begin = parser.isSet("begin") ? parser.value("begin").toULongLong()
+                                          : model->getMinTime().toULL();
+    quint64 end = parser.isSet("end") ? parser.value("end").toULongLong()
+                                      : model->getMaxTime().toULL();
+    model = model->setRange(Time(begin), Time(end));
+
+    QStringList components = parser.value("components").split(',', QString::SkipEmptyParts);
+    QStringList states = parser.value("states").split(',', QString::SkipEmptyParts);
+    model = model->filterComponents(enableNamed(model->getComponents(), components));
+    model = model->filterStates(enableNamed(model->getStates(), states));
+
+    QFileInfo archive(parser.value("export"));
+    QString error;
+    if (!OTF2Writer::write(model, archive.absolutePath(), archive.completeBaseName(), &error))
+    {
+        QTextStream(stderr) << error << endl;
+        return 1;
+    }
+    return 0;
+}
+
+}
 
 int main(int ac, char* av[])
 {
     using namespace vis4;
-    QApplication app(ac, av);
-    app.setOrganizationName("Computer Systems Laboratory");
-    app.setOrganizationDomain("lvk.cs.msu.su");
-    app.setApplicationName("vis4");
+
+    QStringList arguments;
+    for (int i = 0; i < ac; ++i)
+    {
+        arguments << QString::fromLocal8Bit(av[i]);
+    }
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "Trace file to open.");
+    parser.addOptions({
+        { "export", "Write the trace to an OTF2 archive and exit.", "archive" },
+        { "begin", "Start of the exported time range, in nanoseconds.", "time" },
+        { "end", "End of the exported time range, in nanoseconds.", "time" },
+        { "components", "Comma separated components to export, with their children.", "names" },
+        { "states", "Comma separated state types to export.", "names" } });
+    parser.parse(arguments);
+
+    // Export needs no windows, so it runs without the GUI.
+    QScopedPointer<QCoreApplication> app(parser.isSet("export") ? new QCoreApplication(ac, av)
+                                                                : new QApplication(ac, av));
+    app->setOrganizationName("Computer Systems Laboratory");
+    app->setOrganizationDomain("lvk.cs.msu.su");
+    app->setApplicationName("vis4");
+    parser.process(*app);
 
     //TraceModelPtr model(new TraceModelImpl("../otf_traces/ArchivePath2/ArchiveName.otf2", new OTF2Reader()));
     //TraceModelPtr model(new TraceModelImpl("../otf_traces/testotftrace/testotftrace.otf", new OTFReader()));
-    TraceModelPtr model(new TraceModelImpl("../otf_traces/trace.xml", new XMLReader()));
+    QStringList positional = parser.positionalArguments();
+    TraceModelPtr model = !positional.isEmpty() ? TraceModelImpl::open(positional.first())
+                                                : TraceModelPtr(new TraceModelImpl("../otf_traces/trace.xml", new XMLReader()));
+
+    if (parser.isSet("export"))
+    {
+        return exportTrace(model, parser);
+    }
 
     MainWindow mw;
     mw.initialize(model);
     mw.show();
 
-    app.exec();
+    app->exec();
     return 0;
 }
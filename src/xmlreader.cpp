@@ -1,89 +1,124 @@
 #include "xmlreader.h"
 
-#include <QFile>
-#include <QXmlStreamReader>
-
 namespace vis4 {
 
+XMLReader::XMLReader() :
+    components_(nullptr),
+    stateTypes_(nullptr),
+    eventTypes_(nullptr),
+    component_(-1),
+    open_(nullptr)
+{}
+
 TraceData* XMLReader::read(QString tracePath)
 {
-    Selection* componentsPtr = new Selection();
-    Selection* stateTypesPtr = new Selection();
-    Selection* eventTypesPtr = new Selection();
+    components_ = new Selection();
+    stateTypes_ = new Selection();
+    eventTypes_ = new Selection();
 
     QVector<EventModel*>* eventsPtr = new QVector<EventModel*>;
     QVector<StateModel*>* statesPtr = new QVector<StateModel*>;
-    QVector<GroupModel*>* groupsPtr = new QVector<GroupModel*>();
 
-    XMLHandlerArgument ha = {componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr};
+    file_.setFileName(tracePath);
+    file_.open(QIODevice::ReadOnly | QIODevice::Text | QIODevice::Unbuffered);
+
+    stateTypes_->addItem("state", -1);
+
+    Chunk chunk;
+    parse(chunk);
+    *statesPtr = chunk.states;
+    *eventsPtr = chunk.events;
 
-    QFile* filePtr = new QFile(tracePath);
-    filePtr->open(QIODevice::ReadOnly | QIODevice::Text);
-    QXmlStreamReader xml(filePtr);
+    return new TraceData(components_, stateTypes_, eventTypes_, statesPtr, eventsPtr, chunk.messages, CollectiveStore(), chunk.durations);
+}
+
+bool XMLReader::readAppended(TraceData* data)
+{
+    Chunk chunk;
+    parse(chunk);
+    if (chunk.states.isEmpty() && chunk.events.isEmpty() && chunk.messages.isEmpty())
+    {
+        return false;
+    }
+
+    data->append(chunk.states, chunk.events, chunk.messages);
+    return true;
+}
+
+void XMLReader::parse(Chunk& chunk)
+{
+    QByteArray data = file_.readAll();
+    if (data.isEmpty())
+    {
+        return;
+    }
+    xml_.addData(data);
 
-    stateTypesPtr->addItem("state", -1);
-    eventTypesPtr->addItem("event", -1);
-    int comp = -1;
-    while (!xml.atEnd() && !xml.hasError())
+    // At the end of data the reader reports premature end of document,
+    // and continues from the same place when more data is added.
+    while (!xml_.atEnd())
     {
-        QXmlStreamReader::TokenType token = xml.readNext();
-        if (token == QXmlStreamReader::StartDocument)
+        QXmlStreamReader::TokenType token = xml_.readNext();
+        if (token == QXmlStreamReader::Invalid)
+            break;
+        if (token != QXmlStreamReader::StartElement)
             continue;
-        if (token == QXmlStreamReader::StartElement)
+
+        if (xml_.name() == "component")
         {
-            if (xml.name() == "trace")
-            {
-                continue;
-            }
-            if (xml.name() == "component")
-            {
-                componentsPtr->addItem(xml.attributes().value("", "name").toString(), -1);
-                ++comp;
-            }
-            if (xml.name() == "events")
-            {
-                continue;
-            }
+            components_->addItem(xml_.attributes().value("", "name").toString(), -1);
+            ++component_;
         }
-        if (xml.name() == "event")
+        else if (xml_.name() == "event")
         {
-            int time = xml.attributes().value("time").toInt();
-            QString kind = xml.attributes().value("kind").toString();
-            char letter = xml.attributes().value("letter").toString().data()->toLatin1();
+            int time = xml_.attributes().value("time").toInt();
+            QString kind = xml_.attributes().value("kind").toString();
+            char letter = xml_.attributes().value("letter").toString().data()->toLatin1();
+
+            if (!eventKinds_.contains(kind))
+            {
+                eventKinds_[kind] = eventTypes_->addItem(kind, -1);
+            }
+            int type = eventKinds_[kind];
 
             if (letter == 'E')
             {
-                eventsPtr->push_back(new EventModel(Time(time), comp, kind, letter));
-                statesPtr->push_back(new StateModel(comp, 0, Time(time), Time(0), Qt::yellow));
+                chunk.events.push_back(new EventModel(Time(time), component_, kind, letter, type));
+
+                // A state entered again before leaving stays open.
+                if (open_)
+                {
+                    chunk.states.push_back(open_);
+                }
+                open_ = new StateModel(component_, 0, Time(time), Time(0), Qt::yellow);
             }
             else if (letter == 'L')
             {
-                eventsPtr->push_back(new EventModel(Time(time), comp, kind, letter));
-                (*statesPtr)[statesPtr->size() - 1]->end = Time(time);
+                chunk.events.push_back(new EventModel(Time(time), component_, kind, letter, type));
+                if (open_)
+                {
+                    open_->end = Time(time);
+                    chunk.durations.add(open_->component, open_->type, (open_->end - open_->start).toULL());
+                    chunk.states.push_back(open_);
+                    open_ = nullptr;
+                }
             }
         }
-        else if (xml.name() == "group")
+        else if (xml_.name() == "group")
         {
-            GroupModel* gm = new GroupModel();
-            Time stm = Time(xml.attributes().value("time").toInt());
-            Time rtm = Time(xml.attributes().value("target_time").toInt());
-            int sender = comp;
-            int receiver = xml.attributes().value("target_component").toInt();
-            GroupModel::Point from;
-            from.component = sender;
-            from.time = stm;
-            GroupModel::Point to;
-            to.component = receiver;
-            to.time = rtm;
-            gm->points.push_back(from);
-            gm->points.push_back(to);
-            gm->type = GroupModel::arrow;
-            groupsPtr->push_back(gm);
+            MessageModel message = { quint64(xml_.attributes().value("time").toInt()),
+                                     quint64(xml_.attributes().value("target_time").toInt()),
+                                     component_, xml_.attributes().value("target_component").toInt(), 0, 0 };
+            chunk.messages << message;
         }
     }
 
-    return new TraceData(componentsPtr, stateTypesPtr, eventTypesPtr, statesPtr, eventsPtr, groupsPtr);
+    // A state open at the end of a complete trace never ends.
+    if (open_ && xml_.tokenType() == QXmlStreamReader::EndDocument)
+    {
+        chunk.states.push_back(open_);
+        open_ = nullptr;
+    }
 }
 
 }
-
@@ -1,14 +1,57 @@
 #ifndef XMLREADER_H
 #define XMLREADER_H
 
+#include <QFile>
+#include <QHash>
+#include <QXmlStreamReader>
+
 #include "trace_reader.h"
 
 namespace vis4 {
 
+/**
+ * Reader of XML traces. The file is parsed incrementally, so a trace
+ * still being written is read up to its last complete element, and
+ * the rest is read by readAppended() when it appears.
+ */
 class XMLReader : public TraceReader
 {
 public:
+    XMLReader();
+
     TraceData* read(QString tracePath) override;
+    bool readAppended(TraceData* data) override;
+
+private:
+    /** Records read by one call of parse(). */
+    struct Chunk
+    {
+        QVector<StateModel*> states;
+        QVector<EventModel*> events;
+        QVector<MessageModel> messages;
+        DurationSketches durations;
+    };
+
+    /** Parses data appended to the file since the last call. */
+    void parse(Chunk& chunk);
+
+private:
+    QFile file_;
+    QXmlStreamReader xml_;
+
+    Selection* components_;
+    Selection* stateTypes_;
+    Selection* eventTypes_;
+
+    /** Component of the last 'component' element. */
+    int component_;
+
+    /** Event types by their kinds. */
+    QHash<QString, int> eventKinds_;
+
+    /** State not ended yet. It is stored when it ends, so stored
+        states never change. */
+    StateModel* open_;
 };
 
 typedef struct {
@@ -17,6 +60,7 @@ typedef struct {
     Selection* eventTypes;
     QVector<StateModel*>* states;
     QVector<EventModel*>* events;
+    DurationSketches* durations;
 } XMLHandlerArgument;
 
 }